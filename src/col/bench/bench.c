@@ -0,0 +1,71 @@
+//..............................
+// bench : Times the same query set with one or more configs of the module
+//   usage: bench file.bsp queries seed "settings 1" ["settings 2" ...]
+//   Settings are comma separated `name=value` pairs (see Drv_Setting), applied on top of the defaults of CM_InitCfg
+//   The map is loaded again for each config. Every kind of query is timed apart, and the best of `repeat` runs is kept (5 by default)
+//   Prints the time of each kind in nanoseconds per query, the leafs and brushes that each query visited,
+//   and the speedup of the whole set against the first config
+//..............................
+#include "./driver.h"
+
+//..............................
+// Bench_Kind
+//   Returns the best time of the given runs of the set, in msec, and the counters of the last one
+//..............................
+static f64 Bench_Kind(const DrvQuery* queries, i32 count, DrvResult* r) {
+  i32 repeat = drv.repeat > 0 ? drv.repeat : 5;
+  f64 best   = 0;
+  drv.repeat = 1;
+  for (i32 n = 0; n < repeat; n++) {
+    Drv_Run(queries, count, r);
+    if (!n || r->msec < best) { best = r->msec; }
+    if (n < repeat - 1) { Drv_FreeResult(r); }
+  }
+  drv.repeat = repeat;
+  return best;
+}
+
+//..............................
+// Entry Point
+//..............................
+int main(int argc, char** argv) {
+  if (argc < 5) {
+    fprintf(stderr, "usage: %s file.bsp queries seed \"settings 1\" [\"settings 2\" ...]\n", argv[0]);
+    return 1;
+  }
+  const char* map   = argv[1];
+  i32         count = atoi(argv[2]);
+  u32         seed  = (u32)atoi(argv[3]);
+  Drv_Init();
+  DrvQuery* queries = Drv_Alloc(count * sizeof(DrvQuery));
+  DrvQuery* kind    = Drv_Alloc(count * sizeof(DrvQuery));
+  f64       first   = 0;
+  printf("%s: %i queries, seed %u. ns per query, and leafs/brushes per query\n", map, count, seed);
+  printf("%-32s", "settings");
+  for (i32 k = 0; k < DRV_KINDS; k++) { printf(" %16s", drv_kindNames[k]); }
+  printf(" %10s %8s\n", "total ms", "speedup");
+  for (i32 a = 4; a < argc; a++) {
+    Drv_Apply(argv[a]);
+    Drv_Load(map);
+    Drv_Queries(queries, count, seed);
+    printf("%-32s", argv[a][0] ? argv[a] : "(defaults)");
+    f64 total = 0;
+    for (i32 k = 0; k < DRV_KINDS; k++) {
+      i32 num = 0;
+      for (i32 i = 0; i < count; i++) {
+        if (queries[i].kind == (DrvKind)k) { kind[num++] = queries[i]; }
+      }
+      DrvResult r;
+      f64       msec = Bench_Kind(kind, num, &r);
+      total += msec;
+      printf(" %6.0f %4.1f/%4.1f", num ? msec * 1e6 / num : 0, num ? (f64)r.leafTraces / num : 0, num ? (f64)r.brushTraces / num : 0);
+      Drv_FreeResult(&r);
+    }
+    if (a == 4) { first = total; }
+    printf(" %10.1f %7.2fx\n", total, total > 0 ? first / total : 0);
+    fflush(stdout);
+  }
+  free(kind);
+  free(queries);
+  return 0;
+}
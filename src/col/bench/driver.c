@@ -0,0 +1,489 @@
+#include <math.h>
+#include "./driver.h"
+
+//..............................
+// Host stand-ins
+//   The module links against these engine functions. The drivers bring their own, with the stdlib
+//   Leave this block out when linking the drivers against an engine that already has them
+//..............................
+#ifndef DRV_ENGINE_HOST
+vec3 vec3_origin = { 0, 0, 0 };
+//..............................
+i32 FileRead(const char* name, void** buf) {
+  *buf       = NULL;
+  FILE* file = fopen(name, "rb");
+  if (!file) { return -1; }
+  fseek(file, 0, SEEK_END);
+  i32 length = (i32)ftell(file);
+  fseek(file, 0, SEEK_SET);
+  *buf = malloc(length);
+  if (fread(*buf, 1, length, file) != (size_t)length) {
+    free(*buf);
+    *buf = NULL;
+  }
+  fclose(file);
+  return length;
+}
+void FileFree(void* buf) { free(buf); }
+#endif  // DRV_ENGINE_HOST
+
+//..............................
+// Driver state
+DrvCfg      drv = { .api = DRV_API_TRACE };
+const char* drv_kindNames[DRV_KINDS]    = { "point", "point long", "box", "box long", "small box", "capsule", "position", "model", "entity" };
+const char* drv_apiNames[DRV_API_COUNT] = { "trace", "batch", "packet", "gather", "query", "entity", "jobs" };
+// Box of the other players, for DRV_ENTITY
+static const vec3 drv_entityMins = { -15, -15, -24 };
+static const vec3 drv_entityMaxs = { 15, 15, 32 };
+// Boxes swept by the queries: the player, and the small box of DRV_SMALL. Registered as hulls with `hulls=1`
+static const vec3 drv_playerMins = { -15, -15, -24 };
+static const vec3 drv_playerMaxs = { 15, 15, 32 };
+static const vec3 drv_smallMins  = { -4, -4, -4 };
+static const vec3 drv_smallMaxs  = { 4, 4, 4 };
+// Driver config as set by Drv_Init, that Drv_Apply starts from
+static DrvCfg drv_init;
+
+//..............................
+// Drv_Init
+//   Starts the memory manager and sets the default col and load config, before any Drv_Setting
+//..............................
+void Drv_Init(void) {
+  Mem_InitCfg();
+  Com_InitSmallZoneMemory();
+  Com_InitZoneMemory();
+  Com_InitHunkMemory();
+  CM_InitCfg();
+  load.developer = 0;
+  drv_init       = drv;
+}
+
+//..............................
+// Drv_Setting
+//   Applies a `name=value` setting to the col or load config, or to the driver (drv)
+//   load.leafMasks takes a `:` separated list of at most MAX_LEAF_MASKS masks, and 0 for none
+//   Returns false for an unknown setting
+//..............................
+typedef struct {
+  const char* name;
+  int*        value;
+} DrvOption;
+static DrvOption drv_options[] = {
+  { "vis", &col.doVIS },
+  { "patchCol", &col.doPatchCol },
+  { "simd", &col.doSIMD },
+  { "leafSimd", &col.doLeafSIMD },
+  { "facetBvh", &col.doFacetBVH },
+  { "exactOffset", &col.doExactOffset },
+  { "bvh", &col.doBVH },
+  { "cache", &col.doTraceCache },
+  { "noCurves", &load.noCurves },
+  { "developer", &load.developer },
+  { "nodeOrder", &load.nodeOrder },
+  { "compact", &load.compact },
+  { "colTree", &load.colTree },
+  { "nodeBounds", &load.nodeBounds },
+  { "brushOrder", &load.brushOrder },
+  { "workers", &drv.workers },
+  { "hulls", &drv.hulls },
+  { "repeat", &drv.repeat },
+  { "report", &drv.report },
+};
+bool Drv_Setting(const char* setting) {
+  const char* eq = strchr(setting, '=');
+  if (!eq) { return false; }
+  size_t      len   = eq - setting;
+  const char* value = eq + 1;
+  if (len == 3 && !strncmp(setting, "api", len)) {
+    for (i32 i = 0; i < DRV_API_COUNT; i++) {
+      if (!strcmp(value, drv_apiNames[i])) {
+        drv.api = i;
+        return true;
+      }
+    }
+    return false;
+  }
+  if (len == 9 && !strncmp(setting, "leafMasks", len)) {
+    memset(load.leafMasks, 0, sizeof(load.leafMasks));
+    for (i32 i = 0; i < MAX_LEAF_MASKS && *value; i++) {
+      char* next        = NULL;
+      load.leafMasks[i] = (int)strtol(value, &next, 0);
+      value             = (*next == ':') ? next + 1 : next;
+    }
+    if (*value) { err(ERR_EXIT, "%s: more than %i leafMasks", __func__, MAX_LEAF_MASKS); }
+    return true;
+  }
+  for (size_t i = 0; i < sizeof(drv_options) / sizeof(drv_options[0]); i++) {
+    if (strlen(drv_options[i].name) == len && !strncmp(setting, drv_options[i].name, len)) {
+      *drv_options[i].value = atoi(value);
+      return true;
+    }
+  }
+  return false;
+}
+
+//..............................
+// Drv_Apply
+//   Resets the config to the defaults of Drv_Init, and applies the given comma separated settings on top
+//..............................
+void Drv_Apply(const char* settings) {
+  CM_InitCfg();
+  load.developer = 0;
+  drv            = drv_init;
+  char buf[1024];
+  strncpyz(buf, settings, sizeof(buf));
+  for (char* s = strtok(buf, ", "); s; s = strtok(NULL, ", ")) {
+    if (!Drv_Setting(s)) { err(ERR_EXIT, "unknown setting: %s", s); }
+  }
+  if (drv.hulls) {
+    CM_RegisterHull(drv_playerMins, drv_playerMaxs);
+    CM_RegisterHull(drv_smallMins, drv_smallMaxs);
+  }
+}
+
+//..............................
+// Drv_Load
+//   Loads the map from scratch, with the current load config
+//   Stops the worker pool first: the query contexts of its workers belong to the previous map
+//..............................
+void Drv_Load(const char* name) {
+  i32 checksum;
+  if (CM_JobsNumWorkers()) { CM_JobsShutdown(); }
+  CM_ClearMap();
+  Hunk_Clear();
+  CM_LoadMap(name, false, &checksum);
+  if (drv.report) { CM_MemoryReport(); }
+}
+
+//..............................
+// Drv_Rand
+//   Returns a random number in [0, 1). Same sequence for the same seed on every platform
+//..............................
+static f32 Drv_Rand(u32* seed) {
+  *seed = *seed * 1664525u + 1013904223u;
+  return (f32)(*seed >> 8) / (f32)(1 << 24);
+}
+
+//..............................
+// Drv_Queries
+//   Fills the set with the given amount of queries, cycling through every kind
+//   Start points are spread over the bounds of the world, and the segments go in random directions
+//..............................
+void Drv_Queries(DrvQuery* out, i32 count, u32 seed) {
+  static const i32 masks[] = { DRV_MASK_PLAYERSOLID, DRV_MASK_SHOT, DRV_MASK_SOLID, DRV_MASK_WATER, DRV_MASK_ALL };
+  vec3             wmins, wmaxs;
+  CM_ModelBounds(0, wmins, wmaxs);
+  for (i32 i = 0; i < count; i++) {
+    DrvQuery* q = &out[i];
+    memset(q, 0, sizeof(*q));
+    q->kind = i % DRV_KINDS;
+    q->mask = masks[(i / DRV_KINDS) % (sizeof(masks) / sizeof(masks[0]))];
+    for (i32 j = 0; j < 3; j++) { q->start[j] = wmins[j] + Drv_Rand(&seed) * (wmaxs[j] - wmins[j]); }
+    f32  len = (q->kind == DRV_POINT_LONG || q->kind == DRV_BOX_LONG) ? 256 + Drv_Rand(&seed) * 1792 : 8 + Drv_Rand(&seed) * 120;
+    vec3 dir = { Drv_Rand(&seed) - 0.5f, Drv_Rand(&seed) - 0.5f, (Drv_Rand(&seed) - 0.5f) * 0.5f };
+    f32  n   = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+    for (i32 j = 0; j < 3; j++) { q->end[j] = q->start[j] + dir[j] / n * len; }
+    switch (q->kind) {
+      case DRV_POINT:
+      case DRV_POINT_LONG: break;
+      case DRV_SMALL:
+        GVec3Copy(drv_smallMins, q->mins);
+        GVec3Copy(drv_smallMaxs, q->maxs);
+        break;
+      case DRV_POSITION: GVec3Copy(q->start, q->end);  // fallthrough, player box
+      case DRV_BOX:
+      case DRV_BOX_LONG:
+      case DRV_CAPSULE:
+        GVec3Copy(drv_playerMins, q->mins);
+        GVec3Copy(drv_playerMaxs, q->maxs);
+        q->capsule = q->kind == DRV_CAPSULE;
+        break;
+      case DRV_MODEL:  // the first inline model, moved near the start point and rotated half of the time
+        GVec3Copy(drv_playerMins, q->mins);
+        GVec3Copy(drv_playerMaxs, q->maxs);
+        for (i32 j = 0; j < 3; j++) { q->origin[j] = q->start[j] + (Drv_Rand(&seed) - 0.5f) * 128; }
+        if (i & 8) { GVec3Set(q->angles, 0, Drv_Rand(&seed) * 360, (Drv_Rand(&seed) - 0.5f) * 30); }
+        break;
+      case DRV_ENTITY:  // against the box of another player (drv_entityMins/Maxs) near the start point, like SV_ClipHandleForEntity
+                        // makes it. Half of the traces are capsules
+        GVec3Copy(drv_playerMins, q->mins);
+        GVec3Copy(drv_playerMaxs, q->maxs);
+        for (i32 j = 0; j < 3; j++) { q->origin[j] = q->start[j] + (Drv_Rand(&seed) - 0.5f) * 96; }
+        q->capsule = (i & 16) != 0;
+        break;
+      default: break;
+    }
+  }
+}
+
+//..............................
+// Drv_Msec
+//..............................
+f64 Drv_Msec(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+//..............................
+// Drv_Alloc
+//   Zero filled memory of the driver, that exits when it runs out
+//..............................
+void* Drv_Alloc(size_t size) {
+  void* p = calloc(1, size ? size : 1);
+  if (!p) { err(ERR_EXIT, "%s: out of memory", __func__); }
+  return p;
+}
+
+//..............................
+// Drv_World
+//   Returns true for the queries against the world, false for the ones against a model or an entity box
+//..............................
+static bool Drv_World(const DrvQuery* q) { return q->kind != DRV_MODEL && q->kind != DRV_ENTITY; }
+
+//..............................
+// Drv_Trace
+//   Runs one query through CM_BoxTrace, or CM_TransformedBoxTrace for the model and entity queries
+//..............................
+static void Drv_Trace(const DrvQuery* q, Trace* t) {
+  if (q->kind == DRV_MODEL) {
+    CM_TransformedBoxTrace(t, q->start, q->end, q->mins, q->maxs, CM_InlineModel(1), q->mask, q->origin, q->angles, q->capsule);
+  } else if (q->kind == DRV_ENTITY) {
+    cHandle box = CM_TempBoxModel(drv_entityMins, drv_entityMaxs, false);
+    CM_TransformedBoxTrace(t, q->start, q->end, q->mins, q->maxs, box, q->mask, q->origin, vec3_origin, q->capsule);
+  } else {
+    CM_BoxTrace(t, q->start, q->end, q->mins, q->maxs, 0, q->mask, q->capsule);
+  }
+}
+
+//..............................
+// Drv_RunBatch
+//   World queries through CM_BoxTraceBatch, one batch for the boxes and one for the capsules
+//..............................
+static void Drv_RunBatch(const DrvQuery* queries, i32 count, Trace* out) {
+  vec3*  starts = Drv_Alloc(count * sizeof(vec3));
+  vec3*  ends   = Drv_Alloc(count * sizeof(vec3));
+  vec3*  mins   = Drv_Alloc(count * sizeof(vec3));
+  vec3*  maxs   = Drv_Alloc(count * sizeof(vec3));
+  i32*   masks  = Drv_Alloc(count * sizeof(i32));
+  i32*   ids    = Drv_Alloc(count * sizeof(i32));
+  Trace* res    = Drv_Alloc(count * sizeof(Trace));
+  for (i32 capsule = 0; capsule < 2; capsule++) {
+    i32 num = 0;
+    for (i32 i = 0; i < count; i++) {
+      const DrvQuery* q = &queries[i];
+      if (!Drv_World(q) || q->capsule != capsule) { continue; }
+      GVec3Copy(q->start, starts[num]);
+      GVec3Copy(q->end, ends[num]);
+      GVec3Copy(q->mins, mins[num]);
+      GVec3Copy(q->maxs, maxs[num]);
+      masks[num] = q->mask;
+      ids[num++] = i;
+    }
+    CM_BoxTraceBatch(res, num, (const vec3*)starts, (const vec3*)ends, (const vec3*)mins, (const vec3*)maxs, masks, 0, capsule);
+    for (i32 i = 0; i < num; i++) { out[ids[i]] = res[i]; }
+  }
+  for (i32 i = 0; i < count; i++) {
+    if (!Drv_World(&queries[i])) { Drv_Trace(&queries[i], &out[i]); }
+  }
+  free(starts), free(ends), free(mins), free(maxs), free(masks), free(ids), free(res);
+}
+
+//..............................
+// Drv_RunPacket
+//   World point traces through CM_PointTracePacket, in packets of consecutive traces with the same mask
+//..............................
+static void Drv_RunPacket(const DrvQuery* queries, i32 count, Trace* out) {
+  vec3 starts[MAX_PACKET_RAYS], ends[MAX_PACKET_RAYS];
+  i32  ids[MAX_PACKET_RAYS];
+  i32  num = 0, mask = 0;
+  for (i32 i = 0; i <= count; i++) {
+    const DrvQuery* q     = (i < count) ? &queries[i] : NULL;
+    bool            point = q && (q->kind == DRV_POINT || q->kind == DRV_POINT_LONG);
+    if (num && (!q || (point && q->mask != mask) || num == MAX_PACKET_RAYS)) {
+      Trace res[MAX_PACKET_RAYS];
+      CM_PointTracePacket(res, num, (const vec3*)starts, (const vec3*)ends, mask);
+      for (i32 j = 0; j < num; j++) { out[ids[j]] = res[j]; }
+      num = 0;
+    }
+    if (!q) { break; }
+    if (!point) {
+      Drv_Trace(q, &out[i]);
+      continue;
+    }
+    mask = q->mask;
+    GVec3Copy(q->start, starts[num]);
+    GVec3Copy(q->end, ends[num]);
+    ids[num++] = i;
+  }
+}
+
+//..............................
+// Drv_RunGather
+//   World queries through CM_GatherTrace, gathering the region swept by every 8 of them with all of their masks
+//..............................
+static void Drv_RunGather(const DrvQuery* queries, i32 count, Trace* out) {
+  ColGather g = { 0 };
+  for (i32 first = 0; first < count; first += 8) {
+    i32  last = (first + 8 < count) ? first + 8 : count;
+    vec3 mins = { MAX_WORLD_COORD, MAX_WORLD_COORD, MAX_WORLD_COORD };
+    vec3 maxs = { MIN_WORLD_COORD, MIN_WORLD_COORD, MIN_WORLD_COORD };
+    i32  mask = 0;
+    for (i32 i = first; i < last; i++) {
+      const DrvQuery* q = &queries[i];
+      if (!Drv_World(q)) { continue; }
+      for (i32 j = 0; j < 3; j++) {
+        mins[j] = fminf(mins[j], fminf(q->start[j], q->end[j]) + q->mins[j] - 8);
+        maxs[j] = fmaxf(maxs[j], fmaxf(q->start[j], q->end[j]) + q->maxs[j] + 8);
+      }
+      mask |= q->mask;
+    }
+    if (mask) { CM_Gather(&g, mins, maxs, mask); }
+    for (i32 i = first; i < last; i++) {
+      const DrvQuery* q = &queries[i];
+      if (!Drv_World(q)) {
+        Drv_Trace(q, &out[i]);
+      } else {
+        CM_GatherTrace(&g, &out[i], q->start, q->end, q->mins, q->maxs, q->mask, q->capsule);
+      }
+    }
+  }
+  CM_FreeGather(&g);
+}
+
+//..............................
+// Drv_RunQuery
+//   Every query through the reentrant entry points, with a context of the driver
+//..............................
+static void Drv_RunQuery(const DrvQuery* queries, i32 count, Trace* out, DrvResult* r) {
+  ColQuery q;
+  CM_InitQuery(&q);
+  for (i32 i = 0; i < count; i++) {
+    const DrvQuery* d = &queries[i];
+    if (d->kind == DRV_MODEL) {
+      CM_QueryTransformedBoxTrace(&q, &out[i], d->start, d->end, d->mins, d->maxs, CM_InlineModel(1), d->mask, d->origin, d->angles, d->capsule);
+    } else if (d->kind == DRV_ENTITY) {
+      cHandle box = CM_QueryTempBoxModel(&q, drv_entityMins, drv_entityMaxs, false);
+      CM_QueryTransformedBoxTrace(&q, &out[i], d->start, d->end, d->mins, d->maxs, box, d->mask, d->origin, vec3_origin, d->capsule);
+    } else {
+      CM_QueryBoxTrace(&q, &out[i], d->start, d->end, d->mins, d->maxs, 0, d->mask, d->capsule);
+    }
+  }
+  r->leafTraces += q.leafTraces;
+  r->brushTraces += q.brushTraces;
+  r->patchTraces += q.patchTraces;
+  CM_FreeQuery(&q);
+}
+
+//..............................
+// Drv_RunEntity
+//   Model and entity queries through a prepared transform and CM_EntityBoxTrace
+//..............................
+static void Drv_RunEntity(const DrvQuery* queries, i32 count, Trace* out) {
+  for (i32 i = 0; i < count; i++) {
+    const DrvQuery* q = &queries[i];
+    if (Drv_World(q)) {
+      Drv_Trace(q, &out[i]);
+      continue;
+    }
+    EntityTransform xf;
+    CM_SetEntityTransform(&xf, q->origin, q->angles);
+    cHandle model = (q->kind == DRV_MODEL) ? CM_InlineModel(1) : CM_TempBoxModel(drv_entityMins, drv_entityMaxs, false);
+    CM_EntityBoxTrace(&out[i], q->start, q->end, q->mins, q->maxs, model, q->mask, &xf, q->capsule);
+  }
+}
+
+//..............................
+// Drv_RunJobs
+//   Every query as a trace job of the worker pool. Workers trace with their own query context, and so their own temp box:
+//   the entity queries can't be jobs, and are run afterwards on this thread
+//   The leaf and brush counters of the workers stay in their query contexts, so only the ones of this thread are counted
+//..............................
+static void Drv_RunJobs(const DrvQuery* queries, i32 count, Trace* out) {
+  TraceJob* jobs = Drv_Alloc(count * sizeof(TraceJob));
+  i32       num  = 0;
+  for (i32 i = 0; i < count; i++) {
+    const DrvQuery* q = &queries[i];
+    if (q->kind == DRV_ENTITY) { continue; }
+    TraceJob* j = &jobs[num++];
+    memset(j, 0, sizeof(*j));
+    GVec3Copy(q->start, j->start);
+    GVec3Copy(q->end, j->end);
+    GVec3Copy(q->mins, j->mins);
+    GVec3Copy(q->maxs, j->maxs);
+    j->brushmask   = q->mask;
+    j->capsule     = q->capsule;
+    j->model       = (q->kind == DRV_MODEL) ? CM_InlineModel(1) : 0;
+    j->transformed = q->kind == DRV_MODEL;
+    GVec3Copy(q->origin, j->origin);
+    GVec3Copy(q->angles, j->angles);
+  }
+  CM_JobsRun(jobs, num);
+  num = 0;
+  for (i32 i = 0; i < count; i++) {
+    if (queries[i].kind == DRV_ENTITY) {
+      Drv_Trace(&queries[i], &out[i]);
+    } else {
+      out[i] = jobs[num++].result;
+    }
+  }
+  free(jobs);
+}
+
+//..............................
+// Drv_Run
+//   Runs the set drv.repeat times through the entry points of drv.api, on the loaded map
+//   The point contents and leaf lists of the start points are taken afterwards, outside of the timing
+//..............................
+void Drv_Run(const DrvQuery* queries, i32 count, DrvResult* r) {
+  memset(r, 0, sizeof(*r));
+  r->traces   = Drv_Alloc(count * sizeof(Trace));
+  r->contents = Drv_Alloc(count * sizeof(i32));
+  r->leafs    = Drv_Alloc(count * sizeof(i32));
+  r->leafHash = Drv_Alloc(count * sizeof(i32));
+  if (drv.api == DRV_API_JOBS && !CM_JobsNumWorkers()) {
+    if (!CM_JobsInit(drv.workers)) { err(ERR_EXIT, "%s: couldn't start the worker pool", __func__); }
+  }
+  CM_ClearTraceCache();
+  c_leaf_traces  = 0;
+  c_brush_traces = 0;
+  c_patch_traces = 0;
+  f64 start      = Drv_Msec();
+  for (i32 n = 0; n < (drv.repeat > 0 ? drv.repeat : 1); n++) {
+    switch (drv.api) {
+      case DRV_API_BATCH: Drv_RunBatch(queries, count, r->traces); break;
+      case DRV_API_PACKET: Drv_RunPacket(queries, count, r->traces); break;
+      case DRV_API_GATHER: Drv_RunGather(queries, count, r->traces); break;
+      case DRV_API_QUERY: Drv_RunQuery(queries, count, r->traces, r); break;
+      case DRV_API_ENTITY: Drv_RunEntity(queries, count, r->traces); break;
+      case DRV_API_JOBS: Drv_RunJobs(queries, count, r->traces); break;
+      default:
+        for (i32 i = 0; i < count; i++) { Drv_Trace(&queries[i], &r->traces[i]); }
+        break;
+    }
+  }
+  r->msec = Drv_Msec() - start;
+  r->leafTraces += c_leaf_traces;
+  r->brushTraces += c_brush_traces;
+  r->patchTraces += c_patch_traces;
+  for (i32 i = 0; i < count; i++) {
+    const DrvQuery* q    = &queries[i];
+    vec3            mins = { q->start[0] - 64, q->start[1] - 64, q->start[2] - 64 };
+    vec3            maxs = { q->start[0] + 64, q->start[1] + 64, q->start[2] + 64 };
+    i32             list[1024];
+    i32             last;
+    r->contents[i] = CM_PointContents(q->start, 0);
+    r->leafs[i]    = CM_BoxLeafnums(mins, maxs, list, 1024, &last);
+    for (i32 j = 0; j < r->leafs[i]; j++) { r->leafHash[i] = r->leafHash[i] * 31 + list[j]; }
+  }
+}
+
+//..............................
+// Drv_FreeResult
+//..............................
+void Drv_FreeResult(DrvResult* r) {
+  free(r->traces);
+  free(r->contents);
+  free(r->leafs);
+  free(r->leafHash);
+  memset(r, 0, sizeof(*r));
+}
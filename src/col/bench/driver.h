@@ -0,0 +1,83 @@
+#ifndef COL_BENCH_DRIVER_H
+#define COL_BENCH_DRIVER_H
+//..............................
+
+// Collision module
+#include "../core.h"
+#include "../load.h"
+#include "../jobs.h"
+
+//..............................
+// Shared code of the parity and benchmark drivers
+//   Loads a map with a given set of col/load options, makes a reproducible set of queries for it, and runs them
+//..............................
+
+//..............................
+// Trace masks of the game code. The module only defines the contents
+#define DRV_MASK_SOLID (CONTENTS_SOLID)
+#define DRV_MASK_PLAYERSOLID (CONTENTS_SOLID | CONTENTS_PLAYERCLIP | CONTENTS_BODY)
+#define DRV_MASK_SHOT (CONTENTS_SOLID | CONTENTS_BODY | CONTENTS_CORPSE)
+#define DRV_MASK_WATER (CONTENTS_WATER | CONTENTS_LAVA | CONTENTS_SLIME)
+#define DRV_MASK_ALL (-1)
+
+//..............................
+// Kinds of queries, made in this order over and over
+typedef enum { DRV_POINT, DRV_POINT_LONG, DRV_BOX, DRV_BOX_LONG, DRV_SMALL, DRV_CAPSULE, DRV_POSITION, DRV_MODEL, DRV_ENTITY, DRV_KINDS } DrvKind;
+extern const char* drv_kindNames[DRV_KINDS];
+
+//..............................
+// One query of the set
+typedef struct {
+  DrvKind kind;
+  vec3    start;
+  vec3    end;
+  vec3    mins;
+  vec3    maxs;
+  i32     mask;
+  bool    capsule;
+  vec3    origin;  // of the inline model for DRV_MODEL, or of the box of another player for DRV_ENTITY
+  vec3    angles;
+} DrvQuery;
+
+//..............................
+// Ways of running the query set, to check them against each other
+typedef enum { DRV_API_TRACE, DRV_API_BATCH, DRV_API_PACKET, DRV_API_GATHER, DRV_API_QUERY, DRV_API_ENTITY, DRV_API_JOBS, DRV_API_COUNT } DrvApi;
+extern const char* drv_apiNames[DRV_API_COUNT];
+
+//..............................
+// Driver settings: what the options of the col and load config can't express
+typedef struct {
+  DrvApi api;      // entry points that the set is run through
+  i32    workers;  // threads of the worker pool, for DRV_API_JOBS. 0 starts one per online processor
+  i32    hulls;    // register the player box and the small box of the queries as hulls (CM_RegisterHull), before loading
+  i32    repeat;   // runs of the whole set, 0 for the default of the driver. Only the results of the last run are kept
+  i32    report;   // echo CM_MemoryReport after loading the map
+} DrvCfg;
+extern DrvCfg drv;
+
+//..............................
+// Results of running the set once
+typedef struct {
+  Trace* traces;    // [count]
+  i32*   contents;  // [count] CM_PointContents of the start point
+  i32*   leafs;     // [count] CM_BoxLeafnums of a box around the start point: the amount of leafs, and a hash of their numbers
+  i32*   leafHash;
+  i32    leafTraces;
+  i32    brushTraces;
+  i32    patchTraces;
+  f64    msec;  // of the traces alone
+} DrvResult;
+
+//..............................
+void  Drv_Init(void);
+bool  Drv_Setting(const char* setting);
+void  Drv_Apply(const char* settings);
+void  Drv_Load(const char* name);
+void  Drv_Queries(DrvQuery* out, i32 count, u32 seed);
+void  Drv_Run(const DrvQuery* queries, i32 count, DrvResult* out);
+void  Drv_FreeResult(DrvResult* r);
+f64   Drv_Msec(void);
+void* Drv_Alloc(size_t size);
+
+//..............................
+#endif  // COL_BENCH_DRIVER_H
@@ -0,0 +1,440 @@
+//..............................
+// mapgen : Synthetic map generator for the collision drivers
+//   Writes a version 46 bsp with random box and wedge brushes, some curved patches and one inline model,
+//   split by a tree like the one q3map writes, including splits through empty space that only vis would need
+//   Only the lumps that the collision module loads are filled. The brushes are written in a random order
+//   usage: mapgen file.bsp [seed] [brushes] [patches]
+//..............................
+#include <math.h>
+#include "../load.h"
+
+//..............................
+#define GEN_MAX_PLANES 65536
+#define GEN_MAX_BRUSHES 8192
+#define GEN_MAX_NODES 262144
+#define GEN_MAX_LEAFS 262144
+#define GEN_MAX_LEAFITEMS 4194304
+#define GEN_MAX_SURFS 1024
+#define GEN_EMPTY_SPLIT 512  // Empty regions wider than this get split in half, like the vis-only splits of q3map
+#define GEN_MAX_DEPTH 40
+#define GEN_WORLD 2048   // Half width of the world
+#define GEN_HEIGHT 1024  // Height of the world
+
+//..............................
+// Shaders of the generated map
+enum { SH_SOLID, SH_CLIP, SH_WATER, SH_CURVE, SH_SLICK, SH_COUNT };
+static dShader gen_shaders[SH_COUNT] = {
+  [SH_SOLID] = { "gen/solid", 0, CONTENTS_SOLID },
+  [SH_CLIP]  = { "gen/clip", 0, CONTENTS_PLAYERCLIP },
+  [SH_WATER] = { "gen/water", 0, CONTENTS_WATER },
+  [SH_CURVE] = { "gen/curve", 0, CONTENTS_SOLID },
+  [SH_SLICK] = { "gen/slick", SURF_SLICK, CONTENTS_SOLID },
+};
+
+//..............................
+// Generator state
+typedef struct {
+  f64 bounds[2][3];  // of the whole item, used to sort it into the regions of the tree
+  i32 brush;         // index into gen_brushes, or -1
+  i32 surf;          // index into gen_surfs, or -1
+} GenItem;
+static dPlane   gen_planes[GEN_MAX_PLANES];
+static i32      gen_numPlanes;
+static dBSide_t gen_sides[GEN_MAX_BRUSHES * 8];
+static i32      gen_numSides;
+static dBrush   gen_brushes[GEN_MAX_BRUSHES];
+static i32      gen_numBrushes;
+static dNode    gen_nodes[GEN_MAX_NODES];
+static i32      gen_numNodes;
+static dLeaf    gen_leafs[GEN_MAX_LEAFS];
+static i32      gen_numLeafs;
+static i32      gen_leafBrushes[GEN_MAX_LEAFITEMS];
+static i32      gen_numLeafBrushes;
+static i32      gen_leafSurfs[GEN_MAX_LEAFITEMS];
+static i32      gen_numLeafSurfs;
+static dSurf    gen_surfs[GEN_MAX_SURFS];
+static i32      gen_numSurfs;
+static dVert    gen_verts[GEN_MAX_SURFS * 15];
+static i32      gen_numVerts;
+static bool     gen_sloped[GEN_MAX_BRUSHES];  // the sloped side of the brush already split a region
+static GenItem  gen_items[GEN_MAX_BRUSHES + GEN_MAX_SURFS];
+static i32      gen_numItems;
+static u32      gen_seed;
+
+//..............................
+// Gen_Rand
+//   Returns a random number in [lo, hi], in steps of `step`. Same sequence for the same seed on every platform
+//..............................
+static i32 Gen_Rand(i32 lo, i32 hi, i32 step) {
+  gen_seed = gen_seed * 1664525u + 1013904223u;
+  i32 n    = (hi - lo) / step + 1;
+  return lo + (i32)((gen_seed >> 8) % (u32)n) * step;
+}
+
+//..............................
+// Gen_Plane
+//   Returns the index of the given plane, adding it and its opposite when new. Plane x^1 is always the opposite of plane x
+//..............................
+static i32 Gen_Plane(f32 nx, f32 ny, f32 nz, f32 dist) {
+  for (i32 i = 0; i < gen_numPlanes; i++) {
+    const dPlane* p = &gen_planes[i];
+    if (p->normal[0] == nx && p->normal[1] == ny && p->normal[2] == nz && p->dist == dist) { return i; }
+  }
+  if (gen_numPlanes + 2 > GEN_MAX_PLANES) { err(ERR_EXIT, "%s: GEN_MAX_PLANES", __func__); }
+  gen_planes[gen_numPlanes]     = (dPlane){ { nx, ny, nz }, dist };
+  gen_planes[gen_numPlanes + 1] = (dPlane){ { -nx, -ny, -nz }, -dist };
+  gen_numPlanes += 2;
+  return gen_numPlanes - 2;
+}
+
+//..............................
+// Gen_Brush
+//   Adds a box brush, with a sloped side cutting its top edge along x when `wedge`
+//   The six axial sides come first, in the order that CM_BoundBrush expects
+//..............................
+static void Gen_Brush(const i32 mins[3], const i32 maxs[3], i32 shader, bool wedge) {
+  if (gen_numBrushes >= GEN_MAX_BRUSHES) { err(ERR_EXIT, "%s: GEN_MAX_BRUSHES", __func__); }
+  dBrush* b    = &gen_brushes[gen_numBrushes];
+  b->firstSide = gen_numSides;
+  b->shaderNum = shader;
+  for (i32 axis = 0; axis < 3; axis++) {
+    f32 n[3] = { 0, 0, 0 };
+    n[axis]  = -1;
+    gen_sides[gen_numSides++] = (dBSide_t){ Gen_Plane(n[0], n[1], n[2], -mins[axis]), shader };
+    n[axis]  = 1;
+    gen_sides[gen_numSides++] = (dBSide_t){ Gen_Plane(n[0], n[1], n[2], maxs[axis]), shader };
+  }
+  if (wedge) {  // plane through the middle of the top face and the middle of the +x face
+    f64 n[3] = { 1, 0, 1 };
+    f64 len  = sqrt(2.0);
+    f64 p[3] = { maxs[0], 0, (mins[2] + maxs[2]) * 0.5 };
+    f64 d    = (n[0] * p[0] + n[2] * p[2]) / len;
+    gen_sides[gen_numSides++] = (dBSide_t){ Gen_Plane((f32)(n[0] / len), 0, (f32)(n[2] / len), (f32)d), shader };
+  }
+  b->numSides = gen_numSides - b->firstSide;
+  gen_numBrushes++;
+}
+
+//..............................
+// Gen_Patch
+//   Adds a 3x3 patch arching over the given box along x, or a 5x3 bump when `wide`
+//..............................
+static void Gen_Patch(const i32 mins[3], const i32 maxs[3], bool wide) {
+  if (gen_numSurfs >= GEN_MAX_SURFS) { err(ERR_EXIT, "%s: GEN_MAX_SURFS", __func__); }
+  dSurf* s       = &gen_surfs[gen_numSurfs++];
+  s->shaderNum   = SH_CURVE;
+  s->fogNum      = -1;
+  s->surfaceType = MST_PATCH;
+  s->firstVert   = gen_numVerts;
+  s->patchWidth  = wide ? 5 : 3;
+  s->patchHeight = 3;
+  s->numVerts    = s->patchWidth * s->patchHeight;
+  for (i32 j = 0; j < s->patchHeight; j++) {
+    for (i32 i = 0; i < s->patchWidth; i++) {
+      f32  u = (f32)i / (s->patchWidth - 1);
+      f32  v = (f32)j / (s->patchHeight - 1);
+      f32* p = gen_verts[gen_numVerts++].xyz;
+      p[0]   = mins[0] + u * (maxs[0] - mins[0]);
+      p[1]   = mins[1] + v * (maxs[1] - mins[1]);
+      p[2]   = (i == 0 || i == s->patchWidth - 1) ? mins[2] : maxs[2];  // the middle rows are the top of the arch
+      if (wide && j == 1) { p[2] = (p[2] + maxs[2]) * 0.5f; }
+    }
+  }
+}
+
+//..............................
+// Gen_Side
+//   Returns which sides of the plane the item reaches: 1 front, 2 back, 3 both
+//..............................
+static i32 Gen_Side(const GenItem* it, const dPlane* p) {
+  f64 lo = 0, hi = 0;
+  for (i32 j = 0; j < 3; j++) {
+    f64 a = p->normal[j] * it->bounds[0][j];
+    f64 b = p->normal[j] * it->bounds[1][j];
+    lo += a < b ? a : b;
+    hi += a < b ? b : a;
+  }
+  i32 side = 0;
+  if (hi > p->dist) { side |= 1; }
+  if (lo < p->dist) { side |= 2; }
+  return side ? side : 3;  // on the plane
+}
+
+//..............................
+// Gen_Leaf
+//   Stores a leaf with the given items, and returns its child number
+//..............................
+static i32 Gen_Leaf(const i32* items, i32 count, const f64 region[2][3]) {
+  if (gen_numLeafs >= GEN_MAX_LEAFS) { err(ERR_EXIT, "%s: GEN_MAX_LEAFS", __func__); }
+  dLeaf* leaf            = &gen_leafs[gen_numLeafs];
+  leaf->cluster          = gen_numLeafs & 7;
+  leaf->area             = 0;
+  leaf->firstLeafBrush   = gen_numLeafBrushes;
+  leaf->firstLeafSurface = gen_numLeafSurfs;
+  for (i32 i = 0; i < count; i++) {
+    const GenItem* it = &gen_items[items[i]];
+    if (it->brush >= 0) { gen_leafBrushes[gen_numLeafBrushes++] = it->brush; }
+    if (it->surf >= 0) { gen_leafSurfs[gen_numLeafSurfs++] = it->surf; }
+  }
+  leaf->numLeafBrushes  = gen_numLeafBrushes - leaf->firstLeafBrush;
+  leaf->numLeafSurfaces = gen_numLeafSurfs - leaf->firstLeafSurface;
+  for (i32 j = 0; j < 3; j++) {
+    leaf->mins[j] = (i32)floor(region[0][j]);
+    leaf->maxs[j] = (i32)ceil(region[1][j]);
+  }
+  return -1 - gen_numLeafs++;
+}
+
+//..............................
+// Gen_Split
+//   Picks the plane that best balances the items of the region: a face of their bounds inside it,
+//   or the sloped side of a wedge every few levels, so that the tree has non-axial node planes too
+//   Returns -1 when no face is left inside the region
+//..............................
+static i32 Gen_Split(const i32* items, i32 count, const f64 region[2][3], i32 depth) {
+  if (depth % 4 == 3) {
+    for (i32 i = 0; i < count; i++) {
+      const GenItem* it = &gen_items[items[i]];
+      if (it->brush < 0 || gen_brushes[it->brush].numSides < 7 || gen_sloped[it->brush]) { continue; }
+      i32 planeNum = gen_sides[gen_brushes[it->brush].firstSide + 6].planeNum;
+      i32 front = 0, back = 0;
+      for (i32 k = 0; k < count; k++) {
+        i32 side = Gen_Side(&gen_items[items[k]], &gen_planes[planeNum]);
+        front += side & 1;
+        back += side >> 1;
+      }
+      if (front < count && back < count) {
+        gen_sloped[it->brush] = true;
+        return planeNum;
+      }
+    }
+  }
+  i32 best = -1, bestScore = MAX_I32;
+  for (i32 i = 0; i < count; i++) {
+    const GenItem* it = &gen_items[items[i]];
+    for (i32 axis = 0; axis < 3; axis++) {
+      for (i32 m = 0; m < 2; m++) {
+        f64 d = it->bounds[m][axis];
+        if (d <= region[0][axis] || d >= region[1][axis]) { continue; }
+        i32 front = 0, back = 0;
+        for (i32 k = 0; k < count; k++) {
+          const GenItem* o = &gen_items[items[k]];
+          if (o->bounds[1][axis] > d) { front++; }
+          if (o->bounds[0][axis] < d) { back++; }
+        }
+        i32 score = abs(front - back) + 2 * (front + back - count);
+        if (score >= bestScore) { continue; }
+        f32 n[3]  = { 0, 0, 0 };
+        n[axis]   = 1;
+        best      = Gen_Plane(n[0], n[1], n[2], (f32)d);
+        bestScore = score;
+      }
+    }
+  }
+  return best;
+}
+
+//..............................
+// Gen_Tree
+//   Splits the region by the faces of its items until none is left inside, like q3map does, and returns the child number of its root
+//   Leafs end up empty or inside brushes, with a few leafs of items that the sloped sides didn't separate
+//..............................
+static i32 Gen_Tree(const i32* items, i32 count, const f64 region[2][3], i32 depth) {
+  i32 planeNum = -1;
+  if (depth < GEN_MAX_DEPTH && count) { planeNum = Gen_Split(items, count, region, depth); }
+  if (planeNum < 0 && !count && depth < GEN_MAX_DEPTH) {  // vis-only split of an empty region, at the middle of its widest axis
+    i32 axis = 0;
+    for (i32 j = 1; j < 3; j++) {
+      if (region[1][j] - region[0][j] > region[1][axis] - region[0][axis]) { axis = j; }
+    }
+    if (region[1][axis] - region[0][axis] > GEN_EMPTY_SPLIT) {
+      f32 n[3] = { 0, 0, 0 };
+      n[axis]  = 1;
+      planeNum = Gen_Plane(n[0], n[1], n[2], (f32)floor((region[0][axis] + region[1][axis]) * 0.5));
+    }
+  }
+  if (planeNum < 0) { return Gen_Leaf(items, count, region); }
+  if (gen_numNodes >= GEN_MAX_NODES) { err(ERR_EXIT, "%s: GEN_MAX_NODES", __func__); }
+  i32    num  = gen_numNodes++;
+  dNode* node = &gen_nodes[num];
+  node->planeNum = planeNum;
+  for (i32 j = 0; j < 3; j++) {
+    node->mins[j] = (i32)floor(region[0][j]);
+    node->maxs[j] = (i32)ceil(region[1][j]);
+  }
+  // sort the items into both sides. The regions of the children only shrink on axial planes
+  const dPlane* p    = &gen_planes[planeNum];
+  i32*          side = malloc((count ? count : 1) * 2 * sizeof(i32));
+  i32           numSide[2] = { 0, 0 };
+  for (i32 i = 0; i < count; i++) {
+    i32 s = Gen_Side(&gen_items[items[i]], p);
+    if (s & 1) { side[numSide[0]++] = items[i]; }
+    if (s & 2) { side[count + numSide[1]++] = items[i]; }
+  }
+  f64 sub[2][2][3];
+  memcpy(sub[0], region, sizeof(sub[0]));
+  memcpy(sub[1], region, sizeof(sub[1]));
+  i32 axis = PlaneTypeForNormal(p->normal);
+  if (axis < 3) {
+    sub[0][0][axis] = p->dist;
+    sub[1][1][axis] = p->dist;
+  }
+  i32 front = Gen_Tree(side, numSide[0], (const f64(*)[3])sub[0], depth + 1);
+  i32 back  = Gen_Tree(side + count, numSide[1], (const f64(*)[3])sub[1], depth + 1);
+  free(side);
+  gen_nodes[num].children[0] = front;
+  gen_nodes[num].children[1] = back;
+  return num;
+}
+
+//..............................
+// Gen_Shuffle
+//   Writes the brushes in a random order, like the order of the entities in the .map file that q3map keeps
+//   Only the first `count` brushes are shuffled, the ones of the inline model stay at the end
+//..............................
+static void Gen_Shuffle(i32 count) {
+  i32* to = malloc(count * sizeof(i32));
+  for (i32 i = 0; i < count; i++) { to[i] = i; }
+  for (i32 i = count - 1; i > 0; i--) {
+    i32 j = Gen_Rand(0, i, 1);
+    i32 t = to[i];
+    to[i] = to[j];
+    to[j] = t;
+  }
+  dBrush* copy = malloc(count * sizeof(dBrush));
+  memcpy(copy, gen_brushes, count * sizeof(dBrush));
+  for (i32 i = 0; i < count; i++) { gen_brushes[to[i]] = copy[i]; }
+  for (i32 i = 0; i < gen_numLeafBrushes; i++) { gen_leafBrushes[i] = to[gen_leafBrushes[i]]; }
+  free(copy);
+  free(to);
+}
+
+//..............................
+// Gen_Lump
+//..............................
+static void Gen_Lump(FILE* file, dHeader* header, i32 lump, const void* data, i32 size) {
+  header->lumps[lump].fileofs = (i32)ftell(file);
+  header->lumps[lump].filelen = size;
+  if (size) { fwrite(data, 1, size, file); }
+  while (ftell(file) & 3) { fputc(0, file); }
+}
+
+//..............................
+// Entry Point
+//..............................
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s file.bsp [seed] [brushes] [patches]\n", argv[0]);
+    return 1;
+  }
+  gen_seed        = argc > 2 ? (u32)atoi(argv[2]) : 1;
+  i32 numRandom   = argc > 3 ? atoi(argv[3]) : 600;
+  i32 numPatches  = argc > 4 ? atoi(argv[4]) : 20;
+  const i32 W     = GEN_WORLD;
+  const i32 H     = GEN_HEIGHT;
+  // floor, ceiling and walls
+  Gen_Brush((i32[]){ -W, -W, -64 }, (i32[]){ W, W, 0 }, SH_SOLID, false);
+  Gen_Brush((i32[]){ -W, -W, H }, (i32[]){ W, W, H + 64 }, SH_SOLID, false);
+  Gen_Brush((i32[]){ -W - 64, -W, 0 }, (i32[]){ -W, W, H }, SH_SOLID, false);
+  Gen_Brush((i32[]){ W, -W, 0 }, (i32[]){ W + 64, W, H }, SH_SOLID, false);
+  Gen_Brush((i32[]){ -W, -W - 64, 0 }, (i32[]){ W, -W, H }, SH_SOLID, false);
+  Gen_Brush((i32[]){ -W, W, 0 }, (i32[]){ W, W + 64, H }, SH_SOLID, false);
+  // clusters of boxes, wedges, clip and water, around a few random centers like the rooms of a map
+  i32 cx = 0, cy = 0;
+  for (i32 i = 0; i < numRandom; i++) {
+    if (i % 8) {  // near the previous one
+      cx += Gen_Rand(-96, 96, 8);
+      cy += Gen_Rand(-96, 96, 8);
+      cx = cx < -W + 64 ? -W + 64 : cx > W - 64 ? W - 64 : cx;
+      cy = cy < -W + 64 ? -W + 64 : cy > W - 64 ? W - 64 : cy;
+    } else {
+      cx = Gen_Rand(-W + 256, W - 256, 8);
+      cy = Gen_Rand(-W + 256, W - 256, 8);
+    }
+    i32 sx = Gen_Rand(8, 128, 8), sy = Gen_Rand(8, 128, 8), sz = Gen_Rand(8, 256, 8);
+    i32 z  = Gen_Rand(0, H - 256, 8) * (Gen_Rand(0, 3, 1) == 0);
+    i32 kind    = Gen_Rand(0, 19, 1);
+    i32 shader  = kind == 0 ? SH_CLIP : kind == 1 ? SH_WATER : kind == 2 ? SH_SLICK : SH_SOLID;
+    bool wedge  = kind >= 3 && kind < 7;
+    i32 mins[3] = { cx - sx, cy - sy, z };
+    i32 maxs[3] = { cx + sx, cy + sy, z + sz };
+    for (i32 j = 0; j < 2; j++) {
+      if (mins[j] < -W) { mins[j] = -W; }
+      if (maxs[j] > W) { maxs[j] = W; }
+    }
+    Gen_Brush(mins, maxs, shader, wedge);
+  }
+  i32 numWorld = gen_numBrushes;
+  for (i32 i = 0; i < numPatches; i++) {
+    i32 cx = Gen_Rand(-W + 256, W - 256, 8), cy = Gen_Rand(-W + 256, W - 256, 8);
+    i32 sx = Gen_Rand(32, 192, 8), sy = Gen_Rand(32, 192, 8), z = Gen_Rand(0, 512, 8), sz = Gen_Rand(32, 256, 8);
+    Gen_Patch((i32[]){ cx - sx, cy - sy, z }, (i32[]){ cx + sx, cy + sy, z + sz }, i & 1);
+  }
+  // inline model: a door, outside of the world tree
+  Gen_Brush((i32[]){ -32, -8, 0 }, (i32[]){ 32, 8, 128 }, SH_SOLID, false);
+  Gen_Brush((i32[]){ -32, -8, 128 }, (i32[]){ 32, 8, 144 }, SH_SOLID, true);
+
+  // items of the world tree
+  for (i32 i = 0; i < numWorld; i++) {
+    GenItem* it = &gen_items[gen_numItems++];
+    it->brush   = i;
+    it->surf    = -1;
+    for (i32 j = 0; j < 3; j++) {
+      it->bounds[0][j] = -gen_planes[gen_sides[gen_brushes[i].firstSide + j * 2].planeNum].dist;
+      it->bounds[1][j] = gen_planes[gen_sides[gen_brushes[i].firstSide + j * 2 + 1].planeNum].dist;
+    }
+  }
+  for (i32 i = 0; i < gen_numSurfs; i++) {
+    GenItem* it = &gen_items[gen_numItems++];
+    it->brush   = -1;
+    it->surf    = i;
+    for (i32 j = 0; j < 3; j++) {
+      it->bounds[0][j] = MAX_I32;
+      it->bounds[1][j] = -MAX_I32;
+    }
+    for (i32 v = 0; v < gen_surfs[i].numVerts; v++) {
+      const f32* p = gen_verts[gen_surfs[i].firstVert + v].xyz;
+      for (i32 j = 0; j < 3; j++) {
+        if (p[j] < it->bounds[0][j]) { it->bounds[0][j] = p[j]; }
+        if (p[j] > it->bounds[1][j]) { it->bounds[1][j] = p[j]; }
+      }
+    }
+  }
+  i32* items = malloc(gen_numItems * sizeof(i32));
+  for (i32 i = 0; i < gen_numItems; i++) { items[i] = i; }
+  const f64 world[2][3] = { { -W - 128, -W - 128, -128 }, { W + 128, W + 128, H + 128 } };
+  Gen_Tree(items, gen_numItems, world, 0);
+  free(items);
+  Gen_Shuffle(numWorld);
+
+  dModel models[2] = {
+    { { -W - 64, -W - 64, -64 }, { W + 64, W + 64, H + 64 }, 0, gen_numSurfs, 0, numWorld },
+    { { -32, -8, 0 }, { 32, 8, 144 }, gen_numSurfs, 0, numWorld, 2 },
+  };
+  const char* entities = "{\n\"classname\" \"worldspawn\"\n}\n{\n\"classname\" \"func_door\"\n\"model\" \"*1\"\n}\n";
+
+  FILE* file = fopen(argv[1], "wb");
+  if (!file) {
+    fprintf(stderr, "couldn't write %s\n", argv[1]);
+    return 1;
+  }
+  dHeader header = { .ident = 'I' | 'B' << 8 | 'S' << 16 | 'P' << 24, .version = BSP_VERSION };
+  fwrite(&header, sizeof(header), 1, file);
+  Gen_Lump(file, &header, LUMP_ENTITIES, entities, (i32)strlen(entities) + 1);
+  Gen_Lump(file, &header, LUMP_SHADERS, gen_shaders, sizeof(gen_shaders));
+  Gen_Lump(file, &header, LUMP_PLANES, gen_planes, gen_numPlanes * sizeof(dPlane));
+  Gen_Lump(file, &header, LUMP_NODES, gen_nodes, gen_numNodes * sizeof(dNode));
+  Gen_Lump(file, &header, LUMP_LEAFS, gen_leafs, gen_numLeafs * sizeof(dLeaf));
+  Gen_Lump(file, &header, LUMP_LEAFSURFACES, gen_leafSurfs, gen_numLeafSurfs * sizeof(i32));
+  Gen_Lump(file, &header, LUMP_LEAFBRUSHES, gen_leafBrushes, gen_numLeafBrushes * sizeof(i32));
+  Gen_Lump(file, &header, LUMP_MODELS, models, sizeof(models));
+  Gen_Lump(file, &header, LUMP_BRUSHES, gen_brushes, gen_numBrushes * sizeof(dBrush));
+  Gen_Lump(file, &header, LUMP_BSideS, gen_sides, gen_numSides * sizeof(dBSide_t));
+  Gen_Lump(file, &header, LUMP_DRAWVERTS, gen_verts, gen_numVerts * sizeof(dVert));
+  Gen_Lump(file, &header, LUMP_SURFACES, gen_surfs, gen_numSurfs * sizeof(dSurf));
+  fseek(file, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, file);
+  fclose(file);
+  printf("%s: %i brushes, %i patches, %i planes, %i nodes, %i leafs\n", argv[1], gen_numBrushes, gen_numSurfs, gen_numPlanes, gen_numNodes, gen_numLeafs);
+  return 0;
+}
@@ -0,0 +1,95 @@
+//..............................
+// parity : Runs the same query set with two configs of the module, and diffs the results
+//   usage: parity file.bsp "settings A" "settings B" [queries] [seed]
+//   Settings are comma separated `name=value` pairs (see Drv_Setting), applied on top of the defaults of CM_InitCfg
+//   The map is loaded again for each side, so the load options can differ between them
+//   Reports the traces that hit something else (fraction, end position or solid flags), and the ties apart:
+//   the same fraction against another plane or surface, or other solid flags of a trace that stops at its start,
+//   that the order in which the brushes are tested decides
+//   Also reports the leafs and brushes that each side visited. Exits with 1 when any result differs, not counting ties
+//..............................
+#include <math.h>
+#include "./driver.h"
+
+//..............................
+// Parity_Side
+//   Loads the map with the given settings and runs the set on it
+//..............................
+static void Parity_Side(const char* map, const char* settings, DrvQuery* queries, i32 count, u32 seed, DrvResult* out) {
+  Drv_Apply(settings);
+  Drv_Load(map);
+  Drv_Queries(queries, count, seed);
+  Drv_Run(queries, count, out);
+  printf("  %-28s leafs %9i  brushes %9i  patches %8i  %8.1f msec\n", settings[0] ? settings : "(defaults)", out->leafTraces, out->brushTraces,
+         out->patchTraces, out->msec);
+}
+
+//..............................
+// Parity_Same
+//   Returns 0 when both traces are the same, 1 for a tie (same fraction, another plane or surface, or solid flags at fraction 0) and 2 otherwise
+//..............................
+static i32 Parity_Same(const Trace* a, const Trace* b) {
+  if (fabsf(a->fraction - b->fraction) > 1e-5f) { return 2; }
+  for (i32 j = 0; j < 3; j++) {
+    if (fabsf(a->endpos[j] - b->endpos[j]) > 0.01f) { return 2; }
+  }
+  if (a->allsolid != b->allsolid || a->startsolid != b->startsolid) {
+    // Every walk stops at the first brush that gives fraction 0: a brush that the start only touches (within SURFACE_CLIP_EPSILON)
+    // hides the one that contains it, when it is tested first. Which one is, the order of the tests decides
+    return (!a->fraction && !b->fraction) ? 1 : 2;
+  }
+  if (a->allsolid) { return 0; }  // the plane of an allsolid trace is not valid
+  if (a->fraction == 1.0f) { return 0; }
+  if (a->surfaceFlags != b->surfaceFlags || a->contents != b->contents || a->plane.dist != b->plane.dist) { return 1; }
+  for (i32 j = 0; j < 3; j++) {
+    if (a->plane.normal[j] != b->plane.normal[j]) { return 1; }
+  }
+  return 0;
+}
+
+//..............................
+// Entry Point
+//..............................
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    fprintf(stderr, "usage: %s file.bsp \"settings A\" \"settings B\" [queries] [seed]\n", argv[0]);
+    return 1;
+  }
+  const char* map   = argv[1];
+  i32         count = argc > 4 ? atoi(argv[4]) : 40000;
+  u32         seed  = argc > 5 ? (u32)atoi(argv[5]) : 1;
+  Drv_Init();
+  DrvQuery* queries = Drv_Alloc(count * sizeof(DrvQuery));
+  DrvResult a, b;
+  printf("%s: %i queries, seed %u\n", map, count, seed);
+  Parity_Side(map, argv[2], queries, count, seed, &a);
+  Parity_Side(map, argv[3], queries, count, seed, &b);
+
+  i32 differ[DRV_KINDS] = { 0 }, ties[DRV_KINDS] = { 0 }, numDiffer = 0, numTies = 0, contents = 0, leafs = 0;
+  for (i32 i = 0; i < count; i++) {
+    const DrvQuery* q    = &queries[i];
+    i32             same = Parity_Same(&a.traces[i], &b.traces[i]);
+    if (same == 2) {
+      if (numDiffer < 8) {
+        printf("  differ %6i %-10s start (%.2f %.2f %.2f) end (%.2f %.2f %.2f) mask %08x: frac %f/%f solid %i%i/%i%i\n", i, drv_kindNames[q->kind],
+               q->start[0], q->start[1], q->start[2], q->end[0], q->end[1], q->end[2], q->mask, a.traces[i].fraction, b.traces[i].fraction,
+               a.traces[i].startsolid, a.traces[i].allsolid, b.traces[i].startsolid, b.traces[i].allsolid);
+      }
+      differ[q->kind]++;
+      numDiffer++;
+    } else if (same == 1) {
+      ties[q->kind]++;
+      numTies++;
+    }
+    if (a.contents[i] != b.contents[i]) { contents++; }
+    if (a.leafs[i] != b.leafs[i] || a.leafHash[i] != b.leafHash[i]) { leafs++; }
+  }
+  for (i32 k = 0; k < DRV_KINDS; k++) {
+    if (differ[k] || ties[k]) { printf("  %-10s differ %6i  ties %6i\n", drv_kindNames[k], differ[k], ties[k]); }
+  }
+  printf("differ %i  ties %i  point contents %i  box leafs %i  (of %i)\n", numDiffer, numTies, contents, leafs, count);
+  Drv_FreeResult(&a);
+  Drv_FreeResult(&b);
+  free(queries);
+  return (numDiffer || contents || leafs) ? 1 : 0;
+}
@@ -0,0 +1,337 @@
+#include "../solve.h"
+
+//..................
+// Solve: Brush BVH
+//   Bounding volume hierarchy of the brushes and patches of the world, built at load with the surface area heuristic (SAH)
+//   Alternative to the BSP tree for the world traces, position tests and point contents (col.doBVH)
+//   The BSP was split for visibility, so a large box often touches many leafs that reference the same brushes
+//   Every brush or patch is stored once in the BVH, so its walks don't need the checkcount marks
+//..................
+
+//..................
+// Build state
+typedef struct {
+  vec3 bounds[2];
+  vec3 center;
+  i32  id;  // brush number, or -1-surfnum for patches
+} BVHItem;
+typedef struct {
+  BVHItem* items;
+  cBNode*  nodes;
+  i32      numNodes;
+} BVHBuild;
+
+//..................
+// CM_BVHArea
+//   Half the surface area of the given box, as used by the SAH costs
+//..................
+static f32 CM_BVHArea(const vec3 mins, const vec3 maxs) {
+  vec3 d;
+  GVec3Sub(maxs, mins, d);
+  return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+//..................
+// CM_BVHAddBounds
+//   Grows the given box to contain the other one
+//..................
+static void CM_BVHAddBounds(vec3 mins, vec3 maxs, const vec3 mins2, const vec3 maxs2) {
+  for (i32 i = 0; i < 3; i++) {
+    if (mins2[i] < mins[i]) { mins[i] = mins2[i]; }
+    if (maxs2[i] > maxs[i]) { maxs[i] = maxs2[i]; }
+  }
+}
+
+//..................
+// CM_BVHFindSplit
+//   Finds the binned split with the lowest SAH cost for the given items
+//   Returns the amount of items that go into the first child, or 0 when the items should not be split
+//   The items are partitioned in place, the first child taking the items before the split
+//..................
+static i32 CM_BVHFindSplit(BVHItem* items, i32 count, f32 nodeArea) {
+  // bounds of the centers
+  vec3 cmins, cmaxs;
+  GVec3Copy(items[0].center, cmins);
+  GVec3Copy(items[0].center, cmaxs);
+  for (i32 i = 1; i < count; i++) { CM_BVHAddBounds(cmins, cmaxs, items[i].center, items[i].center); }
+
+  f32 bestCost = count * nodeArea;  // cost of a leaf
+  i32 bestAxis = -1;
+  i32 bestBin  = 0;
+  for (i32 axis = 0; axis < 3; axis++) {
+    f32 extent = cmaxs[axis] - cmins[axis];
+    if (extent <= 0) { continue; }
+    // fill the bins
+    i32  binCount[BVH_BINS] = { 0 };
+    vec3 binBounds[BVH_BINS][2];
+    f32  scale = BVH_BINS / extent;
+    for (i32 i = 0; i < count; i++) {
+      i32 bin = (i32)((items[i].center[axis] - cmins[axis]) * scale);
+      if (bin >= BVH_BINS) { bin = BVH_BINS - 1; }
+      if (!binCount[bin]++) {
+        GVec3Copy(items[i].bounds[0], binBounds[bin][0]);
+        GVec3Copy(items[i].bounds[1], binBounds[bin][1]);
+      } else {
+        CM_BVHAddBounds(binBounds[bin][0], binBounds[bin][1], items[i].bounds[0], items[i].bounds[1]);
+      }
+    }
+    // area of the items after each split, sweeping from the end
+    f32  rightArea[BVH_BINS];
+    i32  rightCount[BVH_BINS];
+    vec3 mins, maxs;
+    i32  n = 0;
+    for (i32 bin = BVH_BINS - 1; bin > 0; bin--) {
+      if (binCount[bin]) {
+        if (!n) {
+          GVec3Copy(binBounds[bin][0], mins);
+          GVec3Copy(binBounds[bin][1], maxs);
+        } else {
+          CM_BVHAddBounds(mins, maxs, binBounds[bin][0], binBounds[bin][1]);
+        }
+        n += binCount[bin];
+      }
+      rightCount[bin] = n;
+      rightArea[bin]  = n ? CM_BVHArea(mins, maxs) : 0;
+    }
+    // cost of each split, sweeping from the start
+    n = 0;
+    for (i32 bin = 0; bin < BVH_BINS - 1; bin++) {
+      if (binCount[bin]) {
+        if (!n) {
+          GVec3Copy(binBounds[bin][0], mins);
+          GVec3Copy(binBounds[bin][1], maxs);
+        } else {
+          CM_BVHAddBounds(mins, maxs, binBounds[bin][0], binBounds[bin][1]);
+        }
+        n += binCount[bin];
+      }
+      if (!n || !rightCount[bin + 1]) { continue; }
+      f32 cost = n * CM_BVHArea(mins, maxs) + rightCount[bin + 1] * rightArea[bin + 1];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestAxis = axis;
+        bestBin  = bin;
+      }
+    }
+  }
+  if (bestAxis < 0) {
+    // nothing better than a leaf. Still split nodes that are too large, in their original order
+    return (count > BVH_LEAF_ITEMS * 4) ? count / 2 : 0;
+  }
+
+  // partition the items
+  f32 extent = cmaxs[bestAxis] - cmins[bestAxis];
+  f32 scale  = BVH_BINS / extent;
+  i32 first  = 0;
+  for (i32 i = 0; i < count; i++) {
+    i32 bin = (i32)((items[i].center[bestAxis] - cmins[bestAxis]) * scale);
+    if (bin >= BVH_BINS) { bin = BVH_BINS - 1; }
+    if (bin > bestBin) { continue; }
+    BVHItem tmp    = items[first];
+    items[first++] = items[i];
+    items[i]       = tmp;
+  }
+  return first;
+}
+
+//..................
+// CM_BVHBuildNode
+//   Builds the subtree for the given range of items, in depth-first order
+//   Returns the number of its root node
+//..................
+static i32 CM_BVHBuildNode(BVHBuild* b, i32 first, i32 count, i32 depth) {
+  i32      num   = b->numNodes++;
+  cBNode*  node  = &b->nodes[num];
+  BVHItem* items = &b->items[first];
+  GVec3Copy(items[0].bounds[0], node->mins);
+  GVec3Copy(items[0].bounds[1], node->maxs);
+  for (i32 i = 1; i < count; i++) { CM_BVHAddBounds(node->mins, node->maxs, items[i].bounds[0], items[i].bounds[1]); }
+
+  i32 split = 0;
+  if (count > BVH_LEAF_ITEMS && depth < MAX_BVH_DEPTH - 1) { split = CM_BVHFindSplit(items, count, CM_BVHArea(node->mins, node->maxs)); }
+  if (!split) {
+    node->first = first;
+    node->count = count;
+    return num;
+  }
+  CM_BVHBuildNode(b, first, split, depth + 1);  // always num+1
+  node->first = CM_BVHBuildNode(b, first + split, count - split, depth + 1);
+  node->count = 0;
+  return num;
+}
+
+//..................
+// CM_BuildBVH
+//   Builds cm.bvhNodes and cm.bvhItems from the brushes and patches referenced by the leafs of the world
+//   Brushes of the submodels are not part of it, they are traced through their own model
+//..................
+void CM_BuildBVH(void) {
+  // find the brushes and patches of the world
+  byte* used = Hunk_AllocateTempMemory(cm.numBrushes + cm.numSurfaces);
+  memset(used, 0, cm.numBrushes + cm.numSurfaces);
+  i32 count = 0;
+  for (i32 i = 0; i < cm.numLeafs; i++) {
+    const cLeaf* leaf = &cm.leafs[i];
+    for (i32 k = 0; k < leaf->numLeafBrushes; k++) {
+      i32 brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
+      if (!used[brushnum] && cm.brushes[brushnum].numsides) {
+        used[brushnum] = 1;
+        count++;
+      }
+    }
+    for (i32 k = 0; k < leaf->numLeafSurfaces; k++) {
+      i32 surfnum = cm.leafsurfaces[leaf->firstLeafSurface + k];
+      if (!used[cm.numBrushes + surfnum] && cm.surfaces[surfnum]) {
+        used[cm.numBrushes + surfnum] = 1;
+        count++;
+      }
+    }
+  }
+  if (!count) {
+    Hunk_FreeTempMemory(used);
+    return;
+  }
+
+  // gather their bounds
+  BVHBuild b;
+  b.items    = Hunk_AllocateTempMemory(count * sizeof(*b.items));
+  b.nodes    = Hunk_AllocateTempMemory((2 * count - 1) * sizeof(*b.nodes));
+  b.numNodes = 0;
+  i32 n      = 0;
+  for (i32 i = 0; i < cm.numBrushes + cm.numSurfaces; i++) {
+    if (!used[i]) { continue; }
+    BVHItem* item = &b.items[n++];
+    if (i < cm.numBrushes) {
+      item->id = i;
+      GVec3Copy(cm.brushes[i].bounds[0], item->bounds[0]);
+      GVec3Copy(cm.brushes[i].bounds[1], item->bounds[1]);
+    } else {
+      const PatchCol* pc = cm.surfaces[i - cm.numBrushes]->pc;
+      item->id           = -1 - (i - cm.numBrushes);
+      GVec3Copy(pc->bounds[0], item->bounds[0]);
+      GVec3Copy(pc->bounds[1], item->bounds[1]);
+    }
+    for (i32 j = 0; j < 3; j++) { item->center[j] = (item->bounds[0][j] + item->bounds[1][j]) * 0.5f; }
+  }
+
+  CM_BVHBuildNode(&b, 0, count, 0);
+
+  // store the result
+  cm.numBVHNodes = b.numNodes;
+  cm.bvhNodes    = Hunk_Alloc(b.numNodes * sizeof(*cm.bvhNodes), h_high);
+  memcpy(cm.bvhNodes, b.nodes, b.numNodes * sizeof(*cm.bvhNodes));
+  cm.numBVHItems = count;
+  cm.bvhItems    = Hunk_Alloc(count * sizeof(*cm.bvhItems), h_high);
+  for (i32 i = 0; i < count; i++) { cm.bvhItems[i] = b.items[i].id; }
+  Hunk_FreeTempMemory(b.nodes);
+  Hunk_FreeTempMemory(b.items);
+  Hunk_FreeTempMemory(used);
+  if (load.developer) { echo("%s: %i nodes for %i brushes and patches", __func__, cm.numBVHNodes, count); }
+}
+
+//..................
+// CM_BVHBoxLeafs
+//   Calls visit with the brushes and patches of every BVH leaf that touches the given box, in the order of the walk
+//   Items are brush numbers, or -1-surfnum for patches. Every item is in one leaf only, so none is visited twice
+//   The walk stops when visit returns true
+//   Doesn't write any state, so it is safe to call from reentrant queries
+//..................
+void CM_BVHBoxLeafs(const vec3 mins, const vec3 maxs, BVHVisit visit, void* data) {
+  if (!cm.bvhNodes) { return; }
+  i32 stack[MAX_BVH_DEPTH];
+  i32 depth = 0;
+  i32 num   = 0;
+  for (;;) {
+    const cBNode* node = &cm.bvhNodes[num];
+    if (node->mins[0] <= maxs[0] && node->mins[1] <= maxs[1] && node->mins[2] <= maxs[2]  //
+        && node->maxs[0] >= mins[0] && node->maxs[1] >= mins[1] && node->maxs[2] >= mins[2]) {
+      if (!node->count) {
+        stack[depth++] = node->first;
+        num++;
+        continue;
+      }
+      if (visit(data, &cm.bvhItems[node->first], node->count)) { return; }
+    }
+    if (!depth) { return; }
+    num = stack[--depth];
+  }
+}
+
+//..................
+// Solve: Patch facet BVH
+//   Hierarchy of the packed facet blocks of each patch (PatchCol.facetBounds), built once by CM_GeneratePatchCollide
+//   Blocks are split in halves in their original order, and walked first half first,
+//   so that the facets are still tested in the same order as the linear loops, which decides the ties
+//..................
+
+//..................
+// CM_FacetBVHBuildNode
+//   Builds the subtree for the given range of facet blocks, in depth-first order
+//   Returns the number of its root node
+//..................
+static i32 CM_FacetBVHBuildNode(PatchCol* pc, i32 first, i32 count) {
+  i32     num  = pc->numFacetNodes++;
+  cBNode* node = &pc->facetNodes[num];
+  GVec3Set(node->mins, INFINITY, INFINITY, INFINITY);
+  GVec3Set(node->maxs, -INFINITY, -INFINITY, -INFINITY);
+  for (i32 facetId = first * SIMD_LANES; facetId < (first + count) * SIMD_LANES && facetId < pc->numFacets; facetId++) {
+    const cBrushBlock* block = &pc->facetBounds[facetId / SIMD_LANES];
+    i32                id    = facetId % SIMD_LANES;
+    vec3               mins  = { block->mins[0][id], block->mins[1][id], block->mins[2][id] };
+    vec3               maxs  = { block->maxs[0][id], block->maxs[1][id], block->maxs[2][id] };
+    CM_BVHAddBounds(node->mins, node->maxs, mins, maxs);
+  }
+  if (count <= 1) {
+    node->first = first;
+    node->count = count;
+    return num;
+  }
+  i32 split = count / 2;
+  CM_FacetBVHBuildNode(pc, first, split);  // always num+1
+  node->first = CM_FacetBVHBuildNode(pc, first + split, count - split);
+  node->count = 0;
+  return num;
+}
+
+//..................
+// CM_BuildFacetBVH
+//   Builds the facet BVH of the given patch, one block of facets per leaf
+//   Needs the packed facet bounds of CM_PackPatchFacets
+//..................
+void CM_BuildFacetBVH(PatchCol* pc) {
+  if (!pc->facetBounds) { return; }
+  i32 numBlocks     = (pc->numFacets + SIMD_LANES - 1) / SIMD_LANES;
+  pc->facetNodes    = Hunk_Alloc((2 * numBlocks - 1) * sizeof(*pc->facetNodes), h_high);
+  pc->numFacetNodes = 0;
+  CM_FacetBVHBuildNode(pc, 0, numBlocks);
+}
+
+//..................
+// CM_FacetBVHBlocks
+//   Stores the facet blocks of the given patch whose bounds touch the bounds of the trace into the list, in their original order
+//   The list must fit every block of the patch
+//   Returns the amount of blocks stored
+//..................
+i32 CM_FacetBVHBlocks(const TraceWork* tw, const PatchCol* pc, i32* list) {
+  const f32* mins = tw->bounds[0];
+  const f32* maxs = tw->bounds[1];
+  i32        stack[MAX_BVH_DEPTH];
+  i32        depth = 0;
+  i32        count = 0;
+  i32        num   = 0;
+  for (;;) {
+    const cBNode* node = &pc->facetNodes[num];
+    if (node->mins[0] <= maxs[0] && node->mins[1] <= maxs[1] && node->mins[2] <= maxs[2]  //
+        && node->maxs[0] >= mins[0] && node->maxs[1] >= mins[1] && node->maxs[2] >= mins[2]) {
+      if (!node->count) {
+        stack[depth++] = node->first;
+        num++;
+        continue;
+      }
+      list[count++] = node->first;
+    }
+    if (!depth) { break; }
+    num = stack[--depth];
+  }
+  return count;
+}
@@ -0,0 +1,120 @@
+#include "../solve.h"
+
+//..................
+// Solve: Trace cache
+//   Stores the results of CM_BoxTrace, so that the same trace done again in the same frame is not swept again (col.doTraceCache)
+//   Fixed size open addressing table, with TRACE_CACHE_PROBES linear probes per key
+//   Entries belong to a generation, and CM_ClearTraceCache empties the whole table at once by starting a new one
+//   Cleared by the game once per frame, and by the collision module when the map or the area portals change
+//..................
+
+//..................
+// Cache state
+//   The hashes of the slots are kept apart from the stored traces, so that the probes of a key read a single cache line
+typedef struct {
+  u32 hash;
+  u32 generation;  // the slot is empty unless this is the current generation
+} TraceCacheSlot;
+typedef struct {
+  TraceKey key;
+  Trace    trace;
+} TraceCacheEntry;
+static struct {
+  TraceCacheSlot  slots[TRACE_CACHE_SIZE];
+  TraceCacheEntry entries[TRACE_CACHE_SIZE];
+  u32             generation;  // 0 until the first clear, when nothing can be stored yet
+} cache;
+
+//..................
+// CM_TraceCacheHash
+//   Mixes every word of the key before its hash into a 32bit hash, two independent chains at a time
+//..................
+static u32 CM_TraceCacheHash(const TraceKey* key) {
+  const u32* words = (const u32*)key;
+  i32        count = (sizeof(*key) - sizeof(key->hash)) / sizeof(u32);  // the hash is the last field
+  u64        h0    = 0x9E3779B97F4A7C15ull;
+  u64        h1    = 0xC2B2AE3D27D4EB4Full;
+  for (i32 i = 0; i + 1 < count; i += 2) {
+    h0 = (h0 ^ words[i]) * 0xFF51AFD7ED558CCDull;
+    h1 = (h1 ^ words[i + 1]) * 0xC4CEB9FE1A85EC53ull;
+  }
+  if (count & 1) { h0 = (h0 ^ words[count - 1]) * 0xFF51AFD7ED558CCDull; }
+  // the low bits of the products only depend on the low bits of the words, so mix the high bits back down before using them
+  u64 h = h0 ^ ((h1 << 31) | (h1 >> 33));
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDull;
+  h ^= h >> 33;
+  return (u32)h;
+}
+
+//..................
+// CM_TraceCacheKey
+//   Builds the cache key of a trace into *key. NULL mins/maxs are stored as zero, like CM_BoxTrace treats them
+//   Returns false when the trace can't be cached: the temporary box models change between calls with the same handle
+//..................
+bool CM_TraceCacheKey(TraceKey* key, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask, bool capsule) {
+  if (model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE) { return false; }
+  memset(key, 0, sizeof(*key));
+  GVec3Copy(start, key->start);
+  GVec3Copy(end, key->end);
+  if (mins) { GVec3Copy(mins, key->mins); }
+  if (maxs) { GVec3Copy(maxs, key->maxs); }
+  key->model     = model;
+  key->brushmask = brushmask;
+  key->capsule   = capsule;
+  key->hash      = CM_TraceCacheHash(key);
+  return true;
+}
+
+//..................
+// CM_TraceCacheFind
+//   Copies the stored result of the given trace into results
+//   Returns false, and counts a miss, when the trace is not stored
+//..................
+bool CM_TraceCacheFind(const TraceKey* key, Trace* results) {
+  u32 hash = key->hash;
+  for (i32 probe = 0; probe < TRACE_CACHE_PROBES && cache.generation; probe++) {
+    i32 id = (hash + probe) & (TRACE_CACHE_SIZE - 1);
+    if (cache.slots[id].generation != cache.generation) { break; }  // keys are stored in the first empty slot, so it can't be further
+    if (cache.slots[id].hash != hash || memcmp(&cache.entries[id].key, key, sizeof(*key))) { continue; }
+    *results = cache.entries[id].trace;
+    c_cache_hits++;
+    return true;
+  }
+  c_cache_misses++;
+  return false;
+}
+
+//..................
+// CM_TraceCacheStore
+//   Stores the result of the given trace, in the first empty slot of its probes, or over the first probe when they are all taken
+//..................
+void CM_TraceCacheStore(const TraceKey* key, const Trace* results) {
+  if (!cache.generation) { return; }
+  u32 hash = key->hash;
+  i32 id   = hash & (TRACE_CACHE_SIZE - 1);
+  for (i32 probe = 0; probe < TRACE_CACHE_PROBES; probe++) {
+    i32 next = (hash + probe) & (TRACE_CACHE_SIZE - 1);
+    if (cache.slots[next].generation != cache.generation) {
+      id = next;
+      break;
+    }
+  }
+  cache.slots[id].hash       = hash;
+  cache.slots[id].generation = cache.generation;
+  cache.entries[id].key      = *key;
+  cache.entries[id].trace    = *results;
+}
+
+//..................
+// CM_ClearTraceCache
+//   Forgets every stored trace. Call it once per frame, and whenever anything the traces depend on changes
+//   Also called by CM_LoadMap, CM_ClearMap and CM_AdjustAreaPortalState
+//..................
+void CM_ClearTraceCache(void) {
+  cache.generation++;
+  if (!cache.generation) {  // wrapped around: old entries could look current again
+    memset(cache.slots, 0, sizeof(cache.slots));
+    cache.generation = 1;
+  }
+}
@@ -0,0 +1,277 @@
+#include <unistd.h>  // For sysconf
+#include "../jobs.h"
+
+//..............................
+// Trace job system
+//   Submit a set of trace jobs, and wait for all of them to complete once per frame:
+//     CM_JobsSubmit(jobs, count);  // returns immediately
+//     CM_JobsWait();               // blocks until every job of the set has its result
+//   Jobs are split into one contiguous range per worker.
+//   A worker takes JOB_CHUNK_SIZE jobs at a time from the front of its own range,
+//   and when it runs out of work it steals the back half of the largest remaining range of another worker.
+//   Contiguous ranges keep the coherence of the submitted order (eg: jobs sorted by entity or by area)
+//..............................
+
+//..............................
+// Worker state
+typedef struct {
+  pthread_t       thread;
+  pthread_mutex_t lock;   // protects begin/end
+  i32             begin;  // first job not taken yet
+  i32             end;    // one past the last job of this worker
+  i32             id;
+  ColQuery        query;  // reentrant query context of this worker
+} JobWorker;
+//..............................
+// Pool state
+static struct {
+  JobWorker*      workers;
+  i32             numWorkers;
+  TraceJob*       jobs;       // jobs of the current frame
+  atomic_int      remaining;  // jobs of the current frame without a result yet
+  u32             frame;      // bumped on each submit, wakes up the workers
+  bool            quit;
+  pthread_mutex_t lock;  // protects frame/quit, and the wake/done signals
+  pthread_cond_t  wake;
+  pthread_cond_t  done;
+} pool;
+
+//..................
+// CM_JobTake
+//   Takes the next chunk of jobs from the front of the given worker range
+//   Returns the amount of jobs taken, starting at *first
+//..................
+static i32 CM_JobTake(JobWorker* w, i32* first) {
+  pthread_mutex_lock(&w->lock);
+  i32 count = w->end - w->begin;
+  if (count > JOB_CHUNK_SIZE) { count = JOB_CHUNK_SIZE; }
+  *first = w->begin;
+  w->begin += count;
+  pthread_mutex_unlock(&w->lock);
+  return count;
+}
+
+//..................
+// CM_JobSteal
+//   Moves the back half of the largest range of the other workers into the range of the given worker
+//   Ranges no larger than a chunk are taken whole
+//   Returns false when no other worker has any job left
+//..................
+static bool CM_JobSteal(JobWorker* w) {
+  // find the victim
+  JobWorker* victim = NULL;
+  i32        best   = 0;
+  for (i32 i = 1; i < pool.numWorkers; i++) {
+    JobWorker* other = &pool.workers[(w->id + i) % pool.numWorkers];
+    pthread_mutex_lock(&other->lock);
+    i32 count = other->end - other->begin;
+    pthread_mutex_unlock(&other->lock);
+    if (count > best) {
+      best   = count;
+      victim = other;
+    }
+  }
+  if (!victim) { return false; }
+
+  // lock both ranges in id order, the same order in which CM_JobsSubmit takes every worker lock to fill them
+  JobWorker* first  = (w->id < victim->id) ? w : victim;
+  JobWorker* second = (w->id < victim->id) ? victim : w;
+  pthread_mutex_lock(&first->lock);
+  pthread_mutex_lock(&second->lock);
+  i32 count = victim->end - victim->begin;
+  if (count > 0 && w->end == w->begin) {
+    i32 mid     = (count > JOB_CHUNK_SIZE) ? victim->begin + count / 2 : victim->begin;
+    w->begin    = mid;
+    w->end      = victim->end;
+    victim->end = mid;
+  }
+  pthread_mutex_unlock(&second->lock);
+  pthread_mutex_unlock(&first->lock);
+  return true;  // look again, even when another worker got there first
+}
+
+//..................
+// CM_JobExecute
+//   Runs one trace job with the query context of the given worker
+//..................
+static void CM_JobExecute(JobWorker* w, TraceJob* job) {
+  if (job->transformed && job->transform) {
+    CM_QueryEntityBoxTrace(&w->query, &job->result, job->start, job->end, job->mins, job->maxs, job->model, job->brushmask, job->transform, job->capsule);
+  } else if (job->transformed) {
+    CM_QueryTransformedBoxTrace(&w->query, &job->result, job->start, job->end, job->mins, job->maxs, job->model, job->brushmask, job->origin, job->angles,
+                                job->capsule);
+  } else {
+    CM_QueryBoxTrace(&w->query, &job->result, job->start, job->end, job->mins, job->maxs, job->model, job->brushmask, job->capsule);
+  }
+}
+
+//..................
+// CM_JobWorker
+//   Thread entry point of a worker
+//   Sleeps until a new frame is submitted, then runs and steals jobs until there are none left
+//..................
+static void* CM_JobWorker(void* arg) {
+  JobWorker* w    = arg;
+  u32        seen = 0;
+  for (;;) {
+    pthread_mutex_lock(&pool.lock);
+    while (pool.frame == seen && !pool.quit) { pthread_cond_wait(&pool.wake, &pool.lock); }
+    seen      = pool.frame;
+    bool quit = pool.quit;
+    pthread_mutex_unlock(&pool.lock);
+    if (quit) { return NULL; }
+
+    do {
+      i32 first, count;
+      while ((count = CM_JobTake(w, &first)) > 0) {
+        for (i32 i = 0; i < count; i++) { CM_JobExecute(w, &pool.jobs[first + i]); }
+        // the last worker to finish signals the completion of the frame
+        if (atomic_fetch_sub(&pool.remaining, count) == count) {
+          pthread_mutex_lock(&pool.lock);
+          pthread_cond_broadcast(&pool.done);
+          pthread_mutex_unlock(&pool.lock);
+        }
+      }
+    } while (CM_JobSteal(w));
+  }
+}
+
+//..................
+// CM_JobsInit
+//   Starts the worker pool, with one reentrant query context per worker for the currently loaded map
+//   numWorkers <= 0 starts one worker for each online processor
+//   Returns false when the pool could not be started
+//..................
+bool CM_JobsInit(i32 numWorkers) {
+  if (pool.workers) { CM_JobsShutdown(); }
+  if (numWorkers <= 0) { numWorkers = (i32)sysconf(_SC_NPROCESSORS_ONLN); }
+  if (numWorkers < 1) { numWorkers = 1; }
+  if (numWorkers > MAX_JOB_WORKERS) { numWorkers = MAX_JOB_WORKERS; }
+
+  memset(&pool, 0, sizeof(pool));
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.wake, NULL);
+  pthread_cond_init(&pool.done, NULL);
+  atomic_init(&pool.remaining, 0);
+  pool.workers = Z_Malloc(numWorkers * sizeof(*pool.workers));
+  for (i32 i = 0; i < numWorkers; i++) {
+    JobWorker* w = &pool.workers[i];
+    w->id        = i;
+    pthread_mutex_init(&w->lock, NULL);
+    CM_InitQuery(&w->query);
+    if (pthread_create(&w->thread, NULL, CM_JobWorker, w)) {
+      echo("%s: could only start %i of %i workers", __func__, i, numWorkers);
+      pthread_mutex_destroy(&w->lock);
+      CM_FreeQuery(&w->query);
+      break;
+    }
+    pool.numWorkers++;
+  }
+  if (!pool.numWorkers) {
+    CM_JobsShutdown();
+    return false;
+  }
+  return true;
+}
+
+//..................
+// CM_JobsShutdown
+//   Stops and joins all the workers of the pool, and releases their query contexts
+//   Waits for the current frame to complete first
+//..................
+void CM_JobsShutdown(void) {
+  if (!pool.workers) { return; }
+  CM_JobsWait();
+  pthread_mutex_lock(&pool.lock);
+  pool.quit = true;
+  pthread_cond_broadcast(&pool.wake);
+  pthread_mutex_unlock(&pool.lock);
+  // join every worker before releasing anything, a late worker can still be looking at the ranges of the others
+  for (i32 i = 0; i < pool.numWorkers; i++) { pthread_join(pool.workers[i].thread, NULL); }
+  for (i32 i = 0; i < pool.numWorkers; i++) {
+    pthread_mutex_destroy(&pool.workers[i].lock);
+    CM_FreeQuery(&pool.workers[i].query);
+  }
+  Z_Free(pool.workers);
+  pthread_cond_destroy(&pool.done);
+  pthread_cond_destroy(&pool.wake);
+  pthread_mutex_destroy(&pool.lock);
+  memset(&pool, 0, sizeof(pool));
+}
+
+//..................
+// CM_JobsNumWorkers
+//   Returns the number of running workers. 0 when the pool is not started
+//..................
+i32 CM_JobsNumWorkers(void) { return pool.numWorkers; }
+
+//..................
+// CM_JobsSubmit
+//   Starts running the given trace jobs on the worker pool, and returns immediately
+//   The jobs must stay valid and untouched until CM_JobsWait returns. Their results are written into jobs[id].result
+//   Only one set of jobs can be in flight at a time, so a previous set is waited for first
+//   Runs the jobs on the calling thread when the pool is not started
+//..................
+void CM_JobsSubmit(TraceJob* jobs, i32 count) {
+  if (count <= 0) { return; }
+  if (!pool.workers) {
+    for (i32 i = 0; i < count; i++) {
+      TraceJob* job = &jobs[i];
+      if (job->transformed && job->transform) {
+        CM_EntityBoxTrace(&job->result, job->start, job->end, job->mins, job->maxs, job->model, job->brushmask, job->transform, job->capsule);
+      } else if (job->transformed) {
+        CM_TransformedBoxTrace(&job->result, job->start, job->end, job->mins, job->maxs, job->model, job->brushmask, job->origin, job->angles, job->capsule);
+      } else {
+        CM_BoxTrace(&job->result, job->start, job->end, job->mins, job->maxs, job->model, job->brushmask, job->capsule);
+      }
+    }
+    return;
+  }
+  CM_JobsWait();
+
+  // the workers are idle, so their contexts can be recreated when a different map was loaded
+  if (pool.workers[0].query.checksum != cm.checksum) {
+    for (i32 i = 0; i < pool.numWorkers; i++) {
+      CM_FreeQuery(&pool.workers[i].query);
+      CM_InitQuery(&pool.workers[i].query);
+    }
+  }
+
+  // split the jobs into one contiguous range per worker
+  // all the ranges are filled under every worker lock, taken in id order like CM_JobSteal does:
+  // a late worker of the previous frame can be stealing, and must see either no range or all of them
+  pool.jobs = jobs;
+  atomic_store(&pool.remaining, count);
+  for (i32 i = 0; i < pool.numWorkers; i++) { pthread_mutex_lock(&pool.workers[i].lock); }
+  for (i32 i = 0; i < pool.numWorkers; i++) {
+    JobWorker* w = &pool.workers[i];
+    w->begin     = (i32)((u64)count * i / pool.numWorkers);
+    w->end       = (i32)((u64)count * (i + 1) / pool.numWorkers);
+  }
+  for (i32 i = pool.numWorkers - 1; i >= 0; i--) { pthread_mutex_unlock(&pool.workers[i].lock); }
+
+  pthread_mutex_lock(&pool.lock);
+  pool.frame++;
+  pthread_cond_broadcast(&pool.wake);
+  pthread_mutex_unlock(&pool.lock);
+}
+
+//..................
+// CM_JobsWait
+//   Blocks until every job of the last submitted set has its result
+//..................
+void CM_JobsWait(void) {
+  if (!pool.workers) { return; }
+  pthread_mutex_lock(&pool.lock);
+  while (atomic_load(&pool.remaining) > 0) { pthread_cond_wait(&pool.done, &pool.lock); }
+  pthread_mutex_unlock(&pool.lock);
+}
+
+//..................
+// CM_JobsRun
+//   Submits the given trace jobs, and waits for all of them to complete
+//..................
+void CM_JobsRun(TraceJob* jobs, i32 count) {
+  CM_JobsSubmit(jobs, count);
+  CM_JobsWait();
+}
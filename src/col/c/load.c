@@ -5,6 +5,9 @@
 // MAP LOADING
 //............................
 
+// Index in cm.planes of each plane of the file, when load.compact. Temporary, from CMod_LoadCompactPlanes until the nodes are loaded
+static i32* cmod_planeRemap;
+
 //............................
 // CMod_LoadShaders
 //............................
@@ -49,6 +52,27 @@ static void CMod_LoadSubmodels(const Lump* l) {
   }
 }
 
+//............................
+// CMod_LoadCompactNodes
+//   Stores the nodes with their planes as indices into the compact cm.planes (load.compact), in the order of the file
+//   The indices are 16 bits wide when every plane, node and leaf number of the map fits in them
+//............................
+static void CMod_LoadCompactNodes(const dNode* in, i32 count) {
+  if (cm.numPlanes <= 0x10000 && count <= 0x8000 && cm.numLeafs <= 0x8000) {
+    cm.nodes16 = Hunk_Alloc(count * sizeof(*cm.nodes16), h_high);
+    for (i32 i = 0; i < count; i++, in++) {
+      cm.nodes16[i].plane = cmod_planeRemap[in->planeNum];
+      for (i32 j = 0; j < 2; j++) { cm.nodes16[i].children[j] = in->children[j]; }
+    }
+  } else {
+    cm.nodes32 = Hunk_Alloc(count * sizeof(*cm.nodes32), h_high);
+    for (i32 i = 0; i < count; i++, in++) {
+      cm.nodes32[i].plane = cmod_planeRemap[in->planeNum];
+      for (i32 j = 0; j < 2; j++) { cm.nodes32[i].children[j] = in->children[j]; }
+    }
+  }
+}
+
 //............................
 // CMod_LoadNodes
 //............................
@@ -57,8 +81,12 @@ static void CMod_LoadNodes(const Lump* l) {
   if (l->filelen % sizeof(*in)) err(ERR_DROP, "%s: funny lump size", __func__);
   i32 count = l->filelen / sizeof(*in);
   if (count < 1) err(ERR_DROP, "%s: map has no nodes", __func__);
-  cm.nodes    = Hunk_Alloc(count * sizeof(*cm.nodes), h_high);
   cm.numNodes = count;
+  if (load.compact) {
+    CMod_LoadCompactNodes(in, count);
+    return;
+  }
+  cm.nodes = Hunk_Alloc(count * sizeof(*cm.nodes), h_high);
   i32    child;
   cNode* out = cm.nodes;
   for (i32 i = 0; i < count; i++, out++, in++) {
@@ -70,16 +98,421 @@ static void CMod_LoadNodes(const Lump* l) {
   }
 }
 
+//............................
+// CMod_NodeHeight
+//   Returns the number of node levels below and including the given node. Leafs have none
+//............................
+static i32 CMod_NodeHeight(i32 num, i32 depth) {
+  if (num < 0 || depth > cm.numNodes) { return 0; }  // depth guard for malformed trees
+  i32 children[2];
+  CM_GetNode(num, children);
+  i32 h0 = CMod_NodeHeight(children[0], depth + 1);
+  i32 h1 = CMod_NodeHeight(children[1], depth + 1);
+  return 1 + ((h0 > h1) ? h0 : h1);
+}
+
+//............................
+// CMod_OrderDepthFirst
+//   Numbers the nodes of the subtree in depth-first order: each node is followed by its whole front subtree, then by its back subtree
+//   index[old] is the new number of each node, -1 while not numbered yet
+//............................
+static void CMod_OrderDepthFirst(i32 num, i32* index, i32* count) {
+  i32 children[2];
+  while (num >= 0 && index[num] < 0) {
+    index[num] = (*count)++;
+    CM_GetNode(num, children);
+    CMod_OrderDepthFirst(children[0], index, count);
+    num = children[1];
+  }
+}
+
+//............................
+// CMod_OrderVEB
+//   Numbers the top `height` levels of the subtree in van Emde Boas order:
+//   the top half of the levels is laid out first, then each subtree hanging from it, all recursively,
+//   so that any path down the tree crosses few cache lines whatever the cache size
+//............................
+static void CMod_OrderVEB(i32 num, i32 height, i32* index, i32* count);
+static void CMod_OrderVEBBottom(i32 num, i32 depth, i32 height, i32* index, i32* count) {
+  if (num < 0) { return; }
+  if (!depth) {
+    CMod_OrderVEB(num, height, index, count);
+    return;
+  }
+  i32 children[2];
+  CM_GetNode(num, children);
+  CMod_OrderVEBBottom(children[0], depth - 1, height, index, count);
+  CMod_OrderVEBBottom(children[1], depth - 1, height, index, count);
+}
+static void CMod_OrderVEB(i32 num, i32 height, i32* index, i32* count) {
+  if (num < 0 || height < 1 || index[num] >= 0) { return; }
+  if (height == 1) {
+    index[num] = (*count)++;
+    return;
+  }
+  i32 top = height / 2;
+  CMod_OrderVEB(num, top, index, count);
+  CMod_OrderVEBBottom(num, top, height - top, index, count);
+}
+
+//............................
+// CMod_ReorderCompactNodes
+//   Moves the compact nodes (load.compact) in place to the new numbers of index[], the same way CMod_BuildInlineNodes lays out cm.tnodes
+//............................
+static void CMod_ReorderCompactNodes(const i32* index) {
+  if (cm.nodes16) {
+    cNode16* copy = Hunk_AllocateTempMemory(cm.numNodes * sizeof(*copy));
+    memcpy(copy, cm.nodes16, cm.numNodes * sizeof(*copy));
+    for (i32 i = 0; i < cm.numNodes; i++) {
+      cNode16* out = &cm.nodes16[index[i]];
+      out->plane   = copy[i].plane;
+      for (i32 j = 0; j < 2; j++) {
+        i32 child        = copy[i].children[j];
+        out->children[j] = (child < 0) ? child : index[child];
+      }
+    }
+    Hunk_FreeTempMemory(copy);
+  } else {
+    cNode32* copy = Hunk_AllocateTempMemory(cm.numNodes * sizeof(*copy));
+    memcpy(copy, cm.nodes32, cm.numNodes * sizeof(*copy));
+    for (i32 i = 0; i < cm.numNodes; i++) {
+      cNode32* out = &cm.nodes32[index[i]];
+      out->plane   = copy[i].plane;
+      for (i32 j = 0; j < 2; j++) {
+        i32 child        = copy[i].children[j];
+        out->children[j] = (child < 0) ? child : index[child];
+      }
+    }
+    Hunk_FreeTempMemory(copy);
+  }
+}
+
+//............................
+// CMod_BuildInlineNodes
+//   Builds cm.tnodes from cm.nodes, in the layout selected by load.nodeOrder
+//   Compact maps (load.compact) don't get inline nodes: their compact nodes are reordered instead
+//   Node 0 stays the root. Nodes that can't be reached from it are kept at the end, in their original order
+//............................
+static void CMod_BuildInlineNodes(void) {
+  cm.nodeOrder = load.nodeOrder;
+  if (cm.nodeOrder == NODE_ORDER_NONE) { return; }
+  i32* index = Hunk_AllocateTempMemory(cm.numNodes * sizeof(*index));
+  for (i32 i = 0; i < cm.numNodes; i++) { index[i] = -1; }
+  i32 count = 0;
+  if (cm.nodeOrder == NODE_ORDER_VEB) {
+    CMod_OrderVEB(0, CMod_NodeHeight(0, 0), index, &count);
+  } else {
+    CMod_OrderDepthFirst(0, index, &count);
+  }
+  for (i32 i = 0; i < cm.numNodes; i++) {
+    if (index[i] < 0) { index[i] = count++; }
+  }
+  if (!cm.nodes) {
+    CMod_ReorderCompactNodes(index);
+    Hunk_FreeTempMemory(index);
+    return;
+  }
+  cm.tnodes = Hunk_Alloc(cm.numNodes * sizeof(*cm.tnodes), h_high);
+  for (i32 i = 0; i < cm.numNodes; i++) {
+    cTNode* out = &cm.tnodes[index[i]];
+    out->plane  = *cm.nodes[i].plane;
+    for (i32 j = 0; j < 2; j++) {
+      i32 child        = cm.nodes[i].children[j];
+      out->children[j] = (child < 0) ? child : index[child];
+    }
+  }
+  Hunk_FreeTempMemory(index);
+}
+
+//............................
+// CMod_BuildCell
+//   Fills the cells of both children of the given node from its own cell, and continues down their subtrees
+//   An axial plane narrows the box with the same comparisons as CM_FindPointLeaf: d < 0 goes to the back child
+//............................
+static void CMod_BuildCell(i32 num, const cCell* cell, i32 depth) {
+  if (num < 0 || depth > cm.numNodes) { return; }  // depth guard for malformed trees
+  i32           children[2];
+  const cPlane* plane = CM_GetNode(num, children);
+  for (i32 side = 0; side < 2; side++) {
+    i32    child = children[side];
+    cCell* out   = (child < 0) ? &cm.leafCells[-1 - child] : &cm.nodeCells[child];
+    *out         = *cell;
+    out->parent  = num;
+    if (plane->type < 3) {
+      if (side == 0 && plane->dist > out->mins[plane->type]) { out->mins[plane->type] = plane->dist; }
+      if (side == 1 && plane->dist < out->maxs[plane->type]) { out->maxs[plane->type] = plane->dist; }
+    } else {
+      out->check     = num;
+      out->checkSide = side;
+    }
+    CMod_BuildCell(child, out, depth + 1);
+  }
+}
+
+//............................
+// CMod_BuildCells
+//   Builds cm.nodeCells and cm.leafCells for the hinted point lookups, in the numbering of the tree walks
+//   Must run after CMod_BuildInlineNodes
+//............................
+static void CMod_BuildCells(void) {
+  if (!cm.numNodes) { return; }
+  cm.nodeCells = Hunk_Alloc(cm.numNodes * sizeof(*cm.nodeCells), h_high);
+  cm.leafCells = Hunk_Alloc(cm.numLeafs * sizeof(*cm.leafCells), h_high);
+  cCell empty  = { { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY }, -1, -1, 0 };
+  for (i32 i = 0; i < cm.numNodes; i++) { cm.nodeCells[i] = empty; }
+  for (i32 i = 0; i < cm.numLeafs; i++) { cm.leafCells[i] = empty; }
+  cCell* root = &cm.nodeCells[0];
+  GVec3Set(root->mins, -INFINITY, -INFINITY, -INFINITY);
+  GVec3Set(root->maxs, INFINITY, INFINITY, INFINITY);
+  CMod_BuildCell(0, root, 0);
+}
+
+//............................
+// CMod_LeafContents
+//   Returns the ORed contents of the brushes and patches of the given leaf
+//............................
+static i32 CMod_LeafContents(const cLeaf* leaf) {
+  i32 contents = 0;
+  for (i32 k = 0; k < leaf->numLeafBrushes; k++) { contents |= cm.brushes[cm.leafbrushes[leaf->firstLeafBrush + k]].contents; }
+  for (i32 k = 0; k < leaf->numLeafSurfaces; k++) {
+    const cPatch* patch = cm.surfaces[cm.leafsurfaces[leaf->firstLeafSurface + k]];
+    if (patch) { contents |= patch->contents; }
+  }
+  return contents;
+}
+
+//............................
+// CMod_NodeContents_r
+//   Stores the ORed contents of every leaf under the given node, and returns them
+//............................
+static i32 CMod_NodeContents_r(i32 num, i32 depth) {
+  if (num < 0) { return cm.leafs[-1 - num].contents; }
+  if (depth > cm.numNodes) { return 0; }  // depth guard for malformed trees
+  i32 children[2];
+  CM_GetNode(num, children);
+  i32 contents = CMod_NodeContents_r(children[0], depth + 1) | CMod_NodeContents_r(children[1], depth + 1);
+  cm.nodeContents[num] = contents;
+  if (cm.tnodes) { cm.tnodes[num].contents = contents; }
+  return contents;
+}
+
+//............................
+// CMod_BuildContents
+//   Fills the contents masks of the leafs, submodels and nodes, that the masked tree walks use to skip subtrees
+//   Must run after CMod_BuildInlineNodes
+//............................
+static void CMod_BuildContents(void) {
+  for (i32 i = 0; i < cm.numLeafs; i++) { cm.leafs[i].contents = CMod_LeafContents(&cm.leafs[i]); }
+  for (i32 i = 1; i < cm.numSubModels; i++) { cm.cmodels[i].leaf.contents = CMod_LeafContents(&cm.cmodels[i].leaf); }
+  if (!cm.numNodes) { return; }
+  cm.nodeContents = Hunk_Alloc(cm.numNodes * sizeof(*cm.nodeContents), h_high);
+  CMod_NodeContents_r(0, 0);
+}
+
+//............................
+// CMod_AddBounds16
+//   Grows the bounds `out` to also hold `b`
+//............................
+static void CMod_AddBounds16(cBounds16* out, const cBounds16* b) {
+  for (i32 i = 0; i < 3; i++) {
+    if (b->mins[i] < out->mins[i]) { out->mins[i] = b->mins[i]; }
+    if (b->maxs[i] > out->maxs[i]) { out->maxs[i] = b->maxs[i]; }
+  }
+}
+
+//............................
+// CMod_AddItemBounds16
+//   Grows the bounds `out` to also hold the bounds of a brush or patch, one unit larger on every side,
+//   in steps of BOUNDS16_UNIT rounded outwards and clamped to 16 bits
+//............................
+static void CMod_AddItemBounds16(cBounds16* out, const vec3 bounds[2]) {
+  for (i32 i = 0; i < 3; i++) {
+    f32 lo = floorf((bounds[0][i] - 1) / BOUNDS16_UNIT);
+    f32 hi = ceilf((bounds[1][i] + 1) / BOUNDS16_UNIT);
+    i16 mins = (lo < -0x8000) ? -0x8000 : (lo > 0x7fff) ? 0x7fff : (i16)lo;
+    i16 maxs = (hi < -0x8000) ? -0x8000 : (hi > 0x7fff) ? 0x7fff : (i16)hi;
+    if (mins < out->mins[i]) { out->mins[i] = mins; }
+    if (maxs > out->maxs[i]) { out->maxs[i] = maxs; }
+  }
+}
+
+//............................
+// CMod_LeafBounds
+//   Stores the bounds of everything that the given leaf holds: its brushes, and its patches when they are loaded
+//   A leaf without any keeps empty bounds, that no box touches
+//............................
+static void CMod_LeafBounds(const cLeaf* leaf, cBounds16* out) {
+  for (i32 k = 0; k < leaf->numLeafBrushes; k++) {
+    CMod_AddItemBounds16(out, (const vec3*)cm.brushes[cm.leafbrushes[leaf->firstLeafBrush + k]].bounds);
+  }
+  for (i32 k = 0; k < leaf->numLeafSurfaces; k++) {
+    const cPatch* patch = cm.surfaces[cm.leafsurfaces[leaf->firstLeafSurface + k]];
+    if (patch) { CMod_AddItemBounds16(out, (const vec3*)patch->pc->bounds); }
+  }
+}
+
+//............................
+// CMod_NodeBounds_r
+//   Grows the bounds of the given node to hold the ones of both children, and returns them
+//............................
+static const cBounds16* CMod_NodeBounds_r(i32 num, i32 depth) {
+  if (num < 0) { return &cm.leafBounds[-1 - num]; }
+  cBounds16* out = &cm.nodeBounds[num];
+  if (depth > cm.numNodes) { return out; }  // depth guard for malformed trees
+  i32 children[2];
+  CM_GetNode(num, children);
+  CMod_AddBounds16(out, CMod_NodeBounds_r(children[0], depth + 1));
+  CMod_AddBounds16(out, CMod_NodeBounds_r(children[1], depth + 1));
+  return out;
+}
+
+//............................
+// CMod_BuildBounds
+//   Builds the node and leaf bounds (load.nodeBounds) from the brushes and patches under them. The bounds of the file are not used:
+//   the compilers store the bounds of the region of each leaf, which holds its items but says nothing about where they are
+//   Must run after CMod_BuildInlineNodes and CMod_LoadPatches
+//............................
+static void CMod_BuildBounds(void) {
+  if (!load.nodeBounds || !cm.numNodes) { return; }
+  cm.nodeBounds = Hunk_Alloc(cm.numNodes * sizeof(*cm.nodeBounds), h_high);
+  cm.leafBounds = Hunk_Alloc(cm.numLeafs * sizeof(*cm.leafBounds), h_high);
+  const cBounds16 empty = { { 0x7fff, 0x7fff, 0x7fff }, { -0x8000, -0x8000, -0x8000 } };
+  for (i32 i = 0; i < cm.numNodes; i++) { cm.nodeBounds[i] = empty; }
+  for (i32 i = 0; i < cm.numLeafs; i++) {
+    cm.leafBounds[i] = empty;
+    CMod_LeafBounds(&cm.leafs[i], &cm.leafBounds[i]);
+  }
+  CMod_NodeBounds_r(0, 0);
+}
+
+//............................
+// CMod_SameLeafItems
+//   Returns true when both leafs hold the same brushes and patches, in the same order
+//............................
+static bool CMod_SameLeafItems(const cLeaf* a, const cLeaf* b) {
+  if (a->numLeafBrushes != b->numLeafBrushes || a->numLeafSurfaces != b->numLeafSurfaces) { return false; }
+  if (memcmp(&cm.leafbrushes[a->firstLeafBrush], &cm.leafbrushes[b->firstLeafBrush], a->numLeafBrushes * sizeof(*cm.leafbrushes))) { return false; }
+  return !memcmp(&cm.leafsurfaces[a->firstLeafSurface], &cm.leafsurfaces[b->firstLeafSurface], a->numLeafSurfaces * sizeof(*cm.leafsurfaces));
+}
+
+//............................
+// CMod_ReduceColNode
+//   Builds the collision subtree of the given node into nodes[], children first, and returns it: a new node, or a leaf (negative)
+//   Two leafs with the same items are tested the same, so their split only matters for vis: the node is replaced by the front leaf,
+//   and the nodes above it can merge in turn. Splits against a side without any contents are kept: the walks skip that side
+//   for free, while dropping the split would send the boxes on that side into every leaf of the other one
+//   A leaf that another one was merged into gets its bounds grown to hold both. `bounds` is NULL when they are not built
+//............................
+static i32 CMod_ReduceColNode(cTNode* nodes, cBounds16* bounds, i32* count, i32 num, i32 depth) {
+  if (num < 0) { return num; }
+  if (depth > cm.numNodes) { return -1; }  // depth guard for malformed trees
+  i32           children[2];
+  const cPlane* plane         = CM_GetNode(num, children);
+  i32           front         = CMod_ReduceColNode(nodes, bounds, count, children[0], depth + 1);
+  i32           back          = CMod_ReduceColNode(nodes, bounds, count, children[1], depth + 1);
+  i32           frontContents = (front < 0) ? cm.leafs[-1 - front].contents : nodes[front].contents;
+  i32           backContents  = (back < 0) ? cm.leafs[-1 - back].contents : nodes[back].contents;
+  if (front < 0 && back < 0 && CMod_SameLeafItems(&cm.leafs[-1 - front], &cm.leafs[-1 - back])) {
+    if (bounds) { CMod_AddBounds16(&cm.leafBounds[-1 - front], &cm.leafBounds[-1 - back]); }
+    return front;
+  }
+  cTNode* out      = &nodes[*count];
+  out->plane       = *plane;
+  out->children[0] = front;
+  out->children[1] = back;
+  out->contents    = frontContents | backContents;
+  if (bounds) { bounds[*count] = cm.nodeBounds[num]; }
+  return (*count)++;
+}
+
+//............................
+// CMod_StoreColNode
+//   Copies the reduced subtree of the given node into cm.colNodes, in depth first order, and returns its new number
+//............................
+static i32 CMod_StoreColNode(const cTNode* nodes, const cBounds16* bounds, i32 num) {
+  if (num < 0) { return num; }
+  i32     id       = cm.numColNodes++;
+  cTNode* out      = &cm.colNodes[id];
+  *out             = nodes[num];
+  out->children[0] = CMod_StoreColNode(nodes, bounds, nodes[num].children[0]);
+  out->children[1] = CMod_StoreColNode(nodes, bounds, nodes[num].children[1]);
+  if (bounds) { cm.colBounds[id] = bounds[num]; }
+  return id;
+}
+
+//............................
+// CMod_BuildColTree
+//   Builds the collision tree (load.colTree): a copy of the tree without the splits that don't separate any brushes or patches,
+//   walked by the traces and position tests. The original tree still answers the leaf, cluster and area queries
+//   Each collision node keeps the bounds of the node it was copied from, which hold everything merged under it
+//   Must run after CMod_BuildContents and CMod_BuildBounds
+//............................
+static void CMod_BuildColTree(void) {
+  cm.colRoot = 0;
+  if (!load.colTree || !cm.numNodes) { return; }
+  cTNode*    nodes  = Hunk_AllocateTempMemory(cm.numNodes * sizeof(*nodes));
+  cBounds16* bounds = cm.nodeBounds ? Hunk_AllocateTempMemory(cm.numNodes * sizeof(*bounds)) : NULL;
+  i32        count  = 0;
+  i32        root   = CMod_ReduceColNode(nodes, bounds, &count, 0, 0);
+  if (count) {
+    cm.colNodes = Hunk_Alloc(count * sizeof(*cm.colNodes), h_high);
+    if (bounds) { cm.colBounds = Hunk_Alloc(count * sizeof(*cm.colBounds), h_high); }
+    root = CMod_StoreColNode(nodes, bounds, root);
+  }
+  cm.colRoot = root;
+  if (bounds) { Hunk_FreeTempMemory(bounds); }
+  Hunk_FreeTempMemory(nodes);
+  if (load.developer) { echo("%s: %i of %i nodes kept", __func__, cm.numColNodes, cm.numNodes); }
+}
+
+//............................
+// CMod_BuildLeafSets
+//   Builds a copy of the world leafs for each mask of load.leafMasks, that keeps only the brushes with any of its contents
+//   The filtered brush lists are allocated apart and referenced by offset into cm.leafbrushes, like the ones of the submodels
+//   Patches are kept as they are. Must run after CMod_BuildContents
+//............................
+static void CMod_BuildLeafSets(void) {
+  cm.numLeafSets = 0;
+  for (i32 m = 0; m < MAX_LEAF_MASKS && load.leafMasks[m]; m++) {
+    cLeafSet* set   = &cm.leafSets[cm.numLeafSets++];
+    set->contents   = load.leafMasks[m];
+    set->numBrushes = 0;
+    for (i32 i = 0; i < cm.numLeafs; i++) {
+      const cLeaf* leaf = &cm.leafs[i];
+      for (i32 k = 0; k < leaf->numLeafBrushes; k++) {
+        if (cm.brushes[cm.leafbrushes[leaf->firstLeafBrush + k]].contents & set->contents) { set->numBrushes++; }
+      }
+    }
+    i32* indexes = Hunk_Alloc(set->numBrushes * sizeof(*indexes), h_high);
+    set->leafs   = Hunk_Alloc(cm.numLeafs * sizeof(*set->leafs), h_high);
+    for (i32 i = 0; i < cm.numLeafs; i++) {
+      const cLeaf* leaf   = &cm.leafs[i];
+      cLeaf*       out    = &set->leafs[i];
+      *out                = *leaf;
+      out->firstLeafBrush = indexes - cm.leafbrushes;
+      out->numLeafBrushes = 0;
+      out->blocks         = NULL;
+      for (i32 k = 0; k < leaf->numLeafBrushes; k++) {
+        i32 brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
+        if (cm.brushes[brushnum].contents & set->contents) { indexes[out->numLeafBrushes++] = brushnum; }
+      }
+      indexes += out->numLeafBrushes;
+      out->contents = CMod_LeafContents(out);
+    }
+    if (load.developer) { echo("%s: mask %08x keeps %i of %i leaf brushes", __func__, set->contents, set->numBrushes, cm.numLeafBrushes); }
+  }
+}
+
 //............................
 // CM_BoundBrush
 //............................
 static void CM_BoundBrush(cBrush* b) {
-  b->bounds[0][0] = -b->sides[0].plane->dist;
-  b->bounds[1][0] = b->sides[1].plane->dist;
-  b->bounds[0][1] = -b->sides[2].plane->dist;
-  b->bounds[1][1] = b->sides[3].plane->dist;
-  b->bounds[0][2] = -b->sides[4].plane->dist;
-  b->bounds[1][2] = b->sides[5].plane->dist;
+  b->bounds[0][0] = -CM_SidePlane(b, 0)->dist;
+  b->bounds[1][0] = CM_SidePlane(b, 1)->dist;
+  b->bounds[0][1] = -CM_SidePlane(b, 2)->dist;
+  b->bounds[1][1] = CM_SidePlane(b, 3)->dist;
+  b->bounds[0][2] = -CM_SidePlane(b, 4)->dist;
+  b->bounds[1][2] = CM_SidePlane(b, 5)->dist;
 }
 
 //............................
@@ -93,7 +526,15 @@ static void CMod_LoadBrushes(const Lump* l) {
   cm.numBrushes = count;
   cBrush* out   = cm.brushes;
   for (i32 i = 0; i < count; i++, out++, in++) {
-    out->sides     = cm.BSides + in->firstSide;
+    if (cm.BSides16) {
+      out->sideBits = 16;
+      out->sides16  = cm.BSides16 + in->firstSide;
+    } else if (cm.BSides32) {
+      out->sideBits = 32;
+      out->sides32  = cm.BSides32 + in->firstSide;
+    } else {
+      out->sides = cm.BSides + in->firstSide;
+    }
     out->numsides  = in->numSides;
     out->shaderNum = in->shaderNum;
     if (out->shaderNum < 0 || out->shaderNum >= cm.numShaders) { err(ERR_DROP, "%s: bad shaderNum: %i", __func__, out->shaderNum); }
@@ -127,6 +568,30 @@ static void CMod_LoadLeafs(const Lump* l) {
   cm.areaPortals = Hunk_Alloc(cm.numAreas * cm.numAreas * sizeof(*cm.areaPortals), h_high);
 }
 
+//............................
+// CMod_LoadCompactBSides
+//   Stores the brush sides as plane and shader indices (load.compact), 16 bits wide when every plane and shader number of the map fits in them
+//   cm.BSides only keeps the full sides of the box hull
+//............................
+static void CMod_LoadCompactBSides(const dBSide_t* in, i32 count) {
+  cm.BSides = Hunk_Alloc(BOX_SIDES * sizeof(*cm.BSides), h_high);
+  if (cm.numPlanes <= 0x10000 && cm.numShaders <= 0x10000) {
+    cm.BSides16 = Hunk_Alloc(count * sizeof(*cm.BSides16), h_high);
+  } else {
+    cm.BSides32 = Hunk_Alloc(count * sizeof(*cm.BSides32), h_high);
+  }
+  for (i32 i = 0; i < count; i++, in++) {
+    if (in->shaderNum < 0 || in->shaderNum >= cm.numShaders) { err(ERR_DROP, "%s: bad shaderNum: %i", __func__, in->shaderNum); }
+    if (cm.BSides16) {
+      cm.BSides16[i].plane     = cmod_planeRemap[in->planeNum];
+      cm.BSides16[i].shaderNum = in->shaderNum;
+    } else {
+      cm.BSides32[i].plane     = cmod_planeRemap[in->planeNum];
+      cm.BSides32[i].shaderNum = in->shaderNum;
+    }
+  }
+}
+
 //............................
 // CMod_LoadBSides
 //............................
@@ -134,9 +599,13 @@ static void CMod_LoadBSides(const Lump* l) {
   dBSide_t* in = (dBSide_t*)(cmod_base + l->fileofs);
   if (l->filelen % sizeof(*in)) { err(ERR_DROP, "%s: funny lump size", __func__); }
   i32 count    = l->filelen / sizeof(*in);
-  cm.BSides    = Hunk_Alloc((BOX_SIDES + count) * sizeof(*cm.BSides), h_high);
   cm.numBSides = count;
-  cBSide* out  = cm.BSides;
+  if (load.compact) {
+    CMod_LoadCompactBSides(in, count);
+    return;
+  }
+  cm.BSides   = Hunk_Alloc((BOX_SIDES + count) * sizeof(*cm.BSides), h_high);
+  cBSide* out = cm.BSides;
   for (i32 i = 0; i < count; i++, in++, out++) {
     i32 num        = in->planeNum;
     out->plane     = &cm.planes[num];
@@ -147,6 +616,78 @@ static void CMod_LoadBSides(const Lump* l) {
 }
 
 
+//............................
+// CMod_SetPlane
+//............................
+static void CMod_SetPlane(cPlane* out, const dPlane* in) {
+  i32 bits = 0;
+  for (i32 j = 0; j < 3; j++) {
+    out->normal[j] = in->normal[j];
+    if (out->normal[j] < 0) bits |= 1 << j;
+  }
+  out->dist     = in->dist;
+  out->type     = PlaneTypeForNormal(out->normal);
+  out->signbits = bits;
+}
+
+//............................
+// CMod_MarkPlane
+//   Flags the given plane number of the file as used, for CMod_LoadCompactPlanes
+//............................
+static void CMod_MarkPlane(i32 planeNum, i32 count) {
+  if (planeNum < 0 || planeNum >= count) { err(ERR_DROP, "%s: bad planeNum: %i", __func__, planeNum); }
+  cmod_planeRemap[planeNum] = 0;
+}
+
+//............................
+// CMod_LoadCompactPlanes
+//   Loads only the planes used by the brush sides and nodes, and merges the ones that are bit for bit the same (load.compact)
+//   Fills cmod_planeRemap with the new index of each plane of the file, for CMod_LoadBSides and CMod_LoadNodes
+//   The two planes of an x^1 pair are both kept when used: their type and signbits don't mirror each other, and the traces read them
+//............................
+static void CMod_LoadCompactPlanes(const Lump* l, const Lump* sides, const Lump* nodes) {
+  dPlane* in = (void*)(cmod_base + l->fileofs);
+  if (l->filelen % sizeof(*in) || sides->filelen % sizeof(dBSide_t) || nodes->filelen % sizeof(dNode)) err(ERR_DROP, "%s: funny lump size", __func__);
+  i32 count = l->filelen / sizeof(*in);
+  if (count < 1) err(ERR_DROP, "%s: map with no planes", __func__);
+  cm.numFilePlanes = count;
+  cmod_planeRemap  = Hunk_AllocateTempMemory(count * sizeof(*cmod_planeRemap));
+  for (i32 i = 0; i < count; i++) { cmod_planeRemap[i] = -1; }
+  const dBSide_t* side     = (void*)(cmod_base + sides->fileofs);
+  const dNode*    node     = (void*)(cmod_base + nodes->fileofs);
+  i32             numSides = sides->filelen / sizeof(*side);
+  i32             numNodes = nodes->filelen / sizeof(*node);
+  for (i32 i = 0; i < numSides; i++) { CMod_MarkPlane(side[i].planeNum, count); }
+  for (i32 i = 0; i < numNodes; i++) { CMod_MarkPlane(node[i].planeNum, count); }
+  // number the used planes, giving the repeated ones the number of the first. Open addressing on the bits of the plane
+  i32  size  = 1;
+  while (size < 2 * count) { size <<= 1; }
+  i32* table = Hunk_AllocateTempMemory(size * sizeof(*table));
+  for (i32 i = 0; i < size; i++) { table[i] = -1; }
+  cm.numPlanes = 0;
+  for (i32 i = 0; i < count; i++) {
+    if (cmod_planeRemap[i] < 0) { continue; }
+    u32 bits[4];
+    memcpy(bits, &in[i], sizeof(bits));
+    u32 hash = 0;
+    for (i32 j = 0; j < 4; j++) { hash = (hash ^ bits[j]) * 16777619u; }
+    i32 slot = hash & (size - 1);
+    while (table[slot] >= 0 && memcmp(&in[table[slot]], &in[i], sizeof(*in))) { slot = (slot + 1) & (size - 1); }
+    if (table[slot] >= 0) {
+      cmod_planeRemap[i] = cmod_planeRemap[table[slot]];
+      continue;
+    }
+    table[slot]        = i;
+    cmod_planeRemap[i] = cm.numPlanes++;
+  }
+  Hunk_FreeTempMemory(table);
+  cm.planes = Hunk_Alloc((BOX_PLANES + cm.numPlanes) * sizeof(*cm.planes), h_high);
+  for (i32 i = 0; i < count; i++) {
+    if (cmod_planeRemap[i] >= 0) { CMod_SetPlane(&cm.planes[cmod_planeRemap[i]], &in[i]); }
+  }
+  if (load.developer) { echo("%s: keeps %i of %i planes", __func__, cm.numPlanes, count); }
+}
+
 //............................
 // CMod_LoadPlanes
 //............................
@@ -155,19 +696,10 @@ static void CMod_LoadPlanes(const Lump* l) {
   if (l->filelen % sizeof(*in)) err(ERR_DROP, "%s: funny lump size", __func__);
   i32 count = l->filelen / sizeof(*in);
   if (count < 1) err(ERR_DROP, "%s: map with no planes", __func__);
-  cm.planes    = Hunk_Alloc((BOX_PLANES + count) * sizeof(*cm.planes), h_high);
-  cm.numPlanes = count;
-  cPlane* out  = cm.planes;
-  for (i32 i = 0; i < count; i++, in++, out++) {
-    i32 bits = 0;
-    for (i32 j = 0; j < 3; j++) {
-      out->normal[j] = in->normal[j];
-      if (out->normal[j] < 0) bits |= 1 << j;
-    }
-    out->dist     = in->dist;
-    out->type     = PlaneTypeForNormal(out->normal);
-    out->signbits = bits;
-  }
+  cm.planes        = Hunk_Alloc((BOX_PLANES + count) * sizeof(*cm.planes), h_high);
+  cm.numFilePlanes = count;
+  cm.numPlanes     = count;
+  for (i32 i = 0; i < count; i++) { CMod_SetPlane(&cm.planes[i], &in[i]); }
 }
 
 
@@ -211,6 +743,163 @@ static void CMod_CheckLeafBrushes(void) {
   }
 }
 
+//............................
+// CMod_NumberLeafBrushes
+//   Gives the next numbers to the brushes of the leaf that don't have one yet, in the order of its brush list
+//   order[n] is the old number of the brush that becomes n, and index[old] its new number, -1 while not numbered yet
+//............................
+static void CMod_NumberLeafBrushes(const cLeaf* leaf, i32* index, i32* order, i32* count) {
+  for (i32 k = 0; k < leaf->numLeafBrushes; k++) {
+    i32 brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
+    if (index[brushnum] >= 0) { continue; }
+    index[brushnum]   = *count;
+    order[(*count)++] = brushnum;
+  }
+}
+
+//............................
+// CMod_NumberTreeBrushes
+//   Numbers the brushes of the leafs under the given node in the order that the tree walks reach them: front side first
+//............................
+static void CMod_NumberTreeBrushes(i32 num, i32* index, i32* order, i32* count, i32 depth) {
+  if (num < 0) {
+    CMod_NumberLeafBrushes(&cm.leafs[-1 - num], index, order, count);
+    return;
+  }
+  if (depth > cm.numNodes) { return; }  // depth guard for malformed trees
+  i32 children[2];
+  CM_GetNode(num, children);
+  CMod_NumberTreeBrushes(children[0], index, order, count, depth + 1);
+  CMod_NumberTreeBrushes(children[1], index, order, count, depth + 1);
+}
+
+//............................
+// CMod_BrushKeyOrder
+//   qsort comparator for the morton order of the brushes (BRUSH_ORDER_MORTON)
+//............................
+typedef struct {
+  u64 key;    // morton code of the center of the brush
+  i32 brush;  // number of the brush in the file
+} BrushKey;
+static int CMod_BrushKeyOrder(const void* a, const void* b) {
+  const BrushKey* ka = a;
+  const BrushKey* kb = b;
+  if (ka->key != kb->key) { return (ka->key < kb->key) ? -1 : 1; }
+  return ka->brush - kb->brush;
+}
+
+//............................
+// CMod_LeafBrushSpread
+//   Returns the average distance between the numbers of consecutive brushes in the lists of the world leafs, renumbered by index[] when given
+//   The lower it is, the closer in memory are the brushes that the leaf traces test one after the other
+//............................
+static f64 CMod_LeafBrushSpread(const i32* index) {
+  u64 total = 0;
+  u64 pairs = 0;
+  for (i32 i = 0; i < cm.numLeafs; i++) {
+    const i32* brushes = &cm.leafbrushes[cm.leafs[i].firstLeafBrush];
+    for (i32 k = 1; k < cm.leafs[i].numLeafBrushes; k++) {
+      i32 a  = index ? index[brushes[k - 1]] : brushes[k - 1];
+      i32 b  = index ? index[brushes[k]] : brushes[k];
+      total += (a < b) ? b - a : a - b;
+      pairs++;
+    }
+  }
+  return pairs ? (f64)total / pairs : 0;
+}
+
+//............................
+// CMod_OrderBrushSides
+//   Moves the sides of every brush next to the ones of the brush before it, in the current order of cm.brushes
+//   Sides are left where they are when any brush shares them with another one, or reaches out of the side lump
+//............................
+static void CMod_OrderBrushSides(void) {
+  size_t size  = cm.BSides16 ? sizeof(*cm.BSides16) : cm.BSides32 ? sizeof(*cm.BSides32) : sizeof(*cm.BSides);
+  byte*  base  = cm.BSides16 ? (byte*)cm.BSides16 : cm.BSides32 ? (byte*)cm.BSides32 : (byte*)cm.BSides;
+  i32    total = 0;
+  for (i32 i = 0; i < cm.numBrushes; i++) {
+    const cBrush* b     = &cm.brushes[i];
+    size_t        first = ((const byte*)b->sides - base) / size;  // every member of the sides union starts at the same address
+    if (first + b->numsides > (size_t)cm.numBSides) { return; }
+    total += b->numsides;
+  }
+  if (total > cm.numBSides) { return; }
+  byte* copy = Hunk_AllocateTempMemory(cm.numBSides * size);
+  memcpy(copy, base, cm.numBSides * size);
+  i32 next = 0;
+  for (i32 i = 0; i < cm.numBrushes; i++) {
+    cBrush* b   = &cm.brushes[i];
+    byte*   out = base + next * size;
+    memcpy(out, copy + ((byte*)b->sides - base), b->numsides * size);
+    if (b->sideBits == 16) {
+      b->sides16 = (cBSide16*)out;
+    } else if (b->sideBits == 32) {
+      b->sides32 = (cBSide32*)out;
+    } else {
+      b->sides = (cBSide*)out;
+    }
+    next += b->numsides;
+  }
+  Hunk_FreeTempMemory(copy);
+}
+
+//............................
+// CMod_OrderBrushes
+//   Renumbers the brushes in the layout selected by load.brushOrder, so that the brushes tested together sit together in memory,
+//   and moves their sides to match. The leaf brush lists of the world and the submodels are rewritten with the new numbers
+//   Lists keep their order, so every trace tests the same brushes in the same order, and gets the same result
+//   BRUSH_ORDER_LEAFS numbers the world brushes as the tree walks reach them, then the ones of the submodels, then the unused ones
+//............................
+static void CMod_OrderBrushes(void) {
+  if (load.brushOrder == BRUSH_ORDER_NONE || !cm.numBrushes) { return; }
+  i32* index = Hunk_AllocateTempMemory(cm.numBrushes * sizeof(*index));
+  i32* order = Hunk_AllocateTempMemory(cm.numBrushes * sizeof(*order));
+  for (i32 i = 0; i < cm.numBrushes; i++) { index[i] = -1; }
+  i32 count = 0;
+  if (load.brushOrder == BRUSH_ORDER_MORTON) {
+    BrushKey* keys = Hunk_AllocateTempMemory(cm.numBrushes * sizeof(*keys));
+    for (i32 i = 0; i < cm.numBrushes; i++) {
+      vec3 center;
+      for (i32 j = 0; j < 3; j++) { center[j] = (cm.brushes[i].bounds[0][j] + cm.brushes[i].bounds[1][j]) * 0.5f; }
+      keys[i].key   = MortonCode(center);
+      keys[i].brush = i;
+    }
+    qsort(keys, cm.numBrushes, sizeof(*keys), CMod_BrushKeyOrder);
+    for (; count < cm.numBrushes; count++) {
+      order[count]             = keys[count].brush;
+      index[keys[count].brush] = count;
+    }
+    Hunk_FreeTempMemory(keys);
+  } else {
+    CMod_NumberTreeBrushes(0, index, order, &count, 0);
+    for (i32 i = 1; i < cm.numSubModels; i++) { CMod_NumberLeafBrushes(&cm.cmodels[i].leaf, index, order, &count); }
+    for (i32 i = 0; i < cm.numBrushes; i++) {
+      if (index[i] < 0) {
+        index[i]       = count;
+        order[count++] = i;
+      }
+    }
+  }
+  f64 spread = CMod_LeafBrushSpread(NULL);
+
+  // move the brushes, then their sides
+  cBrush* copy = Hunk_AllocateTempMemory(cm.numBrushes * sizeof(*copy));
+  memcpy(copy, cm.brushes, cm.numBrushes * sizeof(*copy));
+  for (i32 i = 0; i < cm.numBrushes; i++) { cm.brushes[i] = copy[order[i]]; }
+  Hunk_FreeTempMemory(copy);
+  CMod_OrderBrushSides();
+
+  // point the brush lists to the new numbers
+  for (i32 i = 0; i < cm.numLeafBrushes; i++) { cm.leafbrushes[i] = index[cm.leafbrushes[i]]; }
+  for (i32 i = 1; i < cm.numSubModels; i++) {
+    const cLeaf* leaf = &cm.cmodels[i].leaf;
+    for (i32 k = 0; k < leaf->numLeafBrushes; k++) { cm.leafbrushes[leaf->firstLeafBrush + k] = index[cm.leafbrushes[leaf->firstLeafBrush + k]]; }
+  }
+  if (load.developer) { echo("%s: average distance between the brushes of a leaf: %.1f -> %.1f", __func__, spread, CMod_LeafBrushSpread(NULL)); }
+  Hunk_FreeTempMemory(order);
+  Hunk_FreeTempMemory(index);
+}
+
 
 //..............................
 // CMod_LoadEntityString
@@ -286,7 +975,6 @@ static void CMod_LoadPatches(const Lump* surfs, const Lump* verts) {
 //..............................
 void CM_LoadMap(const char* name, bool clientload, i32* checksum) {
   if (!name || !name[0]) { err(ERR_DROP, "%s: NULL name", __func__); }
-  CM_InitCfg();  // New function. Replacement for intializing config (og was Cvar_Get)
   if (load.developer) { echo("%s( '%s', %i )", __func__, name, clientload); }
 
   if (!strcmp(cm.name, name) && clientload) {
@@ -325,28 +1013,133 @@ void CM_LoadMap(const char* name, bool clientload, i32* checksum) {
   CMod_LoadLeafs(&header.lumps[LUMP_LEAFS]);
   CMod_LoadLeafBrushes(&header.lumps[LUMP_LEAFBRUSHES]);
   CMod_LoadLeafSurfaces(&header.lumps[LUMP_LEAFSURFACES]);
-  CMod_LoadPlanes(&header.lumps[LUMP_PLANES]);
+  if (load.compact) {
+    CMod_LoadCompactPlanes(&header.lumps[LUMP_PLANES], &header.lumps[LUMP_BSideS], &header.lumps[LUMP_NODES]);
+  } else {
+    CMod_LoadPlanes(&header.lumps[LUMP_PLANES]);
+  }
   CMod_LoadBSides(&header.lumps[LUMP_BSideS]);
   CMod_LoadBrushes(&header.lumps[LUMP_BRUSHES]);
   CMod_LoadSubmodels(&header.lumps[LUMP_MODELS]);
   CMod_LoadNodes(&header.lumps[LUMP_NODES]);
+  if (cmod_planeRemap) {
+    Hunk_FreeTempMemory(cmod_planeRemap);
+    cmod_planeRemap = NULL;
+  }
   CMod_LoadEntityString(&header.lumps[LUMP_ENTITIES]);
   CMod_LoadVisibility(&header.lumps[LUMP_VISIBILITY]);
   CMod_LoadPatches(&header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS]);
 
   CMod_CheckLeafBrushes();
+  CMod_OrderBrushes();
 
   // We only free the buffer, because the file is cached for the ref (drawing)
   FileFree(buf);
 
   // Initialize the stored data
   CM_InitBoxHull();
+  CMod_BuildInlineNodes();
+  CMod_BuildCells();
+  CMod_BuildContents();
+  CMod_BuildBounds();
+  CMod_BuildColTree();
+  CMod_BuildLeafSets();
+  CM_BuildBVH();
+  CM_PackBrushSides();
+  CM_PackLeafBrushes();
+  CM_BuildHulls();
+  CM_InitSideKernels();
   CM_FloodAreaConnections();
+  CM_ClearTraceCache();
   // Allow this to be cached if it is loaded by the server
   if (!clientload) { strncpyz(cm.name, name, sizeof(cm.name)); }
 }
 
 
+//..............................
+// CM_MemoryReport
+//   Echoes the resident size of the collision data of the loaded map, by structure
+//   The structures that load.compact shrinks also show the size that their full encoding takes, for comparison
+//..............................
+static size_t CM_ReportItem(const char* name, size_t count, size_t bytes, size_t full) {
+  if (full) {
+    echo("  %-21s %8zu %10zu bytes  (full: %zu)", name, count, bytes, full);
+  } else {
+    echo("  %-21s %8zu %10zu bytes", name, count, bytes);
+  }
+  return bytes;
+}
+static size_t CM_LeafBlocks(const cLeaf* leafs, i32 count) {
+  size_t blocks = 0;
+  for (i32 i = 0; i < count; i++) {
+    if (leafs[i].blocks) { blocks += (leafs[i].numLeafBrushes + SIMD_LANES - 1) / SIMD_LANES; }
+  }
+  return blocks;
+}
+void CM_MemoryReport(void) {
+  static const char* nodeOrders[] = { "file", "depth first", "van Emde Boas" };
+  echo("%s: %s", __func__, cm.name);
+  echo("  node order: %s", (cm.nodeOrder >= 0 && cm.nodeOrder <= NODE_ORDER_VEB) ? nodeOrders[cm.nodeOrder] : "?");
+  size_t total      = 0;
+  // full encoding of the compact structures: every plane of the file, pointer sides, and pointer nodes plus their inline copy
+  size_t fullPlanes = (cm.numFilePlanes + BOX_PLANES) * sizeof(cPlane);
+  size_t fullSides  = (cm.numBSides + BOX_SIDES) * sizeof(cBSide);
+  size_t fullNodes  = cm.numNodes * (sizeof(cNode) + ((cm.nodeOrder != NODE_ORDER_NONE) ? sizeof(cTNode) : 0));
+  bool   compact    = cm.BSides16 || cm.BSides32;
+  total += CM_ReportItem("shaders", cm.numShaders, cm.numShaders * sizeof(*cm.shaders), 0);
+  total += CM_ReportItem("planes", cm.numPlanes + BOX_PLANES, (cm.numPlanes + BOX_PLANES) * sizeof(*cm.planes), compact ? fullPlanes : 0);
+  if (cm.nodes) { total += CM_ReportItem("nodes", cm.numNodes, cm.numNodes * sizeof(*cm.nodes), 0); }
+  if (cm.tnodes) { total += CM_ReportItem("inline nodes", cm.numNodes, cm.numNodes * sizeof(*cm.tnodes), 0); }
+  if (cm.nodes16) { total += CM_ReportItem("compact nodes", cm.numNodes, cm.numNodes * sizeof(*cm.nodes16), fullNodes); }
+  if (cm.nodes32) { total += CM_ReportItem("compact nodes", cm.numNodes, cm.numNodes * sizeof(*cm.nodes32), fullNodes); }
+  if (cm.nodeContents) { total += CM_ReportItem("node contents", cm.numNodes, cm.numNodes * sizeof(*cm.nodeContents), 0); }
+  if (cm.colNodes) { total += CM_ReportItem("collision nodes", cm.numColNodes, cm.numColNodes * sizeof(*cm.colNodes), 0); }
+  if (cm.nodeBounds) { total += CM_ReportItem("node bounds", cm.numNodes, cm.numNodes * sizeof(*cm.nodeBounds), 0); }
+  if (cm.leafBounds) { total += CM_ReportItem("leaf bounds", cm.numLeafs, cm.numLeafs * sizeof(*cm.leafBounds), 0); }
+  if (cm.colBounds) { total += CM_ReportItem("collision node bounds", cm.numColNodes, cm.numColNodes * sizeof(*cm.colBounds), 0); }
+  if (cm.nodeCells) { total += CM_ReportItem("cells", cm.numNodes + cm.numLeafs, (cm.numNodes + cm.numLeafs) * sizeof(*cm.nodeCells), 0); }
+  total += CM_ReportItem("leafs", cm.numLeafs, cm.numLeafs * sizeof(*cm.leafs), 0);
+  total += CM_ReportItem("leaf brushes", cm.numLeafBrushes, cm.numLeafBrushes * sizeof(*cm.leafbrushes), 0);
+  total += CM_ReportItem("leaf surfaces", cm.numLeafSurfaces, cm.numLeafSurfaces * sizeof(*cm.leafsurfaces), 0);
+  size_t setBrushes = 0;
+  for (i32 i = 0; i < cm.numLeafSets; i++) { setBrushes += cm.leafSets[i].numBrushes; }
+  total += CM_ReportItem("leaf sets", cm.numLeafSets, cm.numLeafSets * cm.numLeafs * sizeof(cLeaf) + setBrushes * sizeof(i32), 0);
+  for (i32 i = 0; i < cm.numLeafSets; i++) { echo("    mask %08x %8i leaf brushes", cm.leafSets[i].contents, cm.leafSets[i].numBrushes); }
+  size_t leafBlocks = CM_LeafBlocks(cm.leafs, cm.numLeafs);
+  for (i32 i = 0; i < cm.numLeafSets; i++) { leafBlocks += CM_LeafBlocks(cm.leafSets[i].leafs, cm.numLeafs); }
+  for (i32 i = 1; i < cm.numSubModels; i++) { leafBlocks += CM_LeafBlocks(&cm.cmodels[i].leaf, 1); }
+  total += CM_ReportItem("leaf blocks", leafBlocks, leafBlocks * sizeof(cBrushBlock), 0);
+  total += CM_ReportItem("models", cm.numSubModels, cm.numSubModels * sizeof(*cm.cmodels), 0);
+  total += CM_ReportItem("brushes", cm.numBrushes + BOX_BRUSHES, (cm.numBrushes + BOX_BRUSHES) * sizeof(*cm.brushes), 0);
+  if (cm.BSides16) {
+    total += CM_ReportItem("compact sides", cm.numBSides, cm.numBSides * sizeof(*cm.BSides16) + BOX_SIDES * sizeof(cBSide), fullSides);
+  } else if (cm.BSides32) {
+    total += CM_ReportItem("compact sides", cm.numBSides, cm.numBSides * sizeof(*cm.BSides32) + BOX_SIDES * sizeof(cBSide), fullSides);
+  } else {
+    total += CM_ReportItem("sides", cm.numBSides + BOX_SIDES, fullSides, 0);
+  }
+  total += CM_ReportItem("side blocks", cm.numSideBlocks, cm.numSideBlocks * sizeof(cSideBlock), 0);
+  total += CM_ReportItem("hull sides", cm.numHulls * cm.numHullSides, (size_t)cm.numHulls * cm.numHullSides * sizeof(cHullPlane), 0);
+  for (i32 i = 0; i < cm.numHulls; i++) { echo("    size %g %g %g", cm.hulls[i].size[1][0], cm.hulls[i].size[1][1], cm.hulls[i].size[1][2]); }
+  total += CM_ReportItem("bvh nodes", cm.numBVHNodes, cm.numBVHNodes * sizeof(*cm.bvhNodes), 0);
+  total += CM_ReportItem("bvh items", cm.numBVHItems, cm.numBVHItems * sizeof(*cm.bvhItems), 0);
+  size_t numPatches = 0;
+  size_t patches    = 0;
+  for (i32 i = 0; i < cm.numSurfaces; i++) {
+    const cPatch* patch = cm.surfaces[i];
+    if (!patch) { continue; }
+    const PatchCol* pc        = patch->pc;
+    size_t          numBlocks = pc->blocks ? (pc->numFacets + SIMD_LANES - 1) / SIMD_LANES : 0;
+    numPatches++;
+    patches += sizeof(*patch) + sizeof(*pc) + pc->numPlanes * sizeof(PatchPlane) + pc->numFacets * sizeof(Facet);
+    patches += numBlocks * (sizeof(cSideBlock) + sizeof(cBrushBlock)) + pc->numFacetNodes * sizeof(cBNode);
+  }
+  total += CM_ReportItem("patches", numPatches, patches, 0);
+  total += CM_ReportItem("visibility", cm.numClusters, (size_t)cm.numClusters * cm.clusterBytes, 0);
+  total += CM_ReportItem("area portals", cm.numAreas, (size_t)cm.numAreas * cm.numAreas * sizeof(*cm.areaPortals), 0);
+  echo("  %-21s %8s %10zu bytes", "total", "", total);
+}
+
 //..............................
 // CM_ClearMap
 //   Free/Erase the currently stored clipMap data
@@ -354,4 +1147,5 @@ void CM_LoadMap(const char* name, bool clientload, i32* checksum) {
 void CM_ClearMap(void) {
   memset(&cm, 0, sizeof(cm));
   CM_ClearLevelPatches();
+  CM_ClearTraceCache();
 }
@@ -89,9 +89,8 @@ inline void DVec3Cross(const vec3 v1, const vec3 v2, vec3 cross) {
 // Matrices and Rotation math
 //..............................
 void AngleVectors(const vec3 angles, vec3 forward, vec3 right, vec3 up) {
-  f32        angle;
-  static f32 sr, sp, sy, cr, cp, cy;
-  // static to help MS compiler fp bugs
+  f32 angle;
+  f32 sr, sp, sy, cr, cp, cy;  // not static, so that rotated traces can run concurrently
 
   angle = angles[YAW] * (M_PI * 2 / 360);
   sy    = sin(angle);
@@ -221,3 +220,23 @@ void AddPointToBounds(const vec3 v, vec3 mins, vec3 maxs) {
   if (v[2] < mins[2]) { mins[2] = v[2]; }
   if (v[2] > maxs[2]) { maxs[2] = v[2]; }
 }
+
+//..............................
+// MortonCode
+//   Interleaves the bits of the point coordinates, quantized to 16bits per axis over the world bounds
+//   Points that are close in space get close codes, so sorting by it gives a cache friendly order
+//..............................
+u64 MortonCode(const vec3 p) {
+  u64 code = 0;
+  for (i32 i = 0; i < 3; i++) {
+    f32 q = (p[i] - MIN_WORLD_COORD) * (65536.0f / WORLD_SIZE);
+    u64 v = (q <= 0) ? 0 : (q >= 65535) ? 65535 : (u64)q;
+    // spread the 16 bits of v, two zero bits apart
+    v     = (v | (v << 16)) & 0x0000FF0000FFull;
+    v     = (v | (v << 8)) & 0x00F00F00F00Full;
+    v     = (v | (v << 4)) & 0x0C30C30C30C3ull;
+    v     = (v | (v << 2)) & 0x249249249249ull;
+    code |= v << i;
+  }
+  return code;
+}
@@ -5,28 +5,38 @@
 //..................
 
 //..................
-// CM_PointLeafnum_r
+// CM_FindPointLeaf
 //   Returns the id number of the leaf where the point is positioned
 //   with a negative id offset of num
-//   Increases the state of the c_pointcontents counter on success
+//   Doesn't write any state, so it is safe to call from reentrant queries
 //..................
-i32 CM_PointLeafnum_r(const vec3 p, i32 num) {
-  f32     d;
-  cNode*  node;
-  cPlane* plane;
+i32 CM_FindPointLeaf(const vec3 p, i32 num) {
+  f32           d;
+  i32           children[2];
+  const cPlane* plane;
   while (num >= 0) {
-    node  = cm.nodes + num;
-    plane = node->plane;
+    plane = CM_GetNode(num, children);
 
     if (plane->type < 3) d = p[plane->type] - plane->dist;
     else d = GVec3Dot(plane->normal, p) - plane->dist;
-    if (d < 0) num = node->children[1];
-    else num = node->children[0];
+    if (d < 0) num = children[1];
+    else num = children[0];
   }
-  c_pointcontents++;  // optimize counter
   return -1 - num;
 }
 
+//..................
+// CM_PointLeafnum_r
+//   Returns the id number of the leaf where the point is positioned
+//   with a negative id offset of num
+//   Increases the state of the c_pointcontents counter on success
+//..................
+i32 CM_PointLeafnum_r(const vec3 p, i32 num) {
+  i32 leafnum = CM_FindPointLeaf(p, num);
+  c_pointcontents++;  // optimize counter
+  return leafnum;
+}
+
 //..................
 // CM_PointLeafnum
 //   Returns the id number of the leaf where the point is positioned
@@ -37,6 +47,49 @@ i32 CM_PointLeafnum(const vec3 p) {
   return CM_PointLeafnum_r(p, 0);
 }
 
+//..................
+// CM_PointInCell
+//   Checks if the tree walks would send the given point into the given cell (node or leaf)
+//   Only the non-axial planes above the cell are evaluated, with the same operations as CM_FindPointLeaf
+//..................
+static bool CM_PointInCell(const vec3 p, const cCell* cell) {
+  if (!(p[0] >= cell->mins[0] && p[1] >= cell->mins[1] && p[2] >= cell->mins[2]  //
+        && p[0] < cell->maxs[0] && p[1] < cell->maxs[1] && p[2] < cell->maxs[2])) {
+    return false;
+  }
+  i32 children[2];
+  for (i32 num = cell->check, side = cell->checkSide; num >= 0;) {
+    const cPlane* plane = CM_GetNode(num, children);
+    f32           d     = GVec3Dot(plane->normal, p) - plane->dist;
+    if ((d < 0) != side) { return false; }
+    side = cm.nodeCells[num].checkSide;
+    num  = cm.nodeCells[num].check;
+  }
+  return true;
+}
+
+//..................
+// CM_PointLeafnumHint
+//   Same as CM_PointLeafnum, for a point that is likely to be in or near the given leaf (eg: the last leaf of a moving entity)
+//   Keeps the hint when the point is still in its cell, otherwise climbs up to MAX_HINT_CLIMB nodes
+//   to the first one that contains the point, and walks down from there
+//   Any leaf number can be given as hint, a negative one walks down from the root
+//   Increases the state of the c_pointcontents counter on success
+//..................
+i32 CM_PointLeafnumHint(const vec3 p, i32 hint) {
+  if (!cm.numNodes) { return 0; }  // map not loaded
+  c_pointcontents++;
+  if (hint < 0 || hint >= cm.numLeafs || !cm.leafCells) { return CM_FindPointLeaf(p, 0); }
+  const cCell* cell = &cm.leafCells[hint];
+  if (CM_PointInCell(p, cell)) { return hint; }
+  i32 num = cell->parent;
+  for (i32 climb = 0; climb < MAX_HINT_CLIMB && num >= 0; climb++) {
+    if (CM_PointInCell(p, &cm.nodeCells[num])) { return CM_FindPointLeaf(p, num); }
+    num = cm.nodeCells[num].parent;
+  }
+  return CM_FindPointLeaf(p, 0);
+}
+
 //..................
 // CM_BoundsIntersect
 //   Checks if the given AABBs intersect with each other
@@ -71,71 +124,87 @@ bool CM_BoundsIntersectPoint(const vec3 mins, const vec3 maxs, const vec3 point)
 }
 
 //..................
-// CM_PositionTestInPatchCollide
-//   Checks if the given trace data (TraceWork) is inside any of the given patch facets
+// CM_PositionTestInFacet
+//   Checks if the given trace data (TraceWork) is inside the given facet of a patch
 //..................
-bool CM_PositionTestInPatchCollide(TraceWork* tw, const PatchCol* pc) {
-  if (tw->isPoint) { return false; }
+static bool CM_PositionTestInFacet(const TraceWork* tw, const PatchCol* pc, const Facet* facet) {
+  f32         plane[4];
+  vec3        startp;
+  PatchPlane* pp = &pc->planes[facet->surfacePlane];
+  GVec3Copy(pp->plane, plane);
+  plane[3] = pp->plane[3];
+  if (tw->sphere.use) {
+    // adjust the plane distance appropriately for radius
+    plane[3] += tw->sphere.radius;
+
+    // find the closest point on the capsule to the plane
+    f32 t = GVec3Dot(plane, tw->sphere.offset);
+    if (t > 0) {
+      GVec3Sub(tw->start, tw->sphere.offset, startp);
+    } else {
+      GVec3Add(tw->start, tw->sphere.offset, startp);
+    }
+  } else {
+    f32 offset = GVec3Dot(tw->offsets[pp->signbits], plane);
+    plane[3] -= offset;
+    GVec3Copy(tw->start, startp);
+  }
 
-  f32    plane[4];
-  vec3   startp;
-  Facet* facet = pc->facets;
-  for (i32 facetId = 0; facetId < pc->numFacets; facetId++, facet++) {
-    PatchPlane* pp = &pc->planes[facet->surfacePlane];
-    GVec3Copy(pp->plane, plane);
-    plane[3] = pp->plane[3];
+  if (GVec3Dot(plane, startp) - plane[3] > 0.0f) { return false; }
+
+  for (i32 borderId = 0; borderId < facet->numBorders; borderId++) {
+    pp = &pc->planes[facet->borderPlanes[borderId]];
+    if (facet->borderInward[borderId]) {
+      GVec3Neg(pp->plane, plane);
+      plane[3] = -pp->plane[3];
+    } else {
+      GVec3Copy(pp->plane, plane);
+      plane[3] = pp->plane[3];
+    }
     if (tw->sphere.use) {
       // adjust the plane distance appropriately for radius
       plane[3] += tw->sphere.radius;
 
       // find the closest point on the capsule to the plane
       f32 t = GVec3Dot(plane, tw->sphere.offset);
-      if (t > 0) {
+      if (t > 0.0f) {
         GVec3Sub(tw->start, tw->sphere.offset, startp);
       } else {
         GVec3Add(tw->start, tw->sphere.offset, startp);
       }
     } else {
+      // NOTE: this works even though the plane might be flipped because the bbox is centered
       f32 offset = GVec3Dot(tw->offsets[pp->signbits], plane);
-      plane[3] -= offset;
+      plane[3] += fabs(offset);
       GVec3Copy(tw->start, startp);
     }
 
-    if (GVec3Dot(plane, startp) - plane[3] > 0.0f) { continue; }
+    if (GVec3Dot(plane, startp) - plane[3] > 0.0f) { return false; }
+  }
+  // inside this patch facet
+  return true;
+}
 
-    i32 borderId;
-    for (borderId = 0; borderId < facet->numBorders; borderId++) {
-      pp = &pc->planes[facet->borderPlanes[borderId]];
-      if (facet->borderInward[borderId]) {
-        GVec3Neg(pp->plane, plane);
-        plane[3] = -pp->plane[3];
-      } else {
-        GVec3Copy(pp->plane, plane);
-        plane[3] = pp->plane[3];
-      }
-      if (tw->sphere.use) {
-        // adjust the plane distance appropriately for radius
-        plane[3] += tw->sphere.radius;
-
-        // find the closest point on the capsule to the plane
-        f32 t = GVec3Dot(plane, tw->sphere.offset);
-        if (t > 0.0f) {
-          GVec3Sub(tw->start, tw->sphere.offset, startp);
-        } else {
-          GVec3Add(tw->start, tw->sphere.offset, startp);
-        }
-      } else {
-        // NOTE: this works even though the plane might be flipped because the bbox is centered
-        f32 offset = GVec3Dot(tw->offsets[pp->signbits], plane);
-        plane[3] += fabs(offset);
-        GVec3Copy(tw->start, startp);
+//..................
+// CM_PositionTestInPatchCollide
+//   Checks if the given trace data (TraceWork) is inside any of the given patch facets
+//   Packed patches only test the facets whose bounds touch the trace (CM_FacetBVHBlocks and CM_PatchFacetBoundsHits)
+//..................
+bool CM_PositionTestInPatchCollide(TraceWork* tw, const PatchCol* pc) {
+  if (tw->isPoint) { return false; }
+  if (CM_UsePatchKernels(pc)) {
+    i32 blocks[MAX_FACETS / SIMD_LANES];
+    i32 numBlocks = CM_FacetBVHBlocks(tw, pc, blocks);
+    for (i32 i = 0; i < numBlocks; i++) {
+      i32 first = blocks[i] * SIMD_LANES;
+      for (u32 hits = CM_PatchFacetBoundsHits(tw, pc, first); hits; hits &= hits - 1) {
+        if (CM_PositionTestInFacet(tw, pc, &pc->facets[first + __builtin_ctz(hits)])) { return true; }
       }
-
-      if (GVec3Dot(plane, startp) - plane[3] > 0.0f) { break; }
     }
-    if (borderId < facet->numBorders) { continue; }
-    // inside this patch facet
-    return true;
+    return false;
+  }
+  for (i32 facetId = 0; facetId < pc->numFacets; facetId++) {
+    if (CM_PositionTestInFacet(tw, pc, &pc->facets[facetId])) { return true; }
   }
   return false;
 }
@@ -182,27 +251,41 @@ i32 BoxOnPlaneSide(const vec3 emins, const vec3 emaxs, const cPlane* p) {
 
 
 //..................
-// CM_TestBoxInBrush
+// CM_TestBoxInBrushSides
+//   Specialized for the box and capsule trace modes (traceMode_t). Position tests are never points
+//   The box tests of a registered hull (TRACE_MODE_HULL) test the start point against its expanded sides
+//   Also specialized for the side width of the brush (cBrush.sideBits), so the side loops read their planes without checking it
 //..................
-static void CM_TestBoxInBrush(TraceWork* tw, const cBrush* brush) {
+CM_SPECIALIZED void CM_TestBoxInBrushSides(TraceWork* tw, const cBrush* brush, const i32 mode, const i32 bits) {
   if (!brush->numsides) { return; }
   // special test for axial
   if (tw->bounds[0][0] > brush->bounds[1][0] || tw->bounds[0][1] > brush->bounds[1][1] || tw->bounds[0][2] > brush->bounds[1][2]
       || tw->bounds[1][0] < brush->bounds[0][0] || tw->bounds[1][1] < brush->bounds[0][1] || tw->bounds[1][2] < brush->bounds[0][2]) {
     return;
   }
-  cPlane* plane;
-  f64     dist;
-  f64     d1;
-  cBSide* side;
-  f64     t;
-  vec3    startp;
-  if (tw->sphere.use) {
+  const cPlane* plane;
+  f64           dist;
+  f64           d1;
+  f64           t;
+  vec3          startp;
+  if (mode == TRACE_MODE_HULL) {
+    // the first six planes are the axial planes, so we only
+    // need to test the remainder, already expanded by the box
+    const cHullPlane* hullPlanes = &tw->hull->planes[brush->hullSide];
+    for (i32 i = 6; i < brush->numsides; i++) {
+      d1 = DVec3Dot(tw->start, hullPlanes[i].normal) - hullPlanes[i].dist;
+      // if completely in front of face, no intersection
+      if (d1 > 0) { return; }
+    }
+  } else if (CM_UseSideKernels(brush)) {
+    // packed brushes test all their non-axial sides at once, with the vectorized kernels
+    bool outside = mode == TRACE_MODE_CAPSULE ? CM_TestSphereSidesOutside(tw, brush) : CM_TestSidesOutside(tw, brush);
+    if (outside) { return; }
+  } else if (mode == TRACE_MODE_CAPSULE) {
     // the first six planes are the axial planes, so we only
     // need to test the remainder
     for (i32 i = 6; i < brush->numsides; i++) {
-      side  = brush->sides + i;
-      plane = side->plane;
+      plane = CM_SideBitsPlane(brush, i, bits);
 
       // adjust the plane distance appropriately for radius
       dist  = plane->dist + tw->sphere.radius;
@@ -221,8 +304,7 @@ static void CM_TestBoxInBrush(TraceWork* tw, const cBrush* brush) {
     // the first six planes are the axial planes, so we only
     // need to test the remainder
     for (i32 i = 6; i < brush->numsides; i++) {
-      side  = brush->sides + i;
-      plane = side->plane;
+      plane = CM_SideBitsPlane(brush, i, bits);
 
       // adjust the plane distance appropriately for mins/maxs
       dist  = plane->dist - GVec3Dot(tw->offsets[plane->signbits], plane->normal);
@@ -239,37 +321,62 @@ static void CM_TestBoxInBrush(TraceWork* tw, const cBrush* brush) {
   tw->trace.fraction   = 0;
   tw->trace.contents   = brush->contents;
 }
+//..................
+// CM_TestBoxInBrush
+//   Calls the CM_TestBoxInBrushSides specialization for the side width of the brush,
+//   or the one of the registered hull for the box tests of its size
+//..................
+CM_SPECIALIZED void CM_TestBoxInBrush(TraceWork* tw, const cBrush* brush, const i32 mode) {
+  if (mode == TRACE_MODE_BOX && tw->hull && brush->hullSide >= 0) {
+    CM_TestBoxInBrushSides(tw, brush, TRACE_MODE_HULL, brush->sideBits);
+  } else if (!brush->sideBits) {
+    CM_TestBoxInBrushSides(tw, brush, mode, 0);
+  } else if (brush->sideBits == 16) {
+    CM_TestBoxInBrushSides(tw, brush, mode, 16);
+  } else {
+    CM_TestBoxInBrushSides(tw, brush, mode, 32);
+  }
+}
 
 //..................
-// CM_TestInLeaf
+// CM_TestModeInLeaf
+//   Body of the CM_TestInLeaf specializations, with the brush tests of the same trace mode inlined in it
 //..................
-void CM_TestInLeaf(TraceWork* tw, const cLeaf* leaf) {
+CM_SPECIALIZED void CM_TestModeInLeaf(TraceWork* tw, const cLeaf* leaf, const i32 mode) {
   // test box position against all brushes in the leaf
   cBrush* b;
-  for (i32 k = 0; k < leaf->numLeafBrushes; k++) {
-    i32 brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
-    b            = &cm.brushes[brushnum];
-    if (b->checkcount == cm.checkcount) {
-      continue;  // already checked this brush in another leaf
+  if (CM_UseLeafKernels(leaf)) {
+    // packed leafs reject the brushes with other contents or out of bounds first, like in CM_TraceThroughLeaf.
+    // the bounds are a little larger than the ones of CM_TestBoxInBrush, which still does its own test
+    for (i32 first = 0; first < leaf->numLeafBrushes; first += SIMD_LANES) {
+      for (u32 hits = CM_LeafBrushHits(tw, &leaf->blocks[first / SIMD_LANES]); hits; hits &= hits - 1) {
+        i32 brushnum = cm.leafbrushes[leaf->firstLeafBrush + first + __builtin_ctz(hits)];
+        if (CM_BrushChecked(tw, brushnum)) { continue; }  // already checked this brush in another leaf
+        CM_TestBoxInBrush(tw, &cm.brushes[brushnum], mode);
+        if (tw->trace.allsolid) { return; }
+      }
     }
-    b->checkcount = cm.checkcount;
+  } else {
+    for (i32 k = 0; k < leaf->numLeafBrushes; k++) {
+      i32 brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
+      b            = &cm.brushes[brushnum];
+      if (CM_BrushChecked(tw, brushnum)) { continue; }  // already checked this brush in another leaf
 
-    if (!(b->contents & tw->contents)) { continue; }
+      if (!(b->contents & tw->contents)) { continue; }
 
-    CM_TestBoxInBrush(tw, b);
-    if (tw->trace.allsolid) { return; }
+      CM_TestBoxInBrush(tw, b, mode);
+      if (tw->trace.allsolid) { return; }
+    }
   }
 
   // test against all patches
   cPatch* patch;
   if (col.doPatchCol) {
     for (i32 k = 0; k < leaf->numLeafSurfaces; k++) {
-      patch = cm.surfaces[cm.leafsurfaces[leaf->firstLeafSurface + k]];
+      i32 surfnum = cm.leafsurfaces[leaf->firstLeafSurface + k];
+      patch       = cm.surfaces[surfnum];
       if (!patch) { continue; }
-      if (patch->checkcount == cm.checkcount) {
-        continue;  // already checked this brush in another leaf
-      }
-      patch->checkcount = cm.checkcount;
+      if (CM_PatchChecked(tw, surfnum)) { continue; }  // already checked this patch in another leaf
 
       if (!(patch->contents & tw->contents)) { continue; }
 
@@ -283,15 +390,103 @@ void CM_TestInLeaf(TraceWork* tw, const cLeaf* leaf) {
   }
 }
 
+//..................
+// CM_TestBoxInLeaf, CM_TestCapsuleInLeaf
+//   CM_TestModeInLeaf specializations
+//..................
+static void CM_TestBoxInLeaf(TraceWork* tw, const cLeaf* leaf) { CM_TestModeInLeaf(tw, leaf, TRACE_MODE_BOX); }
+static void CM_TestCapsuleInLeaf(TraceWork* tw, const cLeaf* leaf) { CM_TestModeInLeaf(tw, leaf, TRACE_MODE_CAPSULE); }
+
+//..................
+// CM_TestInLeaf
+//   Calls the specialization of the trace mode
+//..................
+void CM_TestInLeaf(TraceWork* tw, const cLeaf* leaf) {
+  if (tw->mode == TRACE_MODE_CAPSULE) {
+    CM_TestCapsuleInLeaf(tw, leaf);
+  } else {
+    CM_TestBoxInLeaf(tw, leaf);
+  }
+}
+
+//..................
+// CM_TestInItems
+//   Tests the trace data (TraceWork) position against the given brushes and patches (brush numbers, or -1-surfnum)
+//   Same tests as CM_TestInLeaf, without the checkcount marks: every item is listed once
+//..................
+void CM_TestInItems(TraceWork* tw, const i32* items, i32 count) {
+  for (i32 i = 0; i < count; i++) {
+    if (items[i] >= 0) {
+      const cBrush* b = &cm.brushes[items[i]];
+      if (!(b->contents & tw->contents)) { continue; }
+      if (tw->mode == TRACE_MODE_CAPSULE) {
+        CM_TestBoxInBrush(tw, b, TRACE_MODE_CAPSULE);
+      } else {
+        CM_TestBoxInBrush(tw, b, TRACE_MODE_BOX);
+      }
+      if (tw->trace.allsolid) { return; }
+      continue;
+    }
+    if (!col.doPatchCol) { continue; }
+    const cPatch* patch = cm.surfaces[-1 - items[i]];
+    if (!(patch->contents & tw->contents)) { continue; }
+    if (CM_PositionTestInPatchCollide(tw, patch->pc)) {
+      tw->trace.startsolid = tw->trace.allsolid = true;
+      tw->trace.fraction                        = 0;
+      tw->trace.contents                        = patch->contents;
+      return;
+    }
+  }
+}
+
+//..................
+// CM_TestInBVHLeaf
+//   BVHVisit of CM_TestInBVH. Stops the walk once the position is allsolid
+//..................
+static bool CM_TestInBVHLeaf(void* data, const i32* items, i32 count) {
+  TraceWork* tw = data;
+  CM_TestInItems(tw, items, count);
+  return tw->trace.allsolid;
+}
+
+//..................
+// CM_TestInBVH
+//   Tests the trace data (TraceWork) position against the brushes and patches of the BVH leafs that touch the given box
+//..................
+static void CM_TestInBVH(TraceWork* tw, const vec3 mins, const vec3 maxs) { CM_BVHBoxLeafs(mins, maxs, CM_TestInBVHLeaf, tw); }
+
+//..................
+// CM_TestInModel
+//   Tests the trace data (TraceWork) position against all brushes and patches of the given clipModel
+//   Temporary boxes are tested with CM_TestInBox instead
+//..................
+void CM_TestInModel(TraceWork* tw, const cModel* cmod) { CM_TestInLeaf(tw, &cmod->leaf); }
+
+//..................
+// CM_TestInBox
+//   Tests the trace data (TraceWork) position against the axial box mins/maxs, without building a box hull for it
+//   Same result as CM_TestBoxInBrush on the brush of a temporary box model (CM_TempBoxModel),
+//   which only has the axial sides that its bounds test already covers
+//..................
+void CM_TestInBox(TraceWork* tw, const vec3 mins, const vec3 maxs) {
+  if (!(CONTENTS_BODY & tw->contents)) { return; }
+  if (tw->bounds[0][0] > maxs[0] || tw->bounds[0][1] > maxs[1] || tw->bounds[0][2] > maxs[2]  //
+      || tw->bounds[1][0] < mins[0] || tw->bounds[1][1] < mins[1] || tw->bounds[1][2] < mins[2]) {
+    return;
+  }
+  // inside the box
+  tw->trace.startsolid = true;
+  tw->trace.allsolid   = true;
+  tw->trace.fraction   = 0;
+  tw->trace.contents   = CONTENTS_BODY;
+}
+
 //..................
 // CM_TestCapsuleInCapsule
 //   Check if the given trace data (TraceWork) capsule
-//   is inside the given clipModel handle capsule
+//   is inside the capsule that fills the box mins/maxs
 //..................
-void CM_TestCapsuleInCapsule(TraceWork* tw, cHandle model) {
-  vec3 mins, maxs;
-  CM_ModelBounds(model, mins, maxs);
-
+void CM_TestCapsuleInCapsule(TraceWork* tw, const vec3 mins, const vec3 maxs) {
   vec3 top, bottom;
   GVec3Add(tw->start, tw->sphere.offset, top);
   GVec3Sub(tw->start, tw->sphere.offset, bottom);
@@ -354,13 +549,9 @@ void CM_TestCapsuleInCapsule(TraceWork* tw, cHandle model) {
 //..................
 // CM_TestBoundingBoxInCapsule
 //   Check if the given trace data (TraceWork) AABB
-//   is inside the given clipModel handle capsule
+//   is inside the capsule that fills the box mins/maxs
 //..................
-void CM_TestBoundingBoxInCapsule(TraceWork* tw, cHandle model) {
-  // mins maxs of the capsule
-  vec3 mins, maxs;
-  CM_ModelBounds(model, mins, maxs);
-
+void CM_TestBoundingBoxInCapsule(TraceWork* tw, const vec3 mins, const vec3 maxs) {
   // offset for capsule center
   vec3 offset, size[2];
   for (i32 i = 0; i < 3; i++) {
@@ -377,11 +568,8 @@ void CM_TestBoundingBoxInCapsule(TraceWork* tw, cHandle model) {
   tw->sphere.halfHeight = size[1][2];
   GVec3Set(tw->sphere.offset, 0, 0, size[1][2] - tw->sphere.radius);
 
-  // replace the capsule with the bounding box
-  cHandle h    = CM_TempBoxModel(tw->size[0], tw->size[1], false);
-  // calculate collision
-  cModel* cmod = CM_ClipHandleToModel(h);
-  CM_TestInLeaf(tw, &cmod->leaf);
+  // replace the capsule with the bounding box, and calculate collision
+  CM_TestInBox(tw, tw->size[0], tw->size[1]);
 }
 
 //..................
@@ -398,23 +586,28 @@ void CM_PositionTest(TraceWork* tw) {
     ll.bounds[1][i] += 1;
   }
 
+  if (col.doBVH) {
+    CM_TestInBVH(tw, ll.bounds[0], ll.bounds[1]);
+    return;
+  }
+
   i32 leafs[MAX_POSITION_LEAFS];
   ll.list       = leafs;
   ll.count      = 0;
   ll.maxcount   = MAX_POSITION_LEAFS;
   ll.storeLeafs = CM_StoreLeafs;
   ll.lastLeaf   = 0;
+  ll.contents   = tw->contents;  // leafs that can't touch anything are not stored
+  ll.colTree    = true;
   ll.overflowed = false;
 
-  cm.checkcount++;
-
-  CM_BoxLeafnums_r(&ll, 0);
+  CM_BoxLeafnums_r(&ll, cm.colRoot);
 
-  cm.checkcount++;
+  CM_NextCheck(tw);
 
   // test the contents of the leafs
   for (i32 i = 0; i < ll.count; i++) {
-    CM_TestInLeaf(tw, &cm.leafs[leafs[i]]);
+    CM_TestInLeaf(tw, &tw->leafs[leafs[i]]);
     if (tw->trace.allsolid) { break; }
   }
 }
@@ -0,0 +1,1168 @@
+#include "../solve.h"
+#if defined __x86_64__ || defined __i386__
+#  define SIMD_X86
+#  include <immintrin.h>
+#endif
+
+//..................
+// Solve: Brush side kernels
+//   Evaluate the side planes of a brush from its packed copy (cSideBlock), SIMD_LANES sides at a time
+//   Every lane repeats the exact operations of the scalar code in trace.c and position.c, in the same order and precision,
+//   so that the distances, and the fractions computed from them, are bit-identical
+//   The kernels are selected at runtime: AVX2, SSE4.1 or the scalar fallback
+//   Point traces read the plane dists as they are, and capsules get their own kernels. The trace core picks one per trace mode
+// Solve: Leaf brush kernels
+//   Reject the brushes of a leaf whose contents or bounds miss the trace, from the packed copy of their bounds (cBrushBlock),
+//   SIMD_LANES brushes at a time, before any cBrush is loaded. Same comparisons as CM_BoundsIntersect
+// Solve: Patch facet kernels
+//   Reject the facets of a patch whose surface plane alone already misses the trace, from the packed copy of those planes,
+//   SIMD_LANES facets at a time. The remaining facets are traced by the scalar code, which only evaluates the planes they use
+// Solve: Ray packet kernels
+//   Classify the segments of a packet of point traces against one node plane, MAX_PACKET_RAYS lanes at a time
+//   Same precision rules as the side kernels, so the packet walks the exact same nodes as each point trace on its own
+//..................
+
+//..................
+// Kernel dispatch
+typedef bool (*TraceSidesFn)(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2);
+typedef bool (*TestSidesFn)(const TraceWork* tw, const cBrush* brush);
+typedef void (*PlaneSidesFn)(const cPlane* plane, const RaySegments* seg, u32 mask, PacketSplit* split);
+typedef u32 (*LeafBrushesFn)(const TraceWork* tw, const cBrushBlock* block);
+typedef u32 (*PatchFacetsFn)(const TraceWork* tw, const cSideBlock* block);
+static TraceSidesFn  traceSides;
+static TraceSidesFn  traceSidesSphere;
+static TraceSidesFn  traceSidesPoint;
+static TestSidesFn   testSides;
+static TestSidesFn   testSidesSphere;
+static PlaneSidesFn  planeSides;
+static LeafBrushesFn leafBrushes;
+static PatchFacetsFn patchFacets;
+// floats from the dists of a packed side block to the dists of the next one
+#define SIDE_BLOCK_STRIDE (i32)(sizeof(cSideBlock) / sizeof(f32))
+
+//..................
+// CM_PackBrushSides
+//   Builds the packed side blocks of every brush of the loaded map
+//   Padding lanes get a zero normal with a positive dist, so they are always behind, and never reject the brush
+//..................
+void CM_PackBrushSides(void) {
+  cm.numSideBlocks = 0;
+  for (i32 brushId = 0; brushId < cm.numBrushes; brushId++) {
+    cBrush* b = &cm.brushes[brushId];
+    if (!b->numsides || b->numsides > MAX_SIMD_BRUSH_SIDES) { continue; }
+    i32 numBlocks = (b->numsides + SIMD_LANES - 1) / SIMD_LANES;
+    b->blocks     = Hunk_Alloc(numBlocks * sizeof(*b->blocks), h_high);
+    cm.numSideBlocks += numBlocks;
+    for (i32 lane = 0; lane < numBlocks * SIMD_LANES; lane++) {
+      cSideBlock* block = &b->blocks[lane / SIMD_LANES];
+      i32         id    = lane % SIMD_LANES;
+      if (lane >= b->numsides) {
+        block->dist[id] = 1;
+        continue;
+      }
+      const cPlane* plane = CM_SidePlane(b, lane);
+      for (i32 axis = 0; axis < 3; axis++) {
+        block->normal[axis][id] = plane->normal[axis];
+        block->signs[axis][id]  = ((plane->signbits >> axis) & 1) ? 0xFFFFFFFF : 0;
+      }
+      block->dist[id] = plane->dist;
+    }
+  }
+}
+
+//..................
+// CM_PackLeafBrushes
+//   Builds the packed brush blocks of every leaf of the loaded map, of its leaf sets, and of the leafs of its submodels
+//   The bounds are stored already expanded by BOUNDS_CLIP_EPSILON, with the same float operations as CM_BoundsIntersect
+//..................
+static void CM_PackLeaf(cLeaf* leaf) {
+  if (!leaf->numLeafBrushes) { return; }
+  i32 numBlocks = (leaf->numLeafBrushes + SIMD_LANES - 1) / SIMD_LANES;
+  leaf->blocks  = Hunk_Alloc(numBlocks * sizeof(*leaf->blocks), h_high);
+  memset(leaf->blocks, 0, numBlocks * sizeof(*leaf->blocks));
+  for (i32 k = 0; k < leaf->numLeafBrushes; k++) {
+    cBrushBlock*  block = &leaf->blocks[k / SIMD_LANES];
+    i32           id    = k % SIMD_LANES;
+    const cBrush* b     = &cm.brushes[cm.leafbrushes[leaf->firstLeafBrush + k]];
+    for (i32 axis = 0; axis < 3; axis++) {
+      block->mins[axis][id] = b->bounds[0][axis] - BOUNDS_CLIP_EPSILON;
+      block->maxs[axis][id] = b->bounds[1][axis] + BOUNDS_CLIP_EPSILON;
+    }
+    block->contents[id] = b->contents;
+  }
+}
+void CM_PackLeafBrushes(void) {
+  for (i32 leafId = 0; leafId < cm.numLeafs; leafId++) { CM_PackLeaf(&cm.leafs[leafId]); }
+  for (i32 setId = 0; setId < cm.numLeafSets; setId++) {
+    for (i32 leafId = 0; leafId < cm.numLeafs; leafId++) { CM_PackLeaf(&cm.leafSets[setId].leafs[leafId]); }
+  }
+  for (i32 modelId = 1; modelId < cm.numSubModels; modelId++) { CM_PackLeaf(&cm.cmodels[modelId].leaf); }
+}
+
+//..................
+// CM_FacetAxialBound
+//   Narrows the bounds of a facet with the given plane of the facet, when it is axial. Inward planes are flipped
+//..................
+static void CM_FacetAxialBound(const PatchPlane* pp, bool inward, vec3 mins, vec3 maxs) {
+  for (i32 axis = 0; axis < 3; axis++) {
+    if (pp->plane[(axis + 1) % 3] != 0 || pp->plane[(axis + 2) % 3] != 0) { continue; }
+    f32 dir  = inward ? -pp->plane[axis] : pp->plane[axis];
+    f32 dist = inward ? -pp->plane[3] : pp->plane[3];
+    if (dir == 1 && dist < maxs[axis]) { maxs[axis] = dist; }
+    if (dir == -1 && -dist > mins[axis]) { mins[axis] = -dist; }
+  }
+}
+
+//..................
+// CM_PackPatchFacets
+//   Builds the packed surface planes and bounds of the facets of the given patch
+//   A box trace that is completely in front of an axial plane of a facet by more than SURFACE_CLIP_EPSILON never hits it,
+//   so the bounds come from the axial bevels (and axial surface planes) of each facet, expanded by one unit.
+//   Facets without some axial plane are unbounded on that side
+//   Padding lanes are never returned by the facet kernels, whatever they contain
+//..................
+void CM_PackPatchFacets(PatchCol* pc) {
+  if (!pc->numFacets) { return; }
+  i32 numBlocks   = (pc->numFacets + SIMD_LANES - 1) / SIMD_LANES;
+  pc->blocks      = Hunk_Alloc(numBlocks * sizeof(*pc->blocks), h_high);
+  pc->facetBounds = Hunk_Alloc(numBlocks * sizeof(*pc->facetBounds), h_high);
+  memset(pc->blocks, 0, numBlocks * sizeof(*pc->blocks));
+  memset(pc->facetBounds, 0, numBlocks * sizeof(*pc->facetBounds));
+  for (i32 facetId = 0; facetId < pc->numFacets; facetId++) {
+    const Facet*      facet  = &pc->facets[facetId];
+    cSideBlock*       block  = &pc->blocks[facetId / SIMD_LANES];
+    cBrushBlock*      bounds = &pc->facetBounds[facetId / SIMD_LANES];
+    i32               id     = facetId % SIMD_LANES;
+    const PatchPlane* pp     = &pc->planes[facet->surfacePlane];
+    for (i32 axis = 0; axis < 3; axis++) {
+      block->normal[axis][id] = pp->plane[axis];
+      block->signs[axis][id]  = ((pp->signbits >> axis) & 1) ? 0xFFFFFFFF : 0;
+    }
+    block->dist[id] = pp->plane[3];
+    vec3 mins       = { -INFINITY, -INFINITY, -INFINITY };
+    vec3 maxs       = { INFINITY, INFINITY, INFINITY };
+    CM_FacetAxialBound(pp, false, mins, maxs);
+    for (i32 borderId = 0; borderId < facet->numBorders; borderId++) {
+      CM_FacetAxialBound(&pc->planes[facet->borderPlanes[borderId]], facet->borderInward[borderId], mins, maxs);
+    }
+    for (i32 axis = 0; axis < 3; axis++) {
+      bounds->mins[axis][id] = mins[axis] - 1;
+      bounds->maxs[axis][id] = maxs[axis] + 1;
+    }
+    bounds->contents[id] = -1;  // the contents of the patch were already checked
+  }
+}
+
+
+//..................
+// Scalar fallback
+//..................
+
+//..................
+// CM_TraceSides_Scalar
+//   Distances of the trace start and end to every side of the brush, expanded by the box offsets
+//   Returns false as soon as the trace is completely in front of one side, like CM_TraceThroughBrush
+//..................
+static bool CM_TraceSides_Scalar(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) {
+  for (i32 sideId = 0; sideId < brush->numsides; sideId++) {
+    const cSideBlock* block = &brush->blocks[sideId / SIMD_LANES];
+    i32               id    = sideId % SIMD_LANES;
+    vec3              normal;
+    vec3              offset;
+    for (i32 axis = 0; axis < 3; axis++) {
+      normal[axis] = block->normal[axis][id];
+      offset[axis] = tw->size[block->signs[axis][id] ? 1 : 0][axis];
+    }
+    f32 dist     = block->dist[id] - GVec3Dot(offset, normal);
+    d1[sideId]   = GVec3Dot(tw->start, normal) - dist;
+    d2[sideId]   = GVec3Dot(tw->end, normal) - dist;
+    if (d1[sideId] > 0 && (d2[sideId] >= SURFACE_CLIP_EPSILON || d2[sideId] >= d1[sideId])) { return false; }
+  }
+  return true;
+}
+
+//..................
+// CM_TraceSidesSphere_Scalar
+//   Same as CM_TraceSides_Scalar, for the closest point of the capsule to each side
+//..................
+static bool CM_TraceSidesSphere_Scalar(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) {
+  vec3 startp;
+  vec3 endp;
+  for (i32 sideId = 0; sideId < brush->numsides; sideId++) {
+    const cSideBlock* block = &brush->blocks[sideId / SIMD_LANES];
+    i32               id    = sideId % SIMD_LANES;
+    vec3              normal;
+    for (i32 axis = 0; axis < 3; axis++) { normal[axis] = block->normal[axis][id]; }
+    f32 dist = block->dist[id] + tw->sphere.radius;
+    f32 t    = GVec3Dot(normal, tw->sphere.offset);
+    if (t > 0) {
+      DVec3Sub(tw->start, tw->sphere.offset, startp);
+      DVec3Sub(tw->end, tw->sphere.offset, endp);
+    } else {
+      DVec3Add(tw->start, tw->sphere.offset, startp);
+      DVec3Add(tw->end, tw->sphere.offset, endp);
+    }
+    d1[sideId] = GVec3Dot(startp, normal) - dist;
+    d2[sideId] = GVec3Dot(endp, normal) - dist;
+    if (d1[sideId] > 0 && (d2[sideId] >= SURFACE_CLIP_EPSILON || d2[sideId] >= d1[sideId])) { return false; }
+  }
+  return true;
+}
+
+//..................
+// CM_TestSides_Scalar
+//   Returns true when the box is in front of any of the non-axial sides of the brush, like CM_TestBoxInBrush
+//..................
+static bool CM_TestSides_Scalar(const TraceWork* tw, const cBrush* brush) {
+  for (i32 sideId = 6; sideId < brush->numsides; sideId++) {
+    const cSideBlock* block = &brush->blocks[sideId / SIMD_LANES];
+    i32               id    = sideId % SIMD_LANES;
+    vec3              normal;
+    vec3              offset;
+    for (i32 axis = 0; axis < 3; axis++) {
+      normal[axis] = block->normal[axis][id];
+      offset[axis] = tw->size[block->signs[axis][id] ? 1 : 0][axis];
+    }
+    f64 dist = block->dist[id] - GVec3Dot(offset, normal);
+    f64 d1   = DVec3Dot(tw->start, normal) - dist;
+    if (d1 > 0) { return true; }
+  }
+  return false;
+}
+
+//..................
+// CM_TestSidesSphere_Scalar
+//   Same as CM_TestSides_Scalar, for the closest point of the capsule to each side
+//..................
+static bool CM_TestSidesSphere_Scalar(const TraceWork* tw, const cBrush* brush) {
+  vec3 startp;
+  for (i32 sideId = 6; sideId < brush->numsides; sideId++) {
+    const cSideBlock* block = &brush->blocks[sideId / SIMD_LANES];
+    i32               id    = sideId % SIMD_LANES;
+    vec3              normal;
+    for (i32 axis = 0; axis < 3; axis++) { normal[axis] = block->normal[axis][id]; }
+    f64 dist = block->dist[id] + tw->sphere.radius;
+    f64 t    = DVec3Dot(normal, tw->sphere.offset);
+    if (t > 0) {
+      DVec3Sub(tw->start, tw->sphere.offset, startp);
+    } else {
+      DVec3Add(tw->start, tw->sphere.offset, startp);
+    }
+    f64 d1 = DVec3Dot(startp, normal) - dist;
+    if (d1 > 0) { return true; }
+  }
+  return false;
+}
+
+//..................
+// CM_TraceSidesDists_Scalar
+//   Same as CM_TraceSides_Scalar, with side dists that the trace doesn't expand (the plane dists of a point trace)
+//   The dists of block N start at dists + N * stride
+//..................
+static inline bool CM_TraceSidesDists_Scalar(const TraceWork* tw, const cBrush* brush, const f32* dists, i32 stride, f32* d1, f32* d2) {
+  for (i32 sideId = 0; sideId < brush->numsides; sideId++) {
+    const cSideBlock* block = &brush->blocks[sideId / SIMD_LANES];
+    i32               id    = sideId % SIMD_LANES;
+    vec3              normal;
+    for (i32 axis = 0; axis < 3; axis++) { normal[axis] = block->normal[axis][id]; }
+    f32 dist   = dists[(sideId / SIMD_LANES) * stride + id];
+    d1[sideId] = GVec3Dot(tw->start, normal) - dist;
+    d2[sideId] = GVec3Dot(tw->end, normal) - dist;
+    if (d1[sideId] > 0 && (d2[sideId] >= SURFACE_CLIP_EPSILON || d2[sideId] >= d1[sideId])) { return false; }
+  }
+  return true;
+}
+
+//..................
+// CM_TraceSidesPoint_Scalar
+//   Same as CM_TraceSides_Scalar, for point traces: the side dists don't need any expansion
+//..................
+static bool CM_TraceSidesPoint_Scalar(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) {
+  return CM_TraceSidesDists_Scalar(tw, brush, brush->blocks->dist, SIDE_BLOCK_STRIDE, d1, d2);
+}
+
+//..................
+// CM_LeafBrushes_Scalar
+//   Returns a bit for each brush of the block that shares contents with the trace, and whose bounds touch the trace bounds
+//..................
+static u32 CM_LeafBrushes_Scalar(const TraceWork* tw, const cBrushBlock* block) {
+  u32 hits = 0;
+  for (i32 id = 0; id < SIMD_LANES; id++) {
+    if (!(block->contents[id] & tw->contents)) { continue; }
+    bool miss = false;
+    for (i32 axis = 0; axis < 3; axis++) {
+      if (tw->bounds[1][axis] < block->mins[axis][id] || tw->bounds[0][axis] > block->maxs[axis][id]) { miss = true; }
+    }
+    if (!miss) { hits |= 1u << id; }
+  }
+  return hits;
+}
+
+//..................
+// CM_PatchFacets_Scalar
+//   Returns a bit for each facet of the block that can still be hit through its surface plane:
+//   point traces must enter it in front, before the current fraction, like CM_TracePointThroughPatchCollide.
+//   Box and capsule traces must not be completely in front of it, like CM_TraceThroughPatchCollide
+//..................
+static u32 CM_PatchFacets_Scalar(const TraceWork* tw, const cSideBlock* block) {
+  u32 hits = 0;
+  for (i32 id = 0; id < SIMD_LANES; id++) {
+    vec3 normal;
+    vec3 startp;
+    vec3 endp;
+    f32  dist;
+    for (i32 axis = 0; axis < 3; axis++) { normal[axis] = block->normal[axis][id]; }
+    if (tw->sphere.use && !tw->isPoint) {
+      dist = block->dist[id] + tw->sphere.radius;
+      if (GVec3Dot(normal, tw->sphere.offset) > 0) {
+        GVec3Sub(tw->start, tw->sphere.offset, startp);
+        GVec3Sub(tw->end, tw->sphere.offset, endp);
+      } else {
+        GVec3Add(tw->start, tw->sphere.offset, startp);
+        GVec3Add(tw->end, tw->sphere.offset, endp);
+      }
+    } else {
+      vec3 offset;
+      for (i32 axis = 0; axis < 3; axis++) { offset[axis] = tw->size[block->signs[axis][id] ? 1 : 0][axis]; }
+      dist = block->dist[id] - GVec3Dot(offset, normal);
+      GVec3Copy(tw->start, startp);
+      GVec3Copy(tw->end, endp);
+    }
+    f32 d1 = GVec3Dot(startp, normal) - dist;
+    f32 d2 = GVec3Dot(endp, normal) - dist;
+    if (tw->isPoint) {
+      if (d1 > 0 && d2 < d1 && d1 / (d1 - d2) <= tw->trace.fraction) { hits |= 1u << id; }
+    } else if (!(d1 > 0 && (d2 >= SURFACE_CLIP_EPSILON || d2 >= d1))) {
+      hits |= 1u << id;
+    }
+  }
+  return hits;
+}
+
+//..................
+// CM_PlaneSides_Scalar
+//   Classifies every active ray against the plane, and finds the crosspoints of the rays that cross it,
+//   with the same operations as CM_TraceThroughTree for a point trace
+//..................
+static void CM_PlaneSides_Scalar(const cPlane* plane, const RaySegments* seg, u32 mask, PacketSplit* split) {
+  memset(split, 0, 4 * sizeof(u32));
+  for (u32 bits = mask; bits; bits &= bits - 1) {
+    i32 lane = __builtin_ctz(bits);
+    f64 t1, t2, offset = 0;
+    if (plane->type < 3) {
+      t1 = seg->p1[plane->type][lane] - plane->dist;
+      t2 = seg->p2[plane->type][lane] - plane->dist;
+    } else {
+      t1 = (plane->normal[0] * seg->p1[0][lane] + plane->normal[1] * seg->p1[1][lane]) + plane->normal[2] * seg->p1[2][lane] - plane->dist;
+      t2 = (plane->normal[0] * seg->p2[0][lane] + plane->normal[1] * seg->p2[1][lane]) + plane->normal[2] * seg->p2[2][lane] - plane->dist;
+    }
+    if (t1 >= offset + 1 && t2 >= offset + 1) {
+      split->front |= 1u << lane;
+      continue;
+    }
+    if (t1 < -offset - 1 && t2 < -offset - 1) {
+      split->back |= 1u << lane;
+      continue;
+    }
+    // put the crosspoint SURFACE_CLIP_EPSILON pixels on the near side
+    f32 idist;
+    i32 side;
+    f32 frac, frac2;
+    if (t1 < t2) {
+      idist = 1.0 / (t1 - t2);
+      side  = 1;
+      frac2 = (t1 + offset + SURFACE_CLIP_EPSILON) * idist;
+      frac  = (t1 - offset + SURFACE_CLIP_EPSILON) * idist;
+    } else if (t1 > t2) {
+      idist = 1.0 / (t1 - t2);
+      side  = 0;
+      frac2 = (t1 - offset - SURFACE_CLIP_EPSILON) * idist;
+      frac  = (t1 + offset + SURFACE_CLIP_EPSILON) * idist;
+    } else {
+      side  = 0;
+      frac  = 1;
+      frac2 = 0;
+    }
+    if (frac < 0) {
+      frac = 0;
+    } else if (frac > 1) {
+      frac = 1;
+    }
+    if (frac2 < 0) {
+      frac2 = 0;
+    } else if (frac2 > 1) {
+      frac2 = 1;
+    }
+    split->frac[lane]  = frac;
+    split->frac2[lane] = frac2;
+    split->near[side] |= 1u << lane;
+  }
+}
+
+#if defined SIMD_X86
+//..................
+// SSE4.1
+//   Each block is evaluated as two halves of 4 lanes
+//..................
+#  define SSE41 __attribute__((target("sse4.1")))
+
+//..................
+// CM_Dot_SSE
+//   Same as GVec3Dot, for 4 lanes: (x0 * y0 + x1 * y1) + x2 * y2
+//..................
+SSE41 static inline __m128 CM_Dot_SSE(__m128 x0, __m128 x1, __m128 x2, __m128 y0, __m128 y1, __m128 y2) {
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, y0), _mm_mul_ps(x1, y1)), _mm_mul_ps(x2, y2));
+}
+//..................
+// CM_DDot_SSE
+//   Same as DVec3Dot, for 2 lanes: each operand is widened to double before multiplying
+//..................
+SSE41 static inline __m128d CM_DDot_SSE(__m128d x0, __m128d x1, __m128d x2, __m128d y0, __m128d y1, __m128d y2) {
+  return _mm_add_pd(_mm_add_pd(_mm_mul_pd(x0, y0), _mm_mul_pd(x1, y1)), _mm_mul_pd(x2, y2));
+}
+//..................
+// CM_InFront_SSE
+//   Lanes where the trace is completely in front of the side: d1 > 0 && (d2 >= SURFACE_CLIP_EPSILON || d2 >= d1)
+//..................
+SSE41 static inline __m128 CM_InFront_SSE(__m128 d1, __m128 d2) {
+  __m128 out = _mm_or_ps(_mm_cmpge_ps(d2, _mm_set1_ps(SURFACE_CLIP_EPSILON)), _mm_cmpge_ps(d2, d1));
+  return _mm_and_ps(_mm_cmpgt_ps(d1, _mm_setzero_ps()), out);
+}
+
+//..................
+// CM_TraceSides_SSE41
+//..................
+SSE41 static bool CM_TraceSides_SSE41(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) {
+  __m128 min[3], max[3], start[3], end[3];
+  for (i32 axis = 0; axis < 3; axis++) {
+    min[axis]   = _mm_set1_ps(tw->size[0][axis]);
+    max[axis]   = _mm_set1_ps(tw->size[1][axis]);
+    start[axis] = _mm_set1_ps(tw->start[axis]);
+    end[axis]   = _mm_set1_ps(tw->end[axis]);
+  }
+  for (i32 first = 0; first < brush->numsides; first += 4) {
+    const cSideBlock* block = &brush->blocks[first / SIMD_LANES];
+    i32               id    = first % SIMD_LANES;
+    __m128            n[3], o[3];
+    for (i32 axis = 0; axis < 3; axis++) {
+      n[axis] = _mm_load_ps(&block->normal[axis][id]);
+      o[axis] = _mm_blendv_ps(min[axis], max[axis], _mm_load_ps((const f32*)&block->signs[axis][id]));
+    }
+    __m128 dist = _mm_sub_ps(_mm_load_ps(&block->dist[id]), CM_Dot_SSE(o[0], o[1], o[2], n[0], n[1], n[2]));
+    __m128 v1   = _mm_sub_ps(CM_Dot_SSE(start[0], start[1], start[2], n[0], n[1], n[2]), dist);
+    __m128 v2   = _mm_sub_ps(CM_Dot_SSE(end[0], end[1], end[2], n[0], n[1], n[2]), dist);
+    _mm_storeu_ps(d1 + first, v1);
+    _mm_storeu_ps(d2 + first, v2);
+    if (_mm_movemask_ps(CM_InFront_SSE(v1, v2))) { return false; }
+  }
+  return true;
+}
+
+//..................
+// CM_TraceSidesSphere_SSE41
+//..................
+SSE41 static bool CM_TraceSidesSphere_SSE41(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) {
+  __m128 offset[3], startSub[3], startAdd[3], endSub[3], endAdd[3];
+  for (i32 axis = 0; axis < 3; axis++) {
+    offset[axis]   = _mm_set1_ps(tw->sphere.offset[axis]);
+    startSub[axis] = _mm_set1_ps(tw->start[axis] - tw->sphere.offset[axis]);
+    startAdd[axis] = _mm_set1_ps(tw->start[axis] + tw->sphere.offset[axis]);
+    endSub[axis]   = _mm_set1_ps(tw->end[axis] - tw->sphere.offset[axis]);
+    endAdd[axis]   = _mm_set1_ps(tw->end[axis] + tw->sphere.offset[axis]);
+  }
+  __m128 radius = _mm_set1_ps(tw->sphere.radius);
+  for (i32 first = 0; first < brush->numsides; first += 4) {
+    const cSideBlock* block = &brush->blocks[first / SIMD_LANES];
+    i32               id    = first % SIMD_LANES;
+    __m128            n[3], startp[3], endp[3];
+    for (i32 axis = 0; axis < 3; axis++) { n[axis] = _mm_load_ps(&block->normal[axis][id]); }
+    __m128 sub = _mm_cmpgt_ps(CM_Dot_SSE(n[0], n[1], n[2], offset[0], offset[1], offset[2]), _mm_setzero_ps());
+    for (i32 axis = 0; axis < 3; axis++) {
+      startp[axis] = _mm_blendv_ps(startAdd[axis], startSub[axis], sub);
+      endp[axis]   = _mm_blendv_ps(endAdd[axis], endSub[axis], sub);
+    }
+    __m128 dist = _mm_add_ps(_mm_load_ps(&block->dist[id]), radius);
+    __m128 v1   = _mm_sub_ps(CM_Dot_SSE(startp[0], startp[1], startp[2], n[0], n[1], n[2]), dist);
+    __m128 v2   = _mm_sub_ps(CM_Dot_SSE(endp[0], endp[1], endp[2], n[0], n[1], n[2]), dist);
+    _mm_storeu_ps(d1 + first, v1);
+    _mm_storeu_ps(d2 + first, v2);
+    if (_mm_movemask_ps(CM_InFront_SSE(v1, v2))) { return false; }
+  }
+  return true;
+}
+
+//..................
+// CM_TraceSidesDists_SSE41
+//..................
+SSE41 static inline bool CM_TraceSidesDists_SSE41(const TraceWork* tw, const cBrush* brush, const f32* dists, i32 stride, f32* d1, f32* d2) {
+  __m128 start[3], end[3];
+  for (i32 axis = 0; axis < 3; axis++) {
+    start[axis] = _mm_set1_ps(tw->start[axis]);
+    end[axis]   = _mm_set1_ps(tw->end[axis]);
+  }
+  for (i32 first = 0; first < brush->numsides; first += 4) {
+    const cSideBlock* block = &brush->blocks[first / SIMD_LANES];
+    i32               id    = first % SIMD_LANES;
+    __m128            n[3];
+    for (i32 axis = 0; axis < 3; axis++) { n[axis] = _mm_load_ps(&block->normal[axis][id]); }
+    __m128 dist = _mm_load_ps(&dists[(first / SIMD_LANES) * stride + id]);
+    __m128 v1   = _mm_sub_ps(CM_Dot_SSE(start[0], start[1], start[2], n[0], n[1], n[2]), dist);
+    __m128 v2   = _mm_sub_ps(CM_Dot_SSE(end[0], end[1], end[2], n[0], n[1], n[2]), dist);
+    _mm_storeu_ps(d1 + first, v1);
+    _mm_storeu_ps(d2 + first, v2);
+    if (_mm_movemask_ps(CM_InFront_SSE(v1, v2))) { return false; }
+  }
+  return true;
+}
+
+//..................
+// CM_TraceSidesPoint_SSE41
+//..................
+SSE41 static bool CM_TraceSidesPoint_SSE41(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) {
+  return CM_TraceSidesDists_SSE41(tw, brush, brush->blocks->dist, SIDE_BLOCK_STRIDE, d1, d2);
+}
+
+//..................
+// CM_TestSides_SSE41
+//   The axial sides are masked out of the first block
+//..................
+SSE41 static bool CM_TestSides_SSE41(const TraceWork* tw, const cBrush* brush) {
+  __m128  min[3], max[3];
+  __m128d start[3];
+  for (i32 axis = 0; axis < 3; axis++) {
+    min[axis]   = _mm_set1_ps(tw->size[0][axis]);
+    max[axis]   = _mm_set1_ps(tw->size[1][axis]);
+    start[axis] = _mm_set1_pd(tw->start[axis]);
+  }
+  for (i32 first = 4; first < brush->numsides; first += 4) {
+    const cSideBlock* block = &brush->blocks[first / SIMD_LANES];
+    i32               id    = first % SIMD_LANES;
+    __m128            n[3], o[3];
+    for (i32 axis = 0; axis < 3; axis++) {
+      n[axis] = _mm_load_ps(&block->normal[axis][id]);
+      o[axis] = _mm_blendv_ps(min[axis], max[axis], _mm_load_ps((const f32*)&block->signs[axis][id]));
+    }
+    __m128 dist = _mm_sub_ps(_mm_load_ps(&block->dist[id]), CM_Dot_SSE(o[0], o[1], o[2], n[0], n[1], n[2]));
+    // widen to double, two lanes at a time
+    i32 mask    = 0;
+    for (i32 half = 0; half < 2; half++) {
+      __m128d nd[3];
+      for (i32 axis = 0; axis < 3; axis++) { nd[axis] = _mm_cvtps_pd(half ? _mm_movehl_ps(n[axis], n[axis]) : n[axis]); }
+      __m128d distd = _mm_cvtps_pd(half ? _mm_movehl_ps(dist, dist) : dist);
+      __m128d v1    = _mm_sub_pd(CM_DDot_SSE(start[0], start[1], start[2], nd[0], nd[1], nd[2]), distd);
+      mask |= _mm_movemask_pd(_mm_cmpgt_pd(v1, _mm_setzero_pd())) << (half * 2);
+    }
+    if (first == 4) { mask &= ~3; }  // sides 4 and 5 are axial
+    if (mask) { return true; }
+  }
+  return false;
+}
+
+//..................
+// CM_TestSidesSphere_SSE41
+//..................
+SSE41 static bool CM_TestSidesSphere_SSE41(const TraceWork* tw, const cBrush* brush) {
+  __m128d offset[3];
+  __m128  startSub[3], startAdd[3];
+  for (i32 axis = 0; axis < 3; axis++) {
+    offset[axis]   = _mm_set1_pd(tw->sphere.offset[axis]);
+    startSub[axis] = _mm_set1_ps(tw->start[axis] - tw->sphere.offset[axis]);
+    startAdd[axis] = _mm_set1_ps(tw->start[axis] + tw->sphere.offset[axis]);
+  }
+  __m128 radius = _mm_set1_ps(tw->sphere.radius);
+  for (i32 first = 4; first < brush->numsides; first += 4) {
+    const cSideBlock* block = &brush->blocks[first / SIMD_LANES];
+    i32               id    = first % SIMD_LANES;
+    __m128            n[3];
+    for (i32 axis = 0; axis < 3; axis++) { n[axis] = _mm_load_ps(&block->normal[axis][id]); }
+    __m128 dist = _mm_add_ps(_mm_load_ps(&block->dist[id]), radius);
+    i32    mask = 0;
+    for (i32 half = 0; half < 2; half++) {
+      __m128d nd[3], startp[3];
+      for (i32 axis = 0; axis < 3; axis++) { nd[axis] = _mm_cvtps_pd(half ? _mm_movehl_ps(n[axis], n[axis]) : n[axis]); }
+      __m128d sub = _mm_cmpgt_pd(CM_DDot_SSE(nd[0], nd[1], nd[2], offset[0], offset[1], offset[2]), _mm_setzero_pd());
+      for (i32 axis = 0; axis < 3; axis++) { startp[axis] = _mm_blendv_pd(_mm_cvtps_pd(startAdd[axis]), _mm_cvtps_pd(startSub[axis]), sub); }
+      __m128d distd = _mm_cvtps_pd(half ? _mm_movehl_ps(dist, dist) : dist);
+      __m128d v1    = _mm_sub_pd(CM_DDot_SSE(startp[0], startp[1], startp[2], nd[0], nd[1], nd[2]), distd);
+      mask |= _mm_movemask_pd(_mm_cmpgt_pd(v1, _mm_setzero_pd())) << (half * 2);
+    }
+    if (first == 4) { mask &= ~3; }  // sides 4 and 5 are axial
+    if (mask) { return true; }
+  }
+  return false;
+}
+
+//..................
+// CM_Clamp01_SSE
+//   Same as the [0..1] clamping of the crosspoint fractions in CM_TraceThroughTree. Keeps the sign of zeros
+//..................
+SSE41 static inline __m128 CM_Clamp01_SSE(__m128 frac) {
+  frac = _mm_blendv_ps(frac, _mm_setzero_ps(), _mm_cmplt_ps(frac, _mm_setzero_ps()));
+  return _mm_blendv_ps(frac, _mm_set1_ps(1), _mm_cmpgt_ps(frac, _mm_set1_ps(1)));
+}
+//..................
+// CM_CrossFracs_SSE
+//   Crosspoint fractions of 2 lanes, computed in double and rounded to float like CM_TraceThroughTree
+//   Returns (t1 + SURFACE_CLIP_EPSILON) * idist in the low half, and (t1 - SURFACE_CLIP_EPSILON) * idist in the high half
+//..................
+SSE41 static inline __m128 CM_CrossFracs_SSE(__m128 t1, __m128 t2) {
+  __m128d t1d   = _mm_cvtps_pd(t1);
+  __m128d idist = _mm_cvtps_pd(_mm_cvtpd_ps(_mm_div_pd(_mm_set1_pd(1.0), _mm_sub_pd(t1d, _mm_cvtps_pd(t2)))));
+  __m128  add   = _mm_cvtpd_ps(_mm_mul_pd(_mm_add_pd(t1d, _mm_set1_pd(SURFACE_CLIP_EPSILON)), idist));
+  __m128  sub   = _mm_cvtpd_ps(_mm_mul_pd(_mm_sub_pd(t1d, _mm_set1_pd(SURFACE_CLIP_EPSILON)), idist));
+  return _mm_movelh_ps(add, sub);
+}
+
+//..................
+// CM_PlaneSides_SSE41
+//..................
+SSE41 static void CM_PlaneSides_SSE41(const cPlane* plane, const RaySegments* seg, u32 mask, PacketSplit* split) {
+  __m128 dist = _mm_set1_ps(plane->dist);
+  __m128 n[3];
+  for (i32 axis = 0; axis < 3; axis++) { n[axis] = _mm_set1_ps(plane->normal[axis]); }
+  memset(split, 0, 4 * sizeof(u32));
+  for (i32 first = 0; first < MAX_PACKET_RAYS; first += 4) {
+    if (!((mask >> first) & 0xF)) { continue; }
+    __m128 t1, t2;
+    if (plane->type < 3) {
+      t1 = _mm_sub_ps(_mm_loadu_ps(&seg->p1[plane->type][first]), dist);
+      t2 = _mm_sub_ps(_mm_loadu_ps(&seg->p2[plane->type][first]), dist);
+    } else {
+      t1 = _mm_sub_ps(CM_Dot_SSE(n[0], n[1], n[2], _mm_loadu_ps(&seg->p1[0][first]), _mm_loadu_ps(&seg->p1[1][first]), _mm_loadu_ps(&seg->p1[2][first])), dist);
+      t2 = _mm_sub_ps(CM_Dot_SSE(n[0], n[1], n[2], _mm_loadu_ps(&seg->p2[0][first]), _mm_loadu_ps(&seg->p2[1][first]), _mm_loadu_ps(&seg->p2[2][first])), dist);
+    }
+    __m128 front = _mm_and_ps(_mm_cmpge_ps(t1, _mm_set1_ps(1)), _mm_cmpge_ps(t2, _mm_set1_ps(1)));
+    __m128 back  = _mm_and_ps(_mm_cmplt_ps(t1, _mm_set1_ps(-1)), _mm_cmplt_ps(t2, _mm_set1_ps(-1)));
+    __m128 lt    = _mm_cmplt_ps(t1, t2);
+    __m128 eq    = _mm_cmpeq_ps(t1, t2);
+    u32    cross = (u32)(~_mm_movemask_ps(_mm_or_ps(front, back)) & 0xF) << first;
+    split->front |= (u32)_mm_movemask_ps(front) << first;
+    split->back |= (u32)_mm_movemask_ps(back) << first;
+    split->near[1] |= (u32)_mm_movemask_ps(lt) << first & cross;
+    split->near[0] |= ~((u32)_mm_movemask_ps(lt) << first) & cross;
+    if (!(cross & mask)) { continue; }
+    __m128 lo    = CM_CrossFracs_SSE(t1, t2);
+    __m128 hi    = CM_CrossFracs_SSE(_mm_movehl_ps(t1, t1), _mm_movehl_ps(t2, t2));
+    __m128 add   = _mm_movelh_ps(lo, hi);
+    __m128 sub   = _mm_movehl_ps(hi, lo);
+    __m128 frac  = _mm_blendv_ps(add, _mm_set1_ps(1), eq);
+    __m128 frac2 = _mm_blendv_ps(_mm_blendv_ps(sub, add, lt), _mm_setzero_ps(), eq);
+    _mm_storeu_ps(&split->frac[first], CM_Clamp01_SSE(frac));
+    _mm_storeu_ps(&split->frac2[first], CM_Clamp01_SSE(frac2));
+  }
+  split->front &= mask;
+  split->back &= mask;
+  split->near[0] &= mask;
+  split->near[1] &= mask;
+}
+
+//..................
+// CM_LeafBrushes_SSE41
+//..................
+SSE41 static u32 CM_LeafBrushes_SSE41(const TraceWork* tw, const cBrushBlock* block) {
+  __m128  min[3], max[3];
+  __m128i contents = _mm_set1_epi32(tw->contents);
+  for (i32 axis = 0; axis < 3; axis++) {
+    min[axis] = _mm_set1_ps(tw->bounds[0][axis]);
+    max[axis] = _mm_set1_ps(tw->bounds[1][axis]);
+  }
+  u32 hits = 0;
+  for (i32 first = 0; first < SIMD_LANES; first += 4) {
+    __m128 miss = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_load_si128((const __m128i*)&block->contents[first]), contents), _mm_setzero_si128()));
+    for (i32 axis = 0; axis < 3; axis++) {
+      miss = _mm_or_ps(miss, _mm_cmplt_ps(max[axis], _mm_load_ps(&block->mins[axis][first])));
+      miss = _mm_or_ps(miss, _mm_cmpgt_ps(min[axis], _mm_load_ps(&block->maxs[axis][first])));
+    }
+    hits |= (u32)(~_mm_movemask_ps(miss) & 0xF) << first;
+  }
+  return hits;
+}
+
+//..................
+// CM_PatchFacets_SSE41
+//..................
+SSE41 static u32 CM_PatchFacets_SSE41(const TraceWork* tw, const cSideBlock* block) {
+  bool   sphere = tw->sphere.use && !tw->isPoint;
+  __m128 min[3], max[3], offset[3], startSub[3], startAdd[3], endSub[3], endAdd[3];
+  for (i32 axis = 0; axis < 3; axis++) {
+    min[axis]      = _mm_set1_ps(tw->size[0][axis]);
+    max[axis]      = _mm_set1_ps(tw->size[1][axis]);
+    offset[axis]   = _mm_set1_ps(tw->sphere.offset[axis]);
+    startSub[axis] = _mm_set1_ps(sphere ? tw->start[axis] - tw->sphere.offset[axis] : tw->start[axis]);
+    startAdd[axis] = _mm_set1_ps(sphere ? tw->start[axis] + tw->sphere.offset[axis] : tw->start[axis]);
+    endSub[axis]   = _mm_set1_ps(sphere ? tw->end[axis] - tw->sphere.offset[axis] : tw->end[axis]);
+    endAdd[axis]   = _mm_set1_ps(sphere ? tw->end[axis] + tw->sphere.offset[axis] : tw->end[axis]);
+  }
+  u32 hits = 0;
+  for (i32 first = 0; first < SIMD_LANES; first += 4) {
+    __m128 n[3], startp[3], endp[3], dist;
+    for (i32 axis = 0; axis < 3; axis++) { n[axis] = _mm_load_ps(&block->normal[axis][first]); }
+    if (sphere) {
+      __m128 sub = _mm_cmpgt_ps(CM_Dot_SSE(n[0], n[1], n[2], offset[0], offset[1], offset[2]), _mm_setzero_ps());
+      for (i32 axis = 0; axis < 3; axis++) {
+        startp[axis] = _mm_blendv_ps(startAdd[axis], startSub[axis], sub);
+        endp[axis]   = _mm_blendv_ps(endAdd[axis], endSub[axis], sub);
+      }
+      dist = _mm_add_ps(_mm_load_ps(&block->dist[first]), _mm_set1_ps(tw->sphere.radius));
+    } else {
+      __m128 o[3];
+      for (i32 axis = 0; axis < 3; axis++) {
+        o[axis]      = _mm_blendv_ps(min[axis], max[axis], _mm_load_ps((const f32*)&block->signs[axis][first]));
+        startp[axis] = startSub[axis];
+        endp[axis]   = endSub[axis];
+      }
+      dist = _mm_sub_ps(_mm_load_ps(&block->dist[first]), CM_Dot_SSE(o[0], o[1], o[2], n[0], n[1], n[2]));
+    }
+    __m128 d1 = _mm_sub_ps(CM_Dot_SSE(startp[0], startp[1], startp[2], n[0], n[1], n[2]), dist);
+    __m128 d2 = _mm_sub_ps(CM_Dot_SSE(endp[0], endp[1], endp[2], n[0], n[1], n[2]), dist);
+    i32    mask;
+    if (tw->isPoint) {
+      __m128 enter = _mm_and_ps(_mm_cmpgt_ps(d1, _mm_setzero_ps()), _mm_cmplt_ps(d2, d1));
+      __m128 frac  = _mm_div_ps(d1, _mm_sub_ps(d1, d2));
+      mask         = _mm_movemask_ps(_mm_and_ps(enter, _mm_cmple_ps(frac, _mm_set1_ps(tw->trace.fraction))));
+    } else {
+      mask = ~_mm_movemask_ps(CM_InFront_SSE(d1, d2)) & 0xF;
+    }
+    hits |= (u32)mask << first;
+  }
+  return hits;
+}
+
+//..................
+// AVX2
+//   One block per iteration
+//..................
+#  define AVX2 __attribute__((target("avx2")))
+
+//..................
+// CM_Dot_AVX
+//   Same as GVec3Dot, for 8 lanes
+//..................
+AVX2 static inline __m256 CM_Dot_AVX(__m256 x0, __m256 x1, __m256 x2, __m256 y0, __m256 y1, __m256 y2) {
+  return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x0, y0), _mm256_mul_ps(x1, y1)), _mm256_mul_ps(x2, y2));
+}
+//..................
+// CM_DDot_AVX
+//   Same as DVec3Dot, for 4 lanes
+//..................
+AVX2 static inline __m256d CM_DDot_AVX(__m256d x0, __m256d x1, __m256d x2, __m256d y0, __m256d y1, __m256d y2) {
+  return _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x0, y0), _mm256_mul_pd(x1, y1)), _mm256_mul_pd(x2, y2));
+}
+//..................
+// CM_InFront_AVX
+//   Same as CM_InFront_SSE, for 8 lanes
+//..................
+AVX2 static inline __m256 CM_InFront_AVX(__m256 d1, __m256 d2) {
+  __m256 out = _mm256_or_ps(_mm256_cmp_ps(d2, _mm256_set1_ps(SURFACE_CLIP_EPSILON), _CMP_GE_OQ), _mm256_cmp_ps(d2, d1, _CMP_GE_OQ));
+  return _mm256_and_ps(_mm256_cmp_ps(d1, _mm256_setzero_ps(), _CMP_GT_OQ), out);
+}
+
+//..................
+// CM_TraceSides_AVX2
+//..................
+AVX2 static bool CM_TraceSides_AVX2(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) {
+  __m256 min[3], max[3], start[3], end[3];
+  for (i32 axis = 0; axis < 3; axis++) {
+    min[axis]   = _mm256_set1_ps(tw->size[0][axis]);
+    max[axis]   = _mm256_set1_ps(tw->size[1][axis]);
+    start[axis] = _mm256_set1_ps(tw->start[axis]);
+    end[axis]   = _mm256_set1_ps(tw->end[axis]);
+  }
+  for (i32 first = 0; first < brush->numsides; first += SIMD_LANES) {
+    const cSideBlock* block = &brush->blocks[first / SIMD_LANES];
+    __m256            n[3], o[3];
+    for (i32 axis = 0; axis < 3; axis++) {
+      n[axis] = _mm256_load_ps(block->normal[axis]);
+      o[axis] = _mm256_blendv_ps(min[axis], max[axis], _mm256_load_ps((const f32*)block->signs[axis]));
+    }
+    __m256 dist = _mm256_sub_ps(_mm256_load_ps(block->dist), CM_Dot_AVX(o[0], o[1], o[2], n[0], n[1], n[2]));
+    __m256 v1   = _mm256_sub_ps(CM_Dot_AVX(start[0], start[1], start[2], n[0], n[1], n[2]), dist);
+    __m256 v2   = _mm256_sub_ps(CM_Dot_AVX(end[0], end[1], end[2], n[0], n[1], n[2]), dist);
+    _mm256_storeu_ps(d1 + first, v1);
+    _mm256_storeu_ps(d2 + first, v2);
+    if (_mm256_movemask_ps(CM_InFront_AVX(v1, v2))) { return false; }
+  }
+  return true;
+}
+
+//..................
+// CM_TraceSidesSphere_AVX2
+//..................
+AVX2 static bool CM_TraceSidesSphere_AVX2(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) {
+  __m256 offset[3], startSub[3], startAdd[3], endSub[3], endAdd[3];
+  for (i32 axis = 0; axis < 3; axis++) {
+    offset[axis]   = _mm256_set1_ps(tw->sphere.offset[axis]);
+    startSub[axis] = _mm256_set1_ps(tw->start[axis] - tw->sphere.offset[axis]);
+    startAdd[axis] = _mm256_set1_ps(tw->start[axis] + tw->sphere.offset[axis]);
+    endSub[axis]   = _mm256_set1_ps(tw->end[axis] - tw->sphere.offset[axis]);
+    endAdd[axis]   = _mm256_set1_ps(tw->end[axis] + tw->sphere.offset[axis]);
+  }
+  __m256 radius = _mm256_set1_ps(tw->sphere.radius);
+  for (i32 first = 0; first < brush->numsides; first += SIMD_LANES) {
+    const cSideBlock* block = &brush->blocks[first / SIMD_LANES];
+    __m256            n[3], startp[3], endp[3];
+    for (i32 axis = 0; axis < 3; axis++) { n[axis] = _mm256_load_ps(block->normal[axis]); }
+    __m256 sub = _mm256_cmp_ps(CM_Dot_AVX(n[0], n[1], n[2], offset[0], offset[1], offset[2]), _mm256_setzero_ps(), _CMP_GT_OQ);
+    for (i32 axis = 0; axis < 3; axis++) {
+      startp[axis] = _mm256_blendv_ps(startAdd[axis], startSub[axis], sub);
+      endp[axis]   = _mm256_blendv_ps(endAdd[axis], endSub[axis], sub);
+    }
+    __m256 dist = _mm256_add_ps(_mm256_load_ps(block->dist), radius);
+    __m256 v1   = _mm256_sub_ps(CM_Dot_AVX(startp[0], startp[1], startp[2], n[0], n[1], n[2]), dist);
+    __m256 v2   = _mm256_sub_ps(CM_Dot_AVX(endp[0], endp[1], endp[2], n[0], n[1], n[2]), dist);
+    _mm256_storeu_ps(d1 + first, v1);
+    _mm256_storeu_ps(d2 + first, v2);
+    if (_mm256_movemask_ps(CM_InFront_AVX(v1, v2))) { return false; }
+  }
+  return true;
+}
+
+//..................
+// CM_TraceSidesDists_AVX2
+//..................
+AVX2 static inline bool CM_TraceSidesDists_AVX2(const TraceWork* tw, const cBrush* brush, const f32* dists, i32 stride, f32* d1, f32* d2) {
+  __m256 start[3], end[3];
+  for (i32 axis = 0; axis < 3; axis++) {
+    start[axis] = _mm256_set1_ps(tw->start[axis]);
+    end[axis]   = _mm256_set1_ps(tw->end[axis]);
+  }
+  for (i32 first = 0; first < brush->numsides; first += SIMD_LANES) {
+    const cSideBlock* block = &brush->blocks[first / SIMD_LANES];
+    __m256            n[3];
+    for (i32 axis = 0; axis < 3; axis++) { n[axis] = _mm256_load_ps(block->normal[axis]); }
+    __m256 dist = _mm256_load_ps(&dists[(first / SIMD_LANES) * stride]);
+    __m256 v1   = _mm256_sub_ps(CM_Dot_AVX(start[0], start[1], start[2], n[0], n[1], n[2]), dist);
+    __m256 v2   = _mm256_sub_ps(CM_Dot_AVX(end[0], end[1], end[2], n[0], n[1], n[2]), dist);
+    _mm256_storeu_ps(d1 + first, v1);
+    _mm256_storeu_ps(d2 + first, v2);
+    if (_mm256_movemask_ps(CM_InFront_AVX(v1, v2))) { return false; }
+  }
+  return true;
+}
+
+//..................
+// CM_TraceSidesPoint_AVX2
+//..................
+AVX2 static bool CM_TraceSidesPoint_AVX2(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) {
+  return CM_TraceSidesDists_AVX2(tw, brush, brush->blocks->dist, SIDE_BLOCK_STRIDE, d1, d2);
+}
+
+//..................
+// CM_TestSides_AVX2
+//   The axial sides are masked out of the first block
+//..................
+AVX2 static bool CM_TestSides_AVX2(const TraceWork* tw, const cBrush* brush) {
+  __m256  min[3], max[3];
+  __m256d start[3];
+  for (i32 axis = 0; axis < 3; axis++) {
+    min[axis]   = _mm256_set1_ps(tw->size[0][axis]);
+    max[axis]   = _mm256_set1_ps(tw->size[1][axis]);
+    start[axis] = _mm256_set1_pd(tw->start[axis]);
+  }
+  for (i32 first = 0; first < brush->numsides; first += SIMD_LANES) {
+    const cSideBlock* block = &brush->blocks[first / SIMD_LANES];
+    __m256            n[3], o[3];
+    for (i32 axis = 0; axis < 3; axis++) {
+      n[axis] = _mm256_load_ps(block->normal[axis]);
+      o[axis] = _mm256_blendv_ps(min[axis], max[axis], _mm256_load_ps((const f32*)block->signs[axis]));
+    }
+    __m256 dist = _mm256_sub_ps(_mm256_load_ps(block->dist), CM_Dot_AVX(o[0], o[1], o[2], n[0], n[1], n[2]));
+    // widen to double, four lanes at a time
+    i32    mask = 0;
+    for (i32 half = 0; half < 2; half++) {
+      __m256d nd[3];
+      for (i32 axis = 0; axis < 3; axis++) { nd[axis] = _mm256_cvtps_pd(half ? _mm256_extractf128_ps(n[axis], 1) : _mm256_castps256_ps128(n[axis])); }
+      __m256d distd = _mm256_cvtps_pd(half ? _mm256_extractf128_ps(dist, 1) : _mm256_castps256_ps128(dist));
+      __m256d v1    = _mm256_sub_pd(CM_DDot_AVX(start[0], start[1], start[2], nd[0], nd[1], nd[2]), distd);
+      mask |= _mm256_movemask_pd(_mm256_cmp_pd(v1, _mm256_setzero_pd(), _CMP_GT_OQ)) << (half * 4);
+    }
+    if (!first) { mask &= ~0x3F; }  // the first six sides are axial
+    if (mask) { return true; }
+  }
+  return false;
+}
+
+//..................
+// CM_TestSidesSphere_AVX2
+//..................
+AVX2 static bool CM_TestSidesSphere_AVX2(const TraceWork* tw, const cBrush* brush) {
+  __m256d offset[3], startSub[3], startAdd[3];
+  for (i32 axis = 0; axis < 3; axis++) {
+    offset[axis]   = _mm256_set1_pd(tw->sphere.offset[axis]);
+    startSub[axis] = _mm256_set1_pd((f32)(tw->start[axis] - tw->sphere.offset[axis]));
+    startAdd[axis] = _mm256_set1_pd((f32)(tw->start[axis] + tw->sphere.offset[axis]));
+  }
+  __m256 radius = _mm256_set1_ps(tw->sphere.radius);
+  for (i32 first = 0; first < brush->numsides; first += SIMD_LANES) {
+    const cSideBlock* block = &brush->blocks[first / SIMD_LANES];
+    __m256            n[3];
+    for (i32 axis = 0; axis < 3; axis++) { n[axis] = _mm256_load_ps(block->normal[axis]); }
+    __m256 dist = _mm256_add_ps(_mm256_load_ps(block->dist), radius);
+    i32    mask = 0;
+    for (i32 half = 0; half < 2; half++) {
+      __m256d nd[3], startp[3];
+      for (i32 axis = 0; axis < 3; axis++) { nd[axis] = _mm256_cvtps_pd(half ? _mm256_extractf128_ps(n[axis], 1) : _mm256_castps256_ps128(n[axis])); }
+      __m256d sub = _mm256_cmp_pd(CM_DDot_AVX(nd[0], nd[1], nd[2], offset[0], offset[1], offset[2]), _mm256_setzero_pd(), _CMP_GT_OQ);
+      for (i32 axis = 0; axis < 3; axis++) { startp[axis] = _mm256_blendv_pd(startAdd[axis], startSub[axis], sub); }
+      __m256d distd = _mm256_cvtps_pd(half ? _mm256_extractf128_ps(dist, 1) : _mm256_castps256_ps128(dist));
+      __m256d v1    = _mm256_sub_pd(CM_DDot_AVX(startp[0], startp[1], startp[2], nd[0], nd[1], nd[2]), distd);
+      mask |= _mm256_movemask_pd(_mm256_cmp_pd(v1, _mm256_setzero_pd(), _CMP_GT_OQ)) << (half * 4);
+    }
+    if (!first) { mask &= ~0x3F; }  // the first six sides are axial
+    if (mask) { return true; }
+  }
+  return false;
+}
+
+//..................
+// CM_LeafBrushes_AVX2
+//..................
+AVX2 static u32 CM_LeafBrushes_AVX2(const TraceWork* tw, const cBrushBlock* block) {
+  __m256i contents = _mm256_and_si256(_mm256_load_si256((const __m256i*)block->contents), _mm256_set1_epi32(tw->contents));
+  __m256  miss     = _mm256_castsi256_ps(_mm256_cmpeq_epi32(contents, _mm256_setzero_si256()));
+  for (i32 axis = 0; axis < 3; axis++) {
+    miss = _mm256_or_ps(miss, _mm256_cmp_ps(_mm256_set1_ps(tw->bounds[1][axis]), _mm256_load_ps(block->mins[axis]), _CMP_LT_OQ));
+    miss = _mm256_or_ps(miss, _mm256_cmp_ps(_mm256_set1_ps(tw->bounds[0][axis]), _mm256_load_ps(block->maxs[axis]), _CMP_GT_OQ));
+  }
+  return ~_mm256_movemask_ps(miss) & 0xFF;
+}
+
+//..................
+// CM_PatchFacets_AVX2
+//..................
+AVX2 static u32 CM_PatchFacets_AVX2(const TraceWork* tw, const cSideBlock* block) {
+  __m256 n[3], startp[3], endp[3], dist;
+  for (i32 axis = 0; axis < 3; axis++) { n[axis] = _mm256_load_ps(block->normal[axis]); }
+  if (tw->sphere.use && !tw->isPoint) {
+    __m256 offset[3];
+    for (i32 axis = 0; axis < 3; axis++) { offset[axis] = _mm256_set1_ps(tw->sphere.offset[axis]); }
+    __m256 sub = _mm256_cmp_ps(CM_Dot_AVX(n[0], n[1], n[2], offset[0], offset[1], offset[2]), _mm256_setzero_ps(), _CMP_GT_OQ);
+    for (i32 axis = 0; axis < 3; axis++) {
+      startp[axis] = _mm256_blendv_ps(_mm256_set1_ps(tw->start[axis] + tw->sphere.offset[axis]), _mm256_set1_ps(tw->start[axis] - tw->sphere.offset[axis]), sub);
+      endp[axis]   = _mm256_blendv_ps(_mm256_set1_ps(tw->end[axis] + tw->sphere.offset[axis]), _mm256_set1_ps(tw->end[axis] - tw->sphere.offset[axis]), sub);
+    }
+    dist = _mm256_add_ps(_mm256_load_ps(block->dist), _mm256_set1_ps(tw->sphere.radius));
+  } else {
+    __m256 o[3];
+    for (i32 axis = 0; axis < 3; axis++) {
+      o[axis]      = _mm256_blendv_ps(_mm256_set1_ps(tw->size[0][axis]), _mm256_set1_ps(tw->size[1][axis]), _mm256_load_ps((const f32*)block->signs[axis]));
+      startp[axis] = _mm256_set1_ps(tw->start[axis]);
+      endp[axis]   = _mm256_set1_ps(tw->end[axis]);
+    }
+    dist = _mm256_sub_ps(_mm256_load_ps(block->dist), CM_Dot_AVX(o[0], o[1], o[2], n[0], n[1], n[2]));
+  }
+  __m256 d1 = _mm256_sub_ps(CM_Dot_AVX(startp[0], startp[1], startp[2], n[0], n[1], n[2]), dist);
+  __m256 d2 = _mm256_sub_ps(CM_Dot_AVX(endp[0], endp[1], endp[2], n[0], n[1], n[2]), dist);
+  if (tw->isPoint) {
+    __m256 enter = _mm256_and_ps(_mm256_cmp_ps(d1, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_cmp_ps(d2, d1, _CMP_LT_OQ));
+    __m256 frac  = _mm256_div_ps(d1, _mm256_sub_ps(d1, d2));
+    return _mm256_movemask_ps(_mm256_and_ps(enter, _mm256_cmp_ps(frac, _mm256_set1_ps(tw->trace.fraction), _CMP_LE_OQ)));
+  }
+  return ~_mm256_movemask_ps(CM_InFront_AVX(d1, d2)) & 0xFF;
+}
+
+//..................
+// CM_Clamp01_AVX
+//   Same as CM_Clamp01_SSE, for 8 lanes
+//..................
+AVX2 static inline __m256 CM_Clamp01_AVX(__m256 frac) {
+  frac = _mm256_blendv_ps(frac, _mm256_setzero_ps(), _mm256_cmp_ps(frac, _mm256_setzero_ps(), _CMP_LT_OQ));
+  return _mm256_blendv_ps(frac, _mm256_set1_ps(1), _mm256_cmp_ps(frac, _mm256_set1_ps(1), _CMP_GT_OQ));
+}
+//..................
+// CM_CrossFracs_AVX
+//   Same as CM_CrossFracs_SSE, for 4 lanes. Stores the two fractions in *add and *sub
+//..................
+AVX2 static inline void CM_CrossFracs_AVX(__m128 t1, __m128 t2, __m128* add, __m128* sub) {
+  __m256d t1d   = _mm256_cvtps_pd(t1);
+  __m256d idist = _mm256_cvtps_pd(_mm256_cvtpd_ps(_mm256_div_pd(_mm256_set1_pd(1.0), _mm256_sub_pd(t1d, _mm256_cvtps_pd(t2)))));
+  *add          = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_add_pd(t1d, _mm256_set1_pd(SURFACE_CLIP_EPSILON)), idist));
+  *sub          = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_sub_pd(t1d, _mm256_set1_pd(SURFACE_CLIP_EPSILON)), idist));
+}
+
+//..................
+// CM_PlaneSides_AVX2
+//..................
+AVX2 static void CM_PlaneSides_AVX2(const cPlane* plane, const RaySegments* seg, u32 mask, PacketSplit* split) {
+  __m256 dist = _mm256_set1_ps(plane->dist);
+  __m256 n[3];
+  for (i32 axis = 0; axis < 3; axis++) { n[axis] = _mm256_set1_ps(plane->normal[axis]); }
+  memset(split, 0, 4 * sizeof(u32));
+  for (i32 first = 0; first < MAX_PACKET_RAYS; first += 8) {
+    if (!((mask >> first) & 0xFF)) { continue; }
+    __m256 t1, t2;
+    if (plane->type < 3) {
+      t1 = _mm256_sub_ps(_mm256_loadu_ps(&seg->p1[plane->type][first]), dist);
+      t2 = _mm256_sub_ps(_mm256_loadu_ps(&seg->p2[plane->type][first]), dist);
+    } else {
+      t1 = _mm256_sub_ps(
+        CM_Dot_AVX(n[0], n[1], n[2], _mm256_loadu_ps(&seg->p1[0][first]), _mm256_loadu_ps(&seg->p1[1][first]), _mm256_loadu_ps(&seg->p1[2][first])), dist);
+      t2 = _mm256_sub_ps(
+        CM_Dot_AVX(n[0], n[1], n[2], _mm256_loadu_ps(&seg->p2[0][first]), _mm256_loadu_ps(&seg->p2[1][first]), _mm256_loadu_ps(&seg->p2[2][first])), dist);
+    }
+    __m256 front = _mm256_and_ps(_mm256_cmp_ps(t1, _mm256_set1_ps(1), _CMP_GE_OQ), _mm256_cmp_ps(t2, _mm256_set1_ps(1), _CMP_GE_OQ));
+    __m256 back  = _mm256_and_ps(_mm256_cmp_ps(t1, _mm256_set1_ps(-1), _CMP_LT_OQ), _mm256_cmp_ps(t2, _mm256_set1_ps(-1), _CMP_LT_OQ));
+    __m256 lt    = _mm256_cmp_ps(t1, t2, _CMP_LT_OQ);
+    __m256 eq    = _mm256_cmp_ps(t1, t2, _CMP_EQ_OQ);
+    u32    cross = (u32)(~_mm256_movemask_ps(_mm256_or_ps(front, back)) & 0xFF) << first;
+    split->front |= (u32)_mm256_movemask_ps(front) << first;
+    split->back |= (u32)_mm256_movemask_ps(back) << first;
+    split->near[1] |= (u32)_mm256_movemask_ps(lt) << first & cross;
+    split->near[0] |= ~((u32)_mm256_movemask_ps(lt) << first) & cross;
+    if (!(cross & mask)) { continue; }
+    __m128 addLo, subLo, addHi, subHi;
+    CM_CrossFracs_AVX(_mm256_castps256_ps128(t1), _mm256_castps256_ps128(t2), &addLo, &subLo);
+    CM_CrossFracs_AVX(_mm256_extractf128_ps(t1, 1), _mm256_extractf128_ps(t2, 1), &addHi, &subHi);
+    __m256 add   = _mm256_insertf128_ps(_mm256_castps128_ps256(addLo), addHi, 1);
+    __m256 sub   = _mm256_insertf128_ps(_mm256_castps128_ps256(subLo), subHi, 1);
+    __m256 frac  = _mm256_blendv_ps(add, _mm256_set1_ps(1), eq);
+    __m256 frac2 = _mm256_blendv_ps(_mm256_blendv_ps(sub, add, lt), _mm256_setzero_ps(), eq);
+    _mm256_storeu_ps(&split->frac[first], CM_Clamp01_AVX(frac));
+    _mm256_storeu_ps(&split->frac2[first], CM_Clamp01_AVX(frac2));
+  }
+  split->front &= mask;
+  split->back &= mask;
+  split->near[0] &= mask;
+  split->near[1] &= mask;
+}
+#endif  // SIMD_X86
+
+
+//..................
+// CM_InitSideKernels
+//   Selects the best brush side kernels supported by the cpu
+//..................
+void CM_InitSideKernels(void) {
+  const char* name = "scalar";
+  traceSides       = CM_TraceSides_Scalar;
+  traceSidesSphere = CM_TraceSidesSphere_Scalar;
+  traceSidesPoint  = CM_TraceSidesPoint_Scalar;
+  testSides        = CM_TestSides_Scalar;
+  testSidesSphere  = CM_TestSidesSphere_Scalar;
+  planeSides       = CM_PlaneSides_Scalar;
+  leafBrushes      = CM_LeafBrushes_Scalar;
+  patchFacets      = CM_PatchFacets_Scalar;
+#if defined SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    name             = "avx2";
+    traceSides       = CM_TraceSides_AVX2;
+    traceSidesSphere = CM_TraceSidesSphere_AVX2;
+    traceSidesPoint  = CM_TraceSidesPoint_AVX2;
+    testSides        = CM_TestSides_AVX2;
+    testSidesSphere  = CM_TestSidesSphere_AVX2;
+    planeSides       = CM_PlaneSides_AVX2;
+    leafBrushes      = CM_LeafBrushes_AVX2;
+    patchFacets      = CM_PatchFacets_AVX2;
+  } else if (__builtin_cpu_supports("sse4.1")) {
+    name             = "sse4.1";
+    traceSides       = CM_TraceSides_SSE41;
+    traceSidesSphere = CM_TraceSidesSphere_SSE41;
+    traceSidesPoint  = CM_TraceSidesPoint_SSE41;
+    testSides        = CM_TestSides_SSE41;
+    testSidesSphere  = CM_TestSidesSphere_SSE41;
+    planeSides       = CM_PlaneSides_SSE41;
+    leafBrushes      = CM_LeafBrushes_SSE41;
+    patchFacets      = CM_PatchFacets_SSE41;
+  }
+#endif
+  if (load.developer) { echo("%s: using %s brush side kernels", __func__, name); }
+}
+
+//..................
+// CM_UseSideKernels
+//   Returns true when the sides of the given brush can be tested with the packed kernels
+//..................
+bool CM_UseSideKernels(const cBrush* brush) { return brush->blocks && col.doSIMD; }
+
+//..................
+// CM_UseLeafKernels
+//   Returns true when the brushes of the given leaf can be prefiltered with the packed kernels
+//..................
+bool CM_UseLeafKernels(const cLeaf* leaf) { return leaf->blocks && col.doLeafSIMD; }
+
+//..................
+// CM_UsePatchKernels
+//   Returns true when the facets of the given patch can be prefiltered with the packed kernels
+//..................
+bool CM_UsePatchKernels(const PatchCol* pc) { return pc->blocks && col.doFacetBVH; }
+
+//..................
+// CM_TraceSideDists
+//   Stores the distance of the box trace start and end to each side of the brush in d1[sideId] and d2[sideId],
+//   exactly as CM_TraceThroughBrush computes them for the box traces (TRACE_MODE_BOX)
+//   d1 and d2 must have room for the sides rounded up to SIMD_LANES
+//   Returns false when the trace is completely in front of any side, which means no intersection with the entire brush
+//..................
+bool CM_TraceSideDists(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) {
+  return traceSides(tw, brush, d1, d2);
+}
+
+//..................
+// CM_TracePointSideDists
+//   Same as CM_TraceSideDists, for the point traces (TRACE_MODE_POINT)
+//..................
+bool CM_TracePointSideDists(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) { return traceSidesPoint(tw, brush, d1, d2); }
+
+//..................
+// CM_TraceSphereSideDists
+//   Same as CM_TraceSideDists, for the capsule traces (TRACE_MODE_CAPSULE)
+//..................
+bool CM_TraceSphereSideDists(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2) { return traceSidesSphere(tw, brush, d1, d2); }
+
+//..................
+// CM_TestSidesOutside
+//   Returns true when the box position is in front of any of the non-axial sides of the brush,
+//   exactly as CM_TestBoxInBrush decides it
+//..................
+bool CM_TestSidesOutside(const TraceWork* tw, const cBrush* brush) {
+  return testSides(tw, brush);
+}
+
+//..................
+// CM_TestSphereSidesOutside
+//   Same as CM_TestSidesOutside, for the capsule position tests (TRACE_MODE_CAPSULE)
+//..................
+bool CM_TestSphereSidesOutside(const TraceWork* tw, const cBrush* brush) { return testSidesSphere(tw, brush); }
+
+//..................
+// CM_LeafBrushHits
+//   Returns a bit for each brush of the given block of a leaf (brushes first..first+SIMD_LANES-1 of the leaf)
+//   that shares contents with the trace, and passes CM_BoundsIntersect against the trace bounds
+//..................
+u32 CM_LeafBrushHits(const TraceWork* tw, const cBrushBlock* block) { return leafBrushes(tw, block); }
+
+//..................
+// CM_PatchFacetBoundsHits
+//   Returns a bit for each facet of the given block of a patch (facets first..first+SIMD_LANES-1 of the patch)
+//   whose bounds touch the bounds of the trace. Bits past the last facet of the patch are cleared
+//   Valid for traces and position tests: anything more than one unit outside of an axial plane of a facet never touches it
+//..................
+u32 CM_PatchFacetBoundsHits(const TraceWork* tw, const PatchCol* pc, i32 first) {
+  u32 hits  = leafBrushes(tw, &pc->facetBounds[first / SIMD_LANES]);
+  i32 count = pc->numFacets - first;
+  return (count < SIMD_LANES) ? hits & ((1u << count) - 1) : hits;
+}
+
+//..................
+// CM_PatchFacetHits
+//   Returns a bit for each facet of the given block of a patch (facets first..first+SIMD_LANES-1 of the patch)
+//   that isn't already missed through its bounds or its surface plane. Bits past the last facet of the patch are cleared
+//..................
+u32 CM_PatchFacetHits(const TraceWork* tw, const PatchCol* pc, i32 first) {
+  u32 hits = CM_PatchFacetBoundsHits(tw, pc, first);
+  return hits ? hits & patchFacets(tw, &pc->blocks[first / SIMD_LANES]) : 0;
+}
+
+//..................
+// CM_PacketPlaneSides
+//   Classifies each ray of the packet (mask) against the plane, and stores the crosspoint fractions of the rays that cross it,
+//   exactly as CM_TraceThroughTree computes them for a point trace
+//..................
+void CM_PacketPlaneSides(const cPlane* plane, const RaySegments* seg, u32 mask, PacketSplit* split) {
+  if (!col.doSIMD || !planeSides) {
+    CM_PlaneSides_Scalar(plane, seg, mask, split);
+    return;
+  }
+  planeSides(plane, seg, mask, split);
+}
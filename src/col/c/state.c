@@ -5,13 +5,30 @@
 ColCfg  col;
 LoadCfg load;
 //..............................
+// CM_InitCfg
+//   Resets the col and load config to their defaults
+//   Call it once at startup, before changing any option. CM_LoadMap keeps the options as they are
+//..............................
 void CM_InitCfg(void) {
   col.doVIS            = 1;
   col.doPatchCol       = 1;
   col.doPlayerCurveCol = 1;
+  col.doSIMD           = 0;
+  col.doLeafSIMD       = 0;
+  col.doFacetBVH       = 0;
+  col.doExactOffset    = 0;
+  col.doBVH            = 0;
+  col.doTraceCache     = 0;
   col.dbg.surfUpdate   = 1;
   load.noCurves        = 0;
   load.developer       = 1;
+  load.nodeOrder       = NODE_ORDER_NONE;
+  load.compact         = 0;
+  load.colTree         = 0;
+  load.nodeBounds      = 0;
+  load.brushOrder      = BRUSH_ORDER_NONE;
+  load.numHulls        = 0;
+  memset(load.leafMasks, 0, sizeof(load.leafMasks));  // no leaf sets. See the bench readme for the masks of the game
 }
 
 //..............................
@@ -26,6 +43,9 @@ i32 c_pointcontents;
 i32 c_traces;        // Number of trace sweeps
 i32 c_brush_traces;  // Moving checks through brushes
 i32 c_patch_traces;  // Moving checks through patches
+i32 c_leaf_traces;   // Leafs visited by trace sweeps
+i32 c_cache_hits;    // Traces answered by the trace cache
+i32 c_cache_misses;  // Traces looked up in the trace cache, and then done
 i32 c_totalPatchBlocks;
 // debug counters are only bumped when running single threaded,
 // because they are an awful coherence problem
@@ -58,36 +78,32 @@ cModel  box_model;
 cPlane* box_planes;
 cBrush* box_brush;
 //..............................
-// CM_InitBoxHull
-//   Set up the planes and nodes so that the six floats of a bounding box
-//   can just be stored out and get a proper clipping hull structure.
-void CM_InitBoxHull(void) {
-  box_planes                        = &cm.planes[cm.numPlanes];
-  box_brush                         = &cm.brushes[cm.numBrushes];
-  box_brush->numsides               = 6;
-  box_brush->sides                  = cm.BSides + cm.numBSides;
-  box_brush->contents               = CONTENTS_BODY;
-  box_model.leaf.numLeafBrushes     = 1;
-  //	box_model.leaf.firstLeafBrush = cm.numBrushes;
-  box_model.leaf.firstLeafBrush     = cm.numLeafBrushes;
-  cm.leafbrushes[cm.numLeafBrushes] = cm.numBrushes;
+// CM_SetupBoxHull
+//   Set up the planes and sides of a box brush,
+//   so that CM_SetBoxHull can just store the six floats of a bounding box in it
+static void CM_SetupBoxHull(cPlane* planes, cBSide* sides, cBrush* brush) {
+  brush->numsides = 6;
+  brush->sideBits = 0;
+  brush->hullSide = -1;
+  brush->sides    = sides;
+  brush->contents = CONTENTS_BODY;
 
   for (i32 i = 0; i < 6; i++) {
     i32 side        = i & 1;
 
     // brush sides
-    cBSide* s       = &cm.BSides[cm.numBSides + i];
-    s->plane        = cm.planes + (cm.numPlanes + i * 2 + side);
+    cBSide* s       = &sides[i];
+    s->plane        = planes + (i * 2 + side);
     s->surfaceFlags = 0;
 
     // planes
-    cPlane* p       = &box_planes[i * 2];
+    cPlane* p       = &planes[i * 2];
     p->type         = i >> 1;
     p->signbits     = 0;
     GVec3Clear(p->normal);
     p->normal[i >> 1] = 1;
 
-    p                 = &box_planes[i * 2 + 1];
+    p                 = &planes[i * 2 + 1];
     p->type           = 3 + (i >> 1);
     p->signbits       = 0;
     GVec3Clear(p->normal);
@@ -97,6 +113,22 @@ void CM_InitBoxHull(void) {
   }
 }
 
+//..............................
+// CM_InitBoxHull
+//   Set up the planes and nodes so that the six floats of a bounding box
+//   can just be stored out and get a proper clipping hull structure.
+void CM_InitBoxHull(void) {
+  box_planes                        = &cm.planes[cm.numPlanes];
+  box_brush                         = &cm.brushes[cm.numBrushes];
+  box_model.leaf.numLeafBrushes     = 1;
+  //	box_model.leaf.firstLeafBrush = cm.numBrushes;
+  box_model.leaf.firstLeafBrush     = cm.numLeafBrushes;
+  cm.leafbrushes[cm.numLeafBrushes] = cm.numBrushes;
+  // compact maps (load.compact) keep only the sides of the box hull in cm.BSides
+  cBSide* sides = (cm.BSides16 || cm.BSides32) ? cm.BSides : cm.BSides + cm.numBSides;
+  CM_SetupBoxHull(box_planes, sides, box_brush);
+}
+
 
 //.................................
 // Storing data as the current state
@@ -122,30 +154,75 @@ void CM_StoreLeafs(LeafList* ll, i32 nodeNum) {
 //..................
 // CM_BoxLeafnums_r
 //   Stores all the leafs touched by the given LeafList, recursively
+//   Subtrees without any of the ll->contents are skipped, when given
+//   Walks the collision tree from the given node when ll->colTree is set, and the original tree otherwise
+//   The collision walks also skip the subtrees whose stored bounds (load.nodeBounds) don't touch ll->bounds
+//   Walks the tree with a fixed stack of the back sides still to visit, unless RECURSIVE_TREE_WALK is defined.
+//   Leafs are stored in the same order either way
 //..................
+#if defined RECURSIVE_TREE_WALK
 void CM_BoxLeafnums_r(LeafList* ll, i32 nodeNum) {
-  cPlane* plane;
-  cNode*  node;
-  i32     s;
+  const cPlane* plane;
+  i32           children[2];
+  i32           s;
   while (1) {
+    i32 contents = ll->colTree ? CM_ColNodeContents(nodeNum) : CM_NodeContents(nodeNum);
+    if (ll->contents && !(contents & ll->contents)) { return; }  // nothing wanted under it
+    if (ll->colTree && !CM_ColNodeTouches(nodeNum, ll->bounds)) { return; }  // outside of the stored bounds
     if (nodeNum < 0) {              // Negative numbers are leaves
       ll->storeLeafs(ll, nodeNum);  // Store the current leaf
       return;
     }
-    node  = &cm.nodes[nodeNum];
-    plane = node->plane;
+    plane = ll->colTree ? CM_GetColNode(nodeNum, children) : CM_GetNode(nodeNum, children);
     s     = BoxOnPlaneSide(ll->bounds[0], ll->bounds[1], plane);
     if (s == 1) {
-      nodeNum = node->children[0];
+      nodeNum = children[0];
     } else if (s == 2) {
-      nodeNum = node->children[1];
+      nodeNum = children[1];
     } else {
       // go down both
-      CM_BoxLeafnums_r(ll, node->children[0]);
-      nodeNum = node->children[1];
+      CM_BoxLeafnums_r(ll, children[0]);
+      nodeNum = children[1];
+    }
+  }
+}
+#else
+void CM_BoxLeafnums_r(LeafList* ll, i32 nodeNum) {
+  i32 stack[MAX_TREE_STACK];
+  i32 depth = 0;
+  while (1) {
+    // skip the subtrees with nothing wanted under them. Negative numbers are leaves
+    i32  contents = ll->colTree ? CM_ColNodeContents(nodeNum) : CM_NodeContents(nodeNum);
+    bool skip     = (ll->contents && !(contents & ll->contents)) || (ll->colTree && !CM_ColNodeTouches(nodeNum, ll->bounds));
+    if (skip || nodeNum < 0) {
+      if (!skip) { ll->storeLeafs(ll, nodeNum); }  // Store the current leaf
+      if (!depth) { return; }
+      nodeNum = stack[--depth];
+      continue;
+    }
+    i32           children[2];
+    const cPlane* plane = ll->colTree ? CM_GetColNode(nodeNum, children) : CM_GetNode(nodeNum, children);
+    i32           s     = BoxOnPlaneSide(ll->bounds[0], ll->bounds[1], plane);
+    if (s == 1) {
+      nodeNum = children[0];
+    } else if (s == 2) {
+      nodeNum = children[1];
+    } else if (depth < MAX_TREE_STACK) {
+      // go down both, the back side after the whole front side
+      if (ll->colTree) {
+        CM_PrefetchColNode(children[1]);
+      } else {
+        CM_PrefetchNode(children[1]);
+      }
+      stack[depth++] = children[1];
+      nodeNum        = children[0];
+    } else {  // stack is full: walk the front side in a new walk
+      CM_BoxLeafnums_r(ll, children[0]);
+      nodeNum = children[1];
     }
   }
 }
+#endif  // RECURSIVE_TREE_WALK
 
 //..................
 // CM_BoxLeafnums
@@ -165,6 +242,8 @@ i32 CM_BoxLeafnums(const vec3 mins, const vec3 maxs, i32* list, i32 listsize, i3
   ll.list       = list;
   ll.storeLeafs = CM_StoreLeafs;
   ll.lastLeaf   = 0;
+  ll.contents   = 0;
+  ll.colTree    = false;
   ll.overflowed = false;
 
   CM_BoxLeafnums_r(&ll, 0);
@@ -220,6 +299,8 @@ i32 CM_BoxBrushes(const vec3 mins, const vec3 maxs, cBrush** list, i32 listsize)
   ll.list       = (void*)list;
   ll.storeLeafs = CM_StoreBrushes;
   ll.lastLeaf   = 0;
+  ll.contents   = 0;
+  ll.colTree    = false;
   ll.overflowed = false;
 
   CM_BoxLeafnums_r(&ll, 0);
@@ -227,6 +308,143 @@ i32 CM_BoxBrushes(const vec3 mins, const vec3 maxs, cBrush** list, i32 listsize)
   return ll.count;
 }
 
+//..................
+// Leaf walk of CM_QueryGather: the LeafList, with the trace data that keeps the visited marks of the gather
+typedef struct {
+  LeafList   ll;  // first, so that the walk can hand it back to CM_StoreGather
+  TraceWork  tw;
+  ColGather* g;
+} GatherList;
+
+//..................
+// CM_GatherItem
+//   Adds the given brush number, or -1-surfnum for a patch, to the gathered items. The list grows as needed
+//..................
+static void CM_GatherItem(ColGather* g, i32 id) {
+  if (g->count == g->size) {
+    i32  size  = g->size ? g->size * 2 : 64;
+    i32* items = Z_Malloc(size * sizeof(*items));
+    if (g->items) {
+      memcpy(items, g->items, g->count * sizeof(*items));
+      Z_Free(g->items);
+    }
+    g->items = items;
+    g->size  = size;
+  }
+  g->items[g->count++] = id;
+}
+
+//..................
+// CM_StoreGather
+//   Stores the brushes and patches of the given leaf that touch the bounds of the GatherList, and have any of its contents
+//   Same as CM_StoreBrushes, with the patches too, and without any cap on their number
+//..................
+static void CM_StoreGather(LeafList* ll, i32 nodeNum) {
+  GatherList*  gl   = (GatherList*)ll;
+  const cLeaf* leaf = &gl->tw.leafs[-1 - nodeNum];
+  for (i32 k = 0; k < leaf->numLeafBrushes; k++) {
+    i32           brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
+    const cBrush* b        = &cm.brushes[brushnum];
+    if (CM_BrushChecked(&gl->tw, brushnum)) { continue; }  // already gathered from another leaf
+    if (!(b->contents & ll->contents)) { continue; }
+    if (!CM_BoundsIntersect(ll->bounds[0], ll->bounds[1], b->bounds[0], b->bounds[1])) { continue; }
+    CM_GatherItem(gl->g, brushnum);
+  }
+  for (i32 k = 0; k < leaf->numLeafSurfaces; k++) {
+    i32           surfnum = cm.leafsurfaces[leaf->firstLeafSurface + k];
+    const cPatch* patch   = cm.surfaces[surfnum];
+    if (!patch) { continue; }
+    if (CM_PatchChecked(&gl->tw, surfnum)) { continue; }
+    if (!(patch->contents & ll->contents)) { continue; }
+    if (!CM_BoundsIntersect(ll->bounds[0], ll->bounds[1], patch->pc->bounds[0], patch->pc->bounds[1])) { continue; }
+    CM_GatherItem(gl->g, -1 - surfnum);
+  }
+}
+
+//..................
+// CM_QueryGather
+//   Gathers the world brushes and patches with any of the brushmask contents that touch the given box into `g`, walking the tree once
+//   World traces given `g` (CM_QueryGatherTrace) then only test those, as long as their swept box stays inside the same box
+//   (eg: all the moves of a player slide move, gathered around the box of the whole move)
+//   `g` must be zeroed before its first gather. Gathering it again reuses its memory
+//   The visited marks are kept in the given query context. A NULL query uses the shared state of the loaded map, like CM_BoxTrace
+//..................
+void CM_QueryGather(ColQuery* q, ColGather* g, const vec3 mins, const vec3 maxs, i32 brushmask) {
+  CM_QueryClipModel(q, 0);  // validates the context
+  g->checksum = cm.checksum;
+  g->contents = brushmask;
+  g->count    = 0;
+  GVec3Copy(mins, g->bounds[0]);
+  GVec3Copy(maxs, g->bounds[1]);
+  if (!cm.numNodes) { return; }  // map not loaded
+
+  GatherList gl;
+  memset(&gl.tw, 0, sizeof(gl.tw));
+  gl.tw.query = q;
+  gl.tw.leafs = CM_LeafsForMask(brushmask);
+  gl.g        = g;
+  CM_NextCheck(&gl.tw);
+  for (i32 i = 0; i < 3; i++) {
+    gl.ll.bounds[0][i] = mins[i] - 1;
+    gl.ll.bounds[1][i] = maxs[i] + 1;
+  }
+  gl.ll.count      = 0;
+  gl.ll.maxcount   = 0;
+  gl.ll.list       = NULL;
+  gl.ll.storeLeafs = CM_StoreGather;
+  gl.ll.lastLeaf   = 0;
+  gl.ll.contents   = brushmask;
+  gl.ll.colTree    = true;
+  gl.ll.overflowed = false;
+
+  CM_BoxLeafnums_r(&gl.ll, cm.colRoot);
+}
+
+//..................
+// CM_Gather
+//   Same as CM_QueryGather, with the shared state of the loaded map. Not reentrant
+//..................
+void CM_Gather(ColGather* g, const vec3 mins, const vec3 maxs, i32 brushmask) { CM_QueryGather(NULL, g, mins, maxs, brushmask); }
+
+//..................
+// CM_FreeGather
+//   Releases the memory owned by the given gather context
+//..................
+void CM_FreeGather(ColGather* g) {
+  if (g->items) { Z_Free(g->items); }
+  memset(g, 0, sizeof(*g));
+}
+
+//.................................
+// CM_SetBoxHull
+//   Stores the given AABB into the given box model, and converts it to bsp when it is not a capsule
+//   Shared by CM_TempBoxModel and CM_QueryTempBoxModel
+//.................................
+static cHandle CM_SetBoxHull(cModel* model, cPlane* planes, cBrush* brush, const vec3 mins, const vec3 maxs, i32 capsule) {
+  GVec3Copy(mins, model->mins);
+  GVec3Copy(maxs, model->maxs);
+
+  if (capsule) { return CAPSULE_MODEL_HANDLE; }
+
+  planes[0].dist  = maxs[0];
+  planes[1].dist  = -maxs[0];
+  planes[2].dist  = mins[0];
+  planes[3].dist  = -mins[0];
+  planes[4].dist  = maxs[1];
+  planes[5].dist  = -maxs[1];
+  planes[6].dist  = mins[1];
+  planes[7].dist  = -mins[1];
+  planes[8].dist  = maxs[2];
+  planes[9].dist  = -maxs[2];
+  planes[10].dist = mins[2];
+  planes[11].dist = -mins[2];
+
+  GVec3Copy(mins, brush->bounds[0]);
+  GVec3Copy(maxs, brush->bounds[1]);
+
+  return BOX_MODEL_HANDLE;
+}
+
 //.................................
 // CM_TempBoxModel
 //   Stores the given AABB into the box_model state variable, and returns its clipHandle
@@ -245,29 +463,77 @@ i32 CM_BoxBrushes(const vec3 mins, const vec3 maxs, cBrush** list, i32 listsize)
 //   Bounding Boxes are turned into small BSP trees, instead of being compared directly.
 //   Capsules are handled differently, though.
 //.................................
-cHandle CM_TempBoxModel(const vec3 mins, const vec3 maxs, i32 capsule) {
-  GVec3Copy(mins, box_model.mins);
-  GVec3Copy(maxs, box_model.maxs);
+cHandle CM_TempBoxModel(const vec3 mins, const vec3 maxs, i32 capsule) { return CM_SetBoxHull(&box_model, box_planes, box_brush, mins, maxs, capsule); }
 
-  if (capsule) { return CAPSULE_MODEL_HANDLE; }
+//.................................
+// Reentrant query contexts
+//.................................
+
+//..................
+// CM_InitQuery
+//   Creates the visited stamps and temporary box hull of a query context, for the currently loaded map
+//   Each thread that traces concurrently must own its own context
+//   Must be called again (after CM_FreeQuery) when a different map is loaded
+//..................
+void CM_InitQuery(ColQuery* q) {
+  memset(q, 0, sizeof(*q));
+  q->checksum    = cm.checksum;
+  q->brushStamps = Z_Malloc((cm.numBrushes + 1) * sizeof(*q->brushStamps));
+  q->patchStamps = Z_Malloc((cm.numSurfaces + 1) * sizeof(*q->patchStamps));
+  q->brushLanes  = Z_Malloc((cm.numBrushes + 1) * sizeof(*q->brushLanes));
+  q->patchLanes  = Z_Malloc((cm.numSurfaces + 1) * sizeof(*q->patchLanes));
+  CM_SetupBoxHull(q->boxPlanes, q->boxSides, &q->boxBrush);
+}
 
-  box_planes[0].dist  = maxs[0];
-  box_planes[1].dist  = -maxs[0];
-  box_planes[2].dist  = mins[0];
-  box_planes[3].dist  = -mins[0];
-  box_planes[4].dist  = maxs[1];
-  box_planes[5].dist  = -maxs[1];
-  box_planes[6].dist  = mins[1];
-  box_planes[7].dist  = -mins[1];
-  box_planes[8].dist  = maxs[2];
-  box_planes[9].dist  = -maxs[2];
-  box_planes[10].dist = mins[2];
-  box_planes[11].dist = -mins[2];
-
-  GVec3Copy(mins, box_brush->bounds[0]);
-  GVec3Copy(maxs, box_brush->bounds[1]);
+//..................
+// CM_FreeQuery
+//   Releases the memory owned by the given query context
+//..................
+void CM_FreeQuery(ColQuery* q) {
+  if (q->brushStamps) { Z_Free(q->brushStamps); }
+  if (q->patchStamps) { Z_Free(q->patchStamps); }
+  if (q->brushLanes) { Z_Free(q->brushLanes); }
+  if (q->patchLanes) { Z_Free(q->patchLanes); }
+  memset(q, 0, sizeof(*q));
+}
 
-  return BOX_MODEL_HANDLE;
+//..................
+// CM_QueryTempBoxModel
+//   Same as CM_TempBoxModel, but stores the AABB into the box model of the given query context
+//   The returned handle is only valid for traces that use that same context
+//..................
+cHandle CM_QueryTempBoxModel(ColQuery* q, const vec3 mins, const vec3 maxs, i32 capsule) {
+  return CM_SetBoxHull(&q->boxModel, q->boxPlanes, &q->boxBrush, mins, maxs, capsule);
+}
+
+//..................
+// CM_QueryClipModel
+//   Same as CM_ClipHandleToModel, but the temporary box handles are read from the given query context
+//   A NULL query uses the shared state of the loaded map
+//..................
+cModel* CM_QueryClipModel(ColQuery* q, cHandle handle) {
+  if (!q) { return CM_ClipHandleToModel(handle); }
+  if (q->checksum != cm.checksum) { err(ERR_DROP, "%s: query context was created for a different map", __func__); }
+  if (handle == BOX_MODEL_HANDLE || handle == CAPSULE_MODEL_HANDLE) { return &q->boxModel; }
+  return CM_ClipHandleToModel(handle);
+}
+
+//..................
+// CM_NextCheck
+//   Starts a new generation of visited marks for the given trace data (TraceWork)
+//   Query contexts clear their stamps when the generation counter wraps around
+//..................
+void CM_NextCheck(TraceWork* tw) {
+  if (!tw->query) {
+    cm.checkcount++;
+    return;
+  }
+  ColQuery* q = tw->query;
+  if (++q->stamp == 0) {
+    memset(q->brushStamps, 0, (cm.numBrushes + 1) * sizeof(*q->brushStamps));
+    memset(q->patchStamps, 0, (cm.numSurfaces + 1) * sizeof(*q->patchStamps));
+    q->stamp = 1;
+  }
 }
 
 //.................................
@@ -306,6 +572,8 @@ PatchCol* CM_GeneratePatchCollide(i32 width, i32 height, vec3* points) {
   c_totalPatchBlocks += (grid.width - 1) * (grid.height - 1);
   // generate a bsp tree for the surface
   CM_PatchCollideFromGrid(&grid, pf);
+  CM_PackPatchFacets(pf);
+  CM_BuildFacetBVH(pf);
   // expand by one unit for epsilon purposes
   pf->bounds[0][0] -= 1;
   pf->bounds[0][1] -= 1;
@@ -394,6 +662,111 @@ i32 CM_LeafArea(i32 leafnum) {
   return cm.leafs[leafnum].area;
 }
 
+//..................
+// CM_LeafsForMask
+//   Returns the world leafs that the traces with the given contents mask walk:
+//   the leaf set with the fewest brushes that keeps every brush they can hit, or cm.leafs when there is none
+//..................
+cLeaf* CM_LeafsForMask(i32 contents) {
+  cLeaf* leafs = cm.leafs;
+  i32    best  = cm.numLeafBrushes;
+  for (i32 setId = 0; setId < cm.numLeafSets; setId++) {
+    const cLeafSet* set = &cm.leafSets[setId];
+    if ((contents & ~set->contents) || set->numBrushes >= best) { continue; }
+    best  = set->numBrushes;
+    leafs = set->leafs;
+  }
+  return leafs;
+}
+
+//..................
+// CM_PointInBrush
+//   Checks if the given point is inside the given clipBrush
+//..................
+static bool CM_PointInBrush(const vec3 p, const cBrush* b) {
+  if (!CM_BoundsIntersectPoint(b->bounds[0], b->bounds[1], p)) { return false; }
+  // see if the point is in the brush
+  for (i32 sideId = 0; sideId < b->numsides; sideId++) {
+    const cPlane* plane = CM_SidePlane(b, sideId);
+    f32           dot   = GVec3Dot(p, plane->normal);
+    if (dot > plane->dist) { return false; }
+  }
+  return true;
+}
+
+//..................
+// CM_LeafPointContents
+//   Returns the ORed contents mask of the brushes of the given clipLeaf at a given point
+//..................
+static i32 CM_LeafPointContents(const vec3 p, const cLeaf* leaf) {
+  i32 contents = 0;
+  for (i32 k = 0; k < leaf->numLeafBrushes; k++) {
+    i32     brushId = cm.leafbrushes[leaf->firstLeafBrush + k];
+    cBrush* b       = &cm.brushes[brushId];
+    if (CM_PointInBrush(p, b)) { contents |= b->contents; }
+  }
+  return contents;
+}
+
+//..................
+// CM_WorldPointContents
+//   Returns the ORed contents mask of the world brushes at a given point
+//   Same walk as CM_FindPointLeaf, that stops as soon as the subtree of the point has no contents
+//   Doesn't write any state, so it is safe to call from reentrant queries
+//..................
+static i32 CM_WorldPointContents(const vec3 p) {
+  i32 num = 0;
+  while (num >= 0) {
+    if (!CM_NodeContents(num)) { return 0; }
+    i32           children[2];
+    const cPlane* plane = CM_GetNode(num, children);
+    f32           d;
+    if (plane->type < 3) d = p[plane->type] - plane->dist;
+    else d = GVec3Dot(plane->normal, p) - plane->dist;
+    if (d < 0) num = children[1];
+    else num = children[0];
+  }
+  const cLeaf* leaf = &cm.leafs[-1 - num];
+  if (!leaf->contents) { return 0; }
+  return CM_LeafPointContents(p, leaf);
+}
+
+//..................
+// Point and contents of CM_BVHPointContents, for its BVHVisit
+typedef struct {
+  const f32* p;
+  i32        contents;
+} BVHPoint;
+
+//..................
+// CM_BVHPointLeaf
+//   BVHVisit of CM_BVHPointContents. ORs the contents of the brushes of the leaf that contain the point
+//..................
+static bool CM_BVHPointLeaf(void* data, const i32* items, i32 count) {
+  BVHPoint* bp = data;
+  for (i32 i = 0; i < count; i++) {
+    if (items[i] < 0) { continue; }  // patches have no volume
+    const cBrush* b = &cm.brushes[items[i]];
+    if (CM_PointInBrush(bp->p, b)) { bp->contents |= b->contents; }
+  }
+  return false;
+}
+
+//..................
+// CM_BVHPointContents
+//   Returns the ORed contents mask of the world brushes at a given point, found through the BVH
+//..................
+static i32 CM_BVHPointContents(const vec3 p) {
+  vec3 mins, maxs;
+  for (i32 i = 0; i < 3; i++) {
+    mins[i] = p[i] - 1;
+    maxs[i] = p[i] + 1;
+  }
+  BVHPoint bp = { p, 0 };
+  CM_BVHBoxLeafs(mins, maxs, CM_BVHPointLeaf, &bp);
+  return bp.contents;
+}
+
 //..................
 // CM_PointContents
 //   Returns the ORed contents mask of the given clipModel at a given point
@@ -401,33 +774,57 @@ i32 CM_LeafArea(i32 leafnum) {
 i32 CM_PointContents(const vec3 p, cHandle model) {
   if (!cm.numNodes) { return 0; }  // map not loaded
 
-  cModel* clipm;
-  cLeaf*  leaf;
-  i32     leafnum;
   if (model) {
-    clipm = CM_ClipHandleToModel(model);
-    leaf  = &clipm->leaf;
-  } else {
-    leafnum = CM_PointLeafnum_r(p, 0);
-    leaf    = &cm.leafs[leafnum];
+    cModel* clipm = CM_ClipHandleToModel(model);
+    return CM_LeafPointContents(p, &clipm->leaf);
   }
+  if (col.doBVH) { return CM_BVHPointContents(p); }
+  c_pointcontents++;  // optimize counter
+  return CM_WorldPointContents(p);
+}
 
-  i32 contents = 0;
-  for (i32 k = 0; k < leaf->numLeafBrushes; k++) {
-    i32     brushId = cm.leafbrushes[leaf->firstLeafBrush + k];
-    cBrush* b       = &cm.brushes[brushId];
-    if (!CM_BoundsIntersectPoint(b->bounds[0], b->bounds[1], p)) { continue; }
+//..................
+// CM_PointContentsHint
+//   Same as CM_PointContents for the world, starting the leaf lookup from the leaf in *leafnum (see CM_PointLeafnumHint)
+//   Stores the leaf of the point back into *leafnum, to be used as the hint of the next call. Start with -1
+//..................
+i32 CM_PointContentsHint(const vec3 p, i32* leafnum) {
+  if (!cm.numNodes) { return 0; }  // map not loaded
+  *leafnum = CM_PointLeafnumHint(p, *leafnum);
+  if (col.doBVH) { return CM_BVHPointContents(p); }
+  const cLeaf* leaf = &cm.leafs[*leafnum];
+  if (!leaf->contents) { return 0; }
+  return CM_LeafPointContents(p, leaf);
+}
 
-    // see if the point is in the brush
-    i32 sideId;
-    for (sideId = 0; sideId < b->numsides; sideId++) {
-      f32 dot = GVec3Dot(p, b->sides[sideId].plane->normal);
-      if (dot > b->sides[sideId].plane->dist) { break; }
-    }
-    if (sideId == b->numsides) { contents |= b->contents; }
+//..................
+// CM_QueryPointContents
+//   Same as CM_PointContents, but only writes into the given query context
+//..................
+i32 CM_QueryPointContents(ColQuery* q, const vec3 p, cHandle model) {
+  if (!cm.numNodes) { return 0; }  // map not loaded
+
+  if (model) {
+    cModel* clipm = CM_QueryClipModel(q, model);
+    if (clipm == &q->boxModel) { return CM_PointInBrush(p, &q->boxBrush) ? q->boxBrush.contents : 0; }
+    return CM_LeafPointContents(p, &clipm->leaf);
   }
+  q->pointcontents++;
+  if (col.doBVH) { return CM_BVHPointContents(p); }
+  return CM_WorldPointContents(p);
+}
 
-  return contents;
+//..................
+// CM_PointToModel
+//   Moves the given point into the frame of reference of a clipModel with the given transform
+//   The rows of the rotation matrix are the forward, -right and up vectors of the angles
+//..................
+static void CM_PointToModel(const vec3 p, cHandle model, const EntityTransform* xf, vec3 p_l) {
+  // subtract origin offset
+  GVec3Sub(p, xf->origin, p_l);
+
+  // rotate start and end into the models frame of reference
+  if (model != BOX_MODEL_HANDLE && xf->rotated) { RotatePoint(p_l, (vec3*)xf->matrix); }
 }
 
 //..................
@@ -436,21 +833,37 @@ i32 CM_PointContents(const vec3 p, cHandle model) {
 //   Handles offseting and rotation of the end points (moving and rotating entities)
 //..................
 i32 CM_TransformedPointContents(const vec3 p, cHandle model, const vec3 origin, const vec3 angles) {
-  // subtract origin offset
-  vec3 p_l;
-  GVec3Sub(p, origin, p_l);
+  EntityTransform xf;
+  CM_SetEntityTransform(&xf, origin, angles);
+  return CM_EntityPointContents(p, model, &xf);
+}
 
-  // rotate start and end into the models frame of reference
-  if (model != BOX_MODEL_HANDLE && (angles[0] || angles[1] || angles[2])) {
-    vec3 forward, right, up;
-    AngleVectors(angles, forward, right, up);
-
-    vec3 temp;
-    GVec3Copy(p_l, temp);
-    p_l[0] = GVec3Dot(temp, forward);
-    p_l[1] = -GVec3Dot(temp, right);
-    p_l[2] = GVec3Dot(temp, up);
-  }
+//..................
+// CM_QueryTransformedPointContents
+//   Same as CM_TransformedPointContents, but only writes into the given query context
+//..................
+i32 CM_QueryTransformedPointContents(ColQuery* q, const vec3 p, cHandle model, const vec3 origin, const vec3 angles) {
+  EntityTransform xf;
+  CM_SetEntityTransform(&xf, origin, angles);
+  return CM_QueryEntityPointContents(q, p, model, &xf);
+}
 
+//..................
+// CM_EntityPointContents
+//   Same as CM_TransformedPointContents, with the origin and rotation of a transform prepared by CM_SetEntityTransform
+//..................
+i32 CM_EntityPointContents(const vec3 p, cHandle model, const EntityTransform* xf) {
+  vec3 p_l;
+  CM_PointToModel(p, model, xf, p_l);
   return CM_PointContents(p_l, model);
 }
+
+//..................
+// CM_QueryEntityPointContents
+//   Same as CM_EntityPointContents, but only writes into the given query context
+//..................
+i32 CM_QueryEntityPointContents(ColQuery* q, const vec3 p, cHandle model, const EntityTransform* xf) {
+  vec3 p_l;
+  CM_PointToModel(p, model, xf, p_l);
+  return CM_QueryPointContents(q, p_l, model);
+}
@@ -4,75 +4,82 @@
 // Solve: Trace Checks  (aka sweep/line/movement)
 //..................
 
+//..................
+// CM_PatchPlaneIntersection
+//   Fraction of the point trace where it crosses the given patch plane, or 99999 when it doesn't cross it forwards
+//   Stores into *frontFacing whether the trace starts in front of the plane
+//..................
+static f32 CM_PatchPlaneIntersection(const TraceWork* tw, const PatchPlane* pp, bool* frontFacing) {
+  f32 offset   = GVec3Dot(tw->offsets[pp->signbits], pp->plane);
+  f32 d1       = GVec3Dot(tw->start, pp->plane) - pp->plane[3] + offset;
+  f32 d2       = GVec3Dot(tw->end, pp->plane) - pp->plane[3] + offset;
+  *frontFacing = d1 > 0;
+  if (d1 == d2) { return 99999; }
+  f32 intersection = d1 / (d1 - d2);
+  if (intersection <= 0) { return 99999; }
+  return intersection;
+}
+
+//..................
+// CM_TracePointThroughFacet
+//   Sweep a trace point through one facet of a patch
+//   The planes are only evaluated when the facet needs them, instead of all the planes of the patch up front
+//..................
+static void CM_TracePointThroughFacet(TraceWork* tw, const PatchCol* pc, const Facet* facet) {
+  bool frontFacing;
+  f32  intersect = CM_PatchPlaneIntersection(tw, &pc->planes[facet->surfacePlane], &frontFacing);
+  if (!frontFacing) { return; }
+  if (intersect < 0) { return; }                   // surface is behind the starting point
+  if (intersect > tw->trace.fraction) { return; }  // already hit something closer
+  for (i32 borderId = 0; borderId < facet->numBorders; borderId++) {
+    bool borderFront;
+    f32  borderIntersect = CM_PatchPlaneIntersection(tw, &pc->planes[facet->borderPlanes[borderId]], &borderFront);
+    if (borderFront ^ facet->borderInward[borderId]) {
+      if (borderIntersect > intersect) { return; }
+    } else {
+      if (borderIntersect < intersect) { return; }
+    }
+  }
+  // we hit this facet
+  if (col.dbg.surfUpdate && !tw->query) {  // Store it as the debuggable patch
+    debugPatchCollide = pc;
+    debugFacet        = facet;
+  }
+  const PatchPlane* pp = &pc->planes[facet->surfacePlane];
+
+  // calculate intersection with a slight pushoff
+  f32 offset         = GVec3Dot(tw->offsets[pp->signbits], pp->plane);
+  f32 d1             = GVec3Dot(tw->start, pp->plane) - pp->plane[3] + offset;
+  f32 d2             = GVec3Dot(tw->end, pp->plane) - pp->plane[3] + offset;
+  tw->trace.fraction = (d1 - SURFACE_CLIP_EPSILON) / (d1 - d2);
+
+  if (tw->trace.fraction < 0) { tw->trace.fraction = 0; }
+
+  GVec3Copy(pp->plane, tw->trace.plane.normal);
+  tw->trace.plane.dist = pp->plane[3];
+}
+
 //..................
 // CM_TracePointThroughPatchCollide
 //   Sweep a trace point through a patch
 //   Special case for point traces because patch collide "brushes" have no volume
+//   Packed patches only visit the facets of the blocks touched by the trace (CM_FacetBVHBlocks),
+//   whose surface plane is crossed before the current fraction (CM_PatchFacetHits)
 //..................
 static void CM_TracePointThroughPatchCollide(TraceWork* tw, const PatchCol* pc) {
   if (!col.doPlayerCurveCol || !tw->isPoint) { return; }
-
-  // determine the trace's relationship to all planes
-  const PatchPlane* pp;
-  pp = pc->planes;
-  bool frontFacing[MAX_PATCH_PLANES];
-  f32  intersection[MAX_PATCH_PLANES];
-  f32  offset;
-  f32  d1, d2;
-  for (i32 planeId = 0; planeId < pc->numPlanes; planeId++, pp++) {
-    offset = GVec3Dot(tw->offsets[pp->signbits], pp->plane);
-    d1     = GVec3Dot(tw->start, pp->plane) - pp->plane[3] + offset;
-    d2     = GVec3Dot(tw->end, pp->plane) - pp->plane[3] + offset;
-    if (d1 <= 0) {
-      frontFacing[planeId] = false;
-    } else {
-      frontFacing[planeId] = true;
-    }
-    if (d1 == d2) {
-      intersection[planeId] = 99999;
-    } else {
-      intersection[planeId] = d1 / (d1 - d2);
-      if (intersection[planeId] <= 0) { intersection[planeId] = 99999; }
-    }
-  }
-  // see if any of the surface planes are intersected
-  const Facet* facet;
-  facet = pc->facets;
-  f32 intersect;
-  i32 planeBorderId;
-  for (i32 facetId = 0; facetId < pc->numFacets; facetId++, facet++) {
-    if (!frontFacing[facet->surfacePlane]) { continue; }
-    intersect = intersection[facet->surfacePlane];
-    if (intersect < 0) { continue; }                   // surface is behind the starting point
-    if (intersect > tw->trace.fraction) { continue; }  // already hit something closer
-    i32 borderId;
-    for (borderId = 0; borderId < facet->numBorders; borderId++) {
-      planeBorderId = facet->borderPlanes[borderId];
-      if (frontFacing[planeBorderId] ^ facet->borderInward[borderId]) {
-        if (intersection[planeBorderId] > intersect) { break; }
-      } else {
-        if (intersection[planeBorderId] < intersect) { break; }
+  if (CM_UsePatchKernels(pc)) {
+    i32 blocks[MAX_FACETS / SIMD_LANES];
+    i32 numBlocks = CM_FacetBVHBlocks(tw, pc, blocks);
+    for (i32 i = 0; i < numBlocks; i++) {
+      i32 first = blocks[i] * SIMD_LANES;
+      for (u32 hits = CM_PatchFacetHits(tw, pc, first); hits; hits &= hits - 1) {
+        CM_TracePointThroughFacet(tw, pc, &pc->facets[first + __builtin_ctz(hits)]);
       }
     }
-    if (borderId == facet->numBorders) {
-      // we hit this facet
-      if (col.dbg.surfUpdate) {  // Store it as the debuggable patch
-        debugPatchCollide = pc;
-        debugFacet        = facet;
-      }
-      pp                 = &pc->planes[facet->surfacePlane];
-      // calculate intersection with a slight pushoff
-      offset             = GVec3Dot(tw->offsets[pp->signbits], pp->plane);
-      d1                 = GVec3Dot(tw->start, pp->plane) - pp->plane[3] + offset;
-      d2                 = GVec3Dot(tw->end, pp->plane) - pp->plane[3] + offset;
-      tw->trace.fraction = (d1 - SURFACE_CLIP_EPSILON) / (d1 - d2);
-
-      if (tw->trace.fraction < 0) { tw->trace.fraction = 0; }
-
-      GVec3Copy(pp->plane, tw->trace.plane.normal);
-      tw->trace.plane.dist = pp->plane[3];
-    }
+    return;
   }
+  for (i32 facetId = 0; facetId < pc->numFacets; facetId++) { CM_TracePointThroughFacet(tw, pc, &pc->facets[facetId]); }
 }
 
 //..................
@@ -105,33 +112,56 @@ static i32 CM_CheckFacetPlane(const f32* plane, const vec3 start, const vec3 end
 
 
 //..................
-// CM_TraceThroughPatchCollide
-//   Checks if the given trace data (TraceWork) passes through any of the given patch facets
+// CM_TraceThroughFacet
+//   Checks if the given trace data (TraceWork) passes through one facet of a patch
 //..................
-void CM_TraceThroughPatchCollide(TraceWork* tw, const PatchCol* pc) {
-  if (!CM_BoundsIntersect(tw->bounds[0], tw->bounds[1], pc->bounds[0], pc->bounds[1])) { return; }
-  if (tw->isPoint) {
-    CM_TracePointThroughPatchCollide(tw, pc);
-    return;
-  }
-
+static void CM_TraceThroughFacet(TraceWork* tw, const PatchCol* pc, const Facet* facet) {
   f32 bestplane[4];
   GVec4Set(bestplane, 0, 0, 0, 0);
 
-  PatchPlane* pp;
-  Facet*      facet = pc->facets;
-  vec3        startp, endp;
-  f32         offset, enterFrac, leaveFrac;
-  f32         plane[4];
-  i32         hit, hitnum;
-  for (i32 facetId = 0; facetId < pc->numFacets; facetId++, facet++) {
-    enterFrac = -1.0;
-    leaveFrac = 1.0;
-    hitnum    = -1;
-    //
-    pp        = &pc->planes[facet->surfacePlane];
-    GVec3Copy(pp->plane, plane);
-    plane[3] = pp->plane[3];
+  vec3 startp, endp;
+  f32  offset;
+  f32  plane[4];
+  i32  hit;
+  f32  enterFrac = -1.0;
+  f32  leaveFrac = 1.0;
+  i32  hitnum    = -1;
+  //
+  const PatchPlane* pp = &pc->planes[facet->surfacePlane];
+  GVec3Copy(pp->plane, plane);
+  plane[3] = pp->plane[3];
+  if (tw->sphere.use) {
+    // adjust the plane distance appropriately for radius
+    plane[3] += tw->sphere.radius;
+
+    // find the closest point on the capsule to the plane
+    f32 t = GVec3Dot(plane, tw->sphere.offset);
+    if (t > 0.0f) {
+      GVec3Sub(tw->start, tw->sphere.offset, startp);
+      GVec3Sub(tw->end, tw->sphere.offset, endp);
+    } else {
+      GVec3Add(tw->start, tw->sphere.offset, startp);
+      GVec3Add(tw->end, tw->sphere.offset, endp);
+    }
+  } else {
+    offset = GVec3Dot(tw->offsets[pp->signbits], plane);
+    plane[3] -= offset;
+    GVec3Copy(tw->start, startp);
+    GVec3Copy(tw->end, endp);
+  }
+
+  if (!CM_CheckFacetPlane(plane, startp, endp, &enterFrac, &leaveFrac, &hit)) { return; }
+  if (hit) { GVec4Copy(plane, bestplane); }
+
+  for (i32 borderId = 0; borderId < facet->numBorders; borderId++) {
+    pp = &pc->planes[facet->borderPlanes[borderId]];
+    if (facet->borderInward[borderId]) {
+      GVec3Neg(pp->plane, plane);
+      plane[3] = -pp->plane[3];
+    } else {
+      GVec3Copy(pp->plane, plane);
+      plane[3] = pp->plane[3];
+    }
     if (tw->sphere.use) {
       // adjust the plane distance appropriately for radius
       plane[3] += tw->sphere.radius;
@@ -146,78 +176,71 @@ void CM_TraceThroughPatchCollide(TraceWork* tw, const PatchCol* pc) {
         GVec3Add(tw->end, tw->sphere.offset, endp);
       }
     } else {
+      // NOTE: this works even though the plane might be flipped because the bbox is centered
       offset = GVec3Dot(tw->offsets[pp->signbits], plane);
-      plane[3] -= offset;
+      plane[3] += fabs(offset);
       GVec3Copy(tw->start, startp);
       GVec3Copy(tw->end, endp);
     }
 
-    if (!CM_CheckFacetPlane(plane, startp, endp, &enterFrac, &leaveFrac, &hit)) { continue; }
-    if (hit) { GVec4Copy(plane, bestplane); }
-
-    i32 borderId;
-    for (borderId = 0; borderId < facet->numBorders; borderId++) {
-      pp = &pc->planes[facet->borderPlanes[borderId]];
-      if (facet->borderInward[borderId]) {
-        GVec3Neg(pp->plane, plane);
-        plane[3] = -pp->plane[3];
-      } else {
-        GVec3Copy(pp->plane, plane);
-        plane[3] = pp->plane[3];
-      }
-      if (tw->sphere.use) {
-        // adjust the plane distance appropriately for radius
-        plane[3] += tw->sphere.radius;
-
-        // find the closest point on the capsule to the plane
-        f32 t = GVec3Dot(plane, tw->sphere.offset);
-        if (t > 0.0f) {
-          GVec3Sub(tw->start, tw->sphere.offset, startp);
-          GVec3Sub(tw->end, tw->sphere.offset, endp);
-        } else {
-          GVec3Add(tw->start, tw->sphere.offset, startp);
-          GVec3Add(tw->end, tw->sphere.offset, endp);
-        }
-      } else {
-        // NOTE: this works even though the plane might be flipped because the bbox is centered
-        offset = GVec3Dot(tw->offsets[pp->signbits], plane);
-        plane[3] += fabs(offset);
-        GVec3Copy(tw->start, startp);
-        GVec3Copy(tw->end, endp);
-      }
+    if (!CM_CheckFacetPlane(plane, startp, endp, &enterFrac, &leaveFrac, &hit)) { return; }
+    if (hit) {
+      hitnum = borderId;
+      GVec4Copy(plane, bestplane);
+    }
+  }
+  // never clip against the back side
+  if (hitnum == facet->numBorders - 1) return;
 
-      if (!CM_CheckFacetPlane(plane, startp, endp, &enterFrac, &leaveFrac, &hit)) { break; }
-      if (hit) {
-        hitnum = borderId;
-        GVec4Copy(plane, bestplane);
+  if (enterFrac < leaveFrac && enterFrac >= 0) {
+    if (enterFrac < tw->trace.fraction) {
+      if (col.dbg.surfUpdate && !tw->query) {
+        debugPatchCollide = pc;
+        debugFacet        = facet;
       }
+      tw->trace.fraction = enterFrac;
+      GVec3Copy(bestplane, tw->trace.plane.normal);
+      tw->trace.plane.dist = bestplane[3];
     }
-    if (borderId < facet->numBorders) continue;
-    // never clip against the back side
-    if (hitnum == facet->numBorders - 1) continue;
+  }
+}
 
-    if (enterFrac < leaveFrac && enterFrac >= 0) {
-      if (enterFrac < tw->trace.fraction) {
-        if (col.dbg.surfUpdate) {
-          debugPatchCollide = pc;
-          debugFacet        = facet;
-        }
-        tw->trace.fraction = enterFrac;
-        GVec3Copy(bestplane, tw->trace.plane.normal);
-        tw->trace.plane.dist = bestplane[3];
-      }
+//..................
+// CM_TraceThroughPatchCollide
+//   Checks if the given trace data (TraceWork) passes through any of the given patch facets
+//   Packed patches only visit the facets of the blocks touched by the trace (CM_FacetBVHBlocks),
+//   and skip the facets that the trace is completely in front of (CM_PatchFacetHits)
+//..................
+void CM_TraceThroughPatchCollide(TraceWork* tw, const PatchCol* pc) {
+  if (!CM_BoundsIntersect(tw->bounds[0], tw->bounds[1], pc->bounds[0], pc->bounds[1])) { return; }
+  if (tw->isPoint) {
+    CM_TracePointThroughPatchCollide(tw, pc);
+    return;
+  }
+  if (CM_UsePatchKernels(pc)) {
+    i32 blocks[MAX_FACETS / SIMD_LANES];
+    i32 numBlocks = CM_FacetBVHBlocks(tw, pc, blocks);
+    for (i32 i = 0; i < numBlocks; i++) {
+      i32 first = blocks[i] * SIMD_LANES;
+      for (u32 hits = CM_PatchFacetHits(tw, pc, first); hits; hits &= hits - 1) { CM_TraceThroughFacet(tw, pc, &pc->facets[first + __builtin_ctz(hits)]); }
     }
+    return;
   }
+  for (i32 facetId = 0; facetId < pc->numFacets; facetId++) { CM_TraceThroughFacet(tw, pc, &pc->facets[facetId]); }
 }
 
 
 //..................
 // CM_TraceThroughPatch
 //   Checks if the given trace data (TraceWork) passes through any of the given clipPatch facets
-//   Increases the c_patch_traces counter
+//   Increases the c_patch_traces counter, or the counter of the query context
 //..................
 static void CM_TraceThroughPatch(TraceWork* tw, const cPatch* patch) {
-  c_patch_traces++;
+  if (tw->query) {
+    tw->query->patchTraces++;
+  } else {
+    c_patch_traces++;
+  }
   f32 oldFrac = tw->trace.fraction;
 
   CM_TraceThroughPatchCollide(tw, patch->pc);
@@ -229,32 +252,58 @@ static void CM_TraceThroughPatch(TraceWork* tw, const cPatch* patch) {
 }
 
 //..................
-// CM_TraceThroughBrush
+// CM_TraceThroughBrushSides
 //   Checks if the given trace data (TraceWork) passes through any of the given clipBrush planes
-//   Increases the c_brush_traces counter
+//   Specialized for each trace mode (traceMode_t): the point traces skip the plane expansion, and only capsules find their closest point
+//   The box traces of a registered hull (TRACE_MODE_HULL) are point traces against its expanded sides, and read the brush sides only for their result
+//   Also specialized for the side width of the brush (cBrush.sideBits), so the side loop reads its planes without checking it
+//   Increases the c_brush_traces counter, or the counter of the query context
 //..................
-static void CM_TraceThroughBrush(TraceWork* tw, const cBrush* brush) {
+CM_SPECIALIZED void CM_TraceThroughBrushSides(TraceWork* tw, const cBrush* brush, const i32 mode, const i32 bits) {
   if (!brush->numsides) { return; }
-  c_brush_traces++;
+  if (tw->query) {
+    tw->query->brushTraces++;
+  } else {
+    c_brush_traces++;
+  }
 
   bool getout       = false;
   bool startout     = false;
 
-  f32     enterFrac = -1.0;
-  f32     leaveFrac = 1.0;
-  cPlane* clipplane = NULL;
-  cBSide* leadside  = NULL;
-  vec3    startp;
-  vec3    endp;
-  cBSide* side;
-  cPlane* plane;
-  if (tw->sphere.use) {
-    // compare the trace against all planes of the brush
-    // find the latest time the trace crosses a plane towards the interior
-    // and the earliest time the trace crosses a plane towards the exterior
-    for (i32 sideId = 0; sideId < brush->numsides; sideId++) {
-      side     = brush->sides + sideId;
-      plane    = side->plane;
+  f32               enterFrac = -1.0;
+  f32               leaveFrac = 1.0;
+  i32               leadside  = -1;
+  vec3              startp;
+  vec3              endp;
+  f32               d1, d2;
+  const cHullPlane* hullPlanes = (mode == TRACE_MODE_HULL) ? &tw->hull->planes[brush->hullSide] : NULL;
+  // packed brushes get the distances to all their sides at once, from the vectorized kernels
+  f32               dists[2][MAX_SIMD_BRUSH_SIDES];
+  bool              packed = mode != TRACE_MODE_HULL && CM_UseSideKernels(brush);
+  if (packed) {
+    bool touched;
+    if (mode == TRACE_MODE_CAPSULE) {
+      touched = CM_TraceSphereSideDists(tw, brush, dists[0], dists[1]);
+    } else if (mode == TRACE_MODE_POINT) {
+      touched = CM_TracePointSideDists(tw, brush, dists[0], dists[1]);
+    } else {
+      touched = CM_TraceSideDists(tw, brush, dists[0], dists[1]);
+    }
+    if (!touched) { return; }  // completely in front of a face
+  }
+  // compare the trace against all planes of the brush
+  // find the latest time the trace crosses a plane towards the interior
+  // and the earliest time the trace crosses a plane towards the exterior
+  for (i32 sideId = 0; sideId < brush->numsides; sideId++) {
+    if (packed) {
+      d1 = dists[0][sideId];
+      d2 = dists[1][sideId];
+    } else if (mode == TRACE_MODE_HULL) {
+      // the side is already expanded by the box, so it is crossed like a point
+      d1 = GVec3Dot(tw->start, hullPlanes[sideId].normal) - hullPlanes[sideId].dist;
+      d2 = GVec3Dot(tw->end, hullPlanes[sideId].normal) - hullPlanes[sideId].dist;
+    } else if (mode == TRACE_MODE_CAPSULE) {
+      const cPlane* plane = CM_SideBitsPlane(brush, sideId, bits);
       // adjust the plane distance appropriately for radius
       f32 dist = plane->dist + tw->sphere.radius;
       // find the closest point on the capsule to the plane
@@ -266,61 +315,38 @@ static void CM_TraceThroughBrush(TraceWork* tw, const cBrush* brush) {
         DVec3Add(tw->start, tw->sphere.offset, startp);
         DVec3Add(tw->end, tw->sphere.offset, endp);
       }
-      f32 d1 = GVec3Dot(startp, plane->normal) - dist;
-      f32 d2 = GVec3Dot(endp, plane->normal) - dist;
-      if (d2 > 0) { getout = true; }  // endpoint is not in solid
-      if (d1 > 0) { startout = true; }
-      // if completely in front of face, no intersection with the entire brush
-      if (d1 > 0 && (d2 >= SURFACE_CLIP_EPSILON || d2 >= d1)) { return; }
-      // if it doesn't cross the plane, the plane isn't relevant
-      if (d1 <= 0 && d2 <= 0) { continue; }
-      // crosses face
-      if (d1 > d2) {  // enter
-        f32 f = (d1 - SURFACE_CLIP_EPSILON) / (d1 - d2);
-        if (f < 0) { f = 0; }
-        if (f > enterFrac) {
-          enterFrac = f;
-          clipplane = plane;
-          leadside  = side;
-        }
-      } else {  // leave
-        f32 f = (d1 + SURFACE_CLIP_EPSILON) / (d1 - d2);
-        if (f > 1) { f = 1; }
-        if (f < leaveFrac) { leaveFrac = f; }
-      }
-    }
-  } else {
-    // compare the trace against all planes of the brush
-    // find the latest time the trace crosses a plane towards the interior
-    // and the earliest time the trace crosses a plane towards the exterior
-    for (i32 sideId = 0; sideId < brush->numsides; sideId++) {
-      side     = brush->sides + sideId;
-      plane    = side->plane;
-
+      d1 = GVec3Dot(startp, plane->normal) - dist;
+      d2 = GVec3Dot(endp, plane->normal) - dist;
+    } else if (mode == TRACE_MODE_POINT) {
+      // a point has no mins/maxs to adjust the plane distance for
+      const cPlane* plane = CM_SideBitsPlane(brush, sideId, bits);
+      d1                  = GVec3Dot(tw->start, plane->normal) - plane->dist;
+      d2                  = GVec3Dot(tw->end, plane->normal) - plane->dist;
+    } else {
       // adjust the plane distance appropriately for mins/maxs
-      f32 dist = plane->dist - GVec3Dot(tw->offsets[plane->signbits], plane->normal);
-      f32 d1   = GVec3Dot(tw->start, plane->normal) - dist;
-      f32 d2   = GVec3Dot(tw->end, plane->normal) - dist;
-      if (d2 > 0) { getout = true; }  // endpoint is not in solid
-      if (d1 > 0) { startout = true; }
-      // if completely in front of face, no intersection with the entire brush
-      if (d1 > 0 && (d2 >= SURFACE_CLIP_EPSILON || d2 >= d1)) { return; }
-      // if it doesn't cross the plane, the plane isn't relevant
-      if (d1 <= 0 && d2 <= 0) { continue; }
-      // crosses face
-      if (d1 > d2) {  // enter
-        f32 f = (d1 - SURFACE_CLIP_EPSILON) / (d1 - d2);
-        if (f < 0) { f = 0; }
-        if (f > enterFrac) {
-          enterFrac = f;
-          clipplane = plane;
-          leadside  = side;
-        }
-      } else {  // leave
-        f32 f = (d1 + SURFACE_CLIP_EPSILON) / (d1 - d2);
-        if (f > 1) { f = 1; }
-        if (f < leaveFrac) { leaveFrac = f; }
+      const cPlane* plane = CM_SideBitsPlane(brush, sideId, bits);
+      f32           dist  = plane->dist - GVec3Dot(tw->offsets[plane->signbits], plane->normal);
+      d1                  = GVec3Dot(tw->start, plane->normal) - dist;
+      d2                  = GVec3Dot(tw->end, plane->normal) - dist;
+    }
+    if (d2 > 0) { getout = true; }  // endpoint is not in solid
+    if (d1 > 0) { startout = true; }
+    // if completely in front of face, no intersection with the entire brush
+    if (d1 > 0 && (d2 >= SURFACE_CLIP_EPSILON || d2 >= d1)) { return; }
+    // if it doesn't cross the plane, the plane isn't relevant
+    if (d1 <= 0 && d2 <= 0) { continue; }
+    // crosses face
+    if (d1 > d2) {  // enter
+      f32 f = (d1 - SURFACE_CLIP_EPSILON) / (d1 - d2);
+      if (f < 0) { f = 0; }
+      if (f > enterFrac) {
+        enterFrac = f;
+        leadside  = sideId;
       }
+    } else {  // leave
+      f32 f = (d1 + SURFACE_CLIP_EPSILON) / (d1 - d2);
+      if (f > 1) { f = 1; }
+      if (f < leaveFrac) { leaveFrac = f; }
     }
   }
 
@@ -339,40 +365,177 @@ static void CM_TraceThroughBrush(TraceWork* tw, const cBrush* brush) {
     if (enterFrac > -1 && enterFrac < tw->trace.fraction) {
       if (enterFrac < 0) { enterFrac = 0; }
       tw->trace.fraction = enterFrac;
-      if (clipplane != NULL) { tw->trace.plane = *clipplane; }
-      if (leadside != NULL) { tw->trace.surfaceFlags = leadside->surfaceFlags; }
+      if (leadside >= 0) {
+        tw->trace.plane        = *CM_SideBitsPlane(brush, leadside, bits);
+        tw->trace.surfaceFlags = CM_SideBitsSurfaceFlags(brush, leadside, bits);
+      }
       tw->trace.contents = brush->contents;
     }
   }
 }
+//..................
+// CM_TraceThroughBrush
+//   Calls the CM_TraceThroughBrushSides specialization for the side width of the brush,
+//   or the one of the registered hull for the box traces of its size
+//..................
+CM_SPECIALIZED void CM_TraceThroughBrush(TraceWork* tw, const cBrush* brush, const i32 mode) {
+  if (mode == TRACE_MODE_BOX && tw->hull && brush->hullSide >= 0) {
+    CM_TraceThroughBrushSides(tw, brush, TRACE_MODE_HULL, brush->sideBits);  // the width is only needed for the result
+  } else if (!brush->sideBits) {
+    CM_TraceThroughBrushSides(tw, brush, mode, 0);
+  } else if (brush->sideBits == 16) {
+    CM_TraceThroughBrushSides(tw, brush, mode, 16);
+  } else {
+    CM_TraceThroughBrushSides(tw, brush, mode, 32);
+  }
+}
+
+//..................
+// CM_TraceThroughBox
+//   Checks if the given trace data (TraceWork) passes through the axial box mins/maxs, without building a box hull for it
+//   Same result as CM_TraceThroughBrush on the brush of a temporary box model (CM_TempBoxModel): its six sides are crossed
+//   in the same order (+x -x +y -y +z -z) with the same arithmetic, and the plane of the result is the same box hull plane
+//   Doesn't read or write the box hull state, so it also works for boxes that don't have a handle
+//   Increases the c_brush_traces counter, or the counter of the query context
+//..................
+static void CM_TraceThroughBox(TraceWork* tw, const vec3 mins, const vec3 maxs) {
+  if (!(CONTENTS_BODY & tw->contents)) { return; }
+  if (!CM_BoundsIntersect(tw->bounds[0], tw->bounds[1], mins, maxs)) { return; }
+  if (tw->query) {
+    tw->query->brushTraces++;
+  } else {
+    c_brush_traces++;
+  }
+
+  bool getout    = false;
+  bool startout  = false;
+  f32  enterFrac = -1.0;
+  f32  leaveFrac = 1.0;
+  i32  clipSide  = -1;
+  vec3 startp;
+  vec3 endp;
+  f32  d1, d2;
+  // find the latest time the trace crosses a side towards the interior
+  // and the earliest time the trace crosses a side towards the exterior
+  for (i32 sideId = 0; sideId < 6; sideId++) {
+    i32  axis = sideId >> 1;
+    bool back = sideId & 1;  // side facing the negative axis, with a plane distance of -mins
+    if (tw->sphere.use) {
+      // adjust the plane distance appropriately for radius
+      f32 dist = (back ? -mins[axis] : maxs[axis]) + tw->sphere.radius;
+      // find the closest point on the capsule to the plane
+      f32 t    = back ? -tw->sphere.offset[axis] : tw->sphere.offset[axis];
+      if (t > 0) {
+        DVec3Sub(tw->start, tw->sphere.offset, startp);
+        DVec3Sub(tw->end, tw->sphere.offset, endp);
+      } else {
+        DVec3Add(tw->start, tw->sphere.offset, startp);
+        DVec3Add(tw->end, tw->sphere.offset, endp);
+      }
+      d1 = (back ? -startp[axis] : startp[axis]) - dist;
+      d2 = (back ? -endp[axis] : endp[axis]) - dist;
+    } else {
+      // adjust the plane distance appropriately for mins/maxs
+      f32 dist = back ? -mins[axis] + tw->size[1][axis] : maxs[axis] - tw->size[0][axis];
+      d1       = (back ? -tw->start[axis] : tw->start[axis]) - dist;
+      d2       = (back ? -tw->end[axis] : tw->end[axis]) - dist;
+    }
+    if (d2 > 0) { getout = true; }  // endpoint is not in solid
+    if (d1 > 0) { startout = true; }
+    // if completely in front of face, no intersection with the entire box
+    if (d1 > 0 && (d2 >= SURFACE_CLIP_EPSILON || d2 >= d1)) { return; }
+    // if it doesn't cross the plane, the plane isn't relevant
+    if (d1 <= 0 && d2 <= 0) { continue; }
+    // crosses face
+    if (d1 > d2) {  // enter
+      f32 f = (d1 - SURFACE_CLIP_EPSILON) / (d1 - d2);
+      if (f < 0) { f = 0; }
+      if (f > enterFrac) {
+        enterFrac = f;
+        clipSide  = sideId;
+      }
+    } else {  // leave
+      f32 f = (d1 + SURFACE_CLIP_EPSILON) / (d1 - d2);
+      if (f > 1) { f = 1; }
+      if (f < leaveFrac) { leaveFrac = f; }
+    }
+  }
+
+  // all sides have been checked, and the trace was not completely outside the box
+  if (!startout) {  // original point was inside the box
+    tw->trace.startsolid = true;
+    if (!getout) {
+      tw->trace.allsolid = true;
+      tw->trace.fraction = 0;
+      tw->trace.contents = CONTENTS_BODY;
+    }
+    return;
+  }
+
+  if (enterFrac < leaveFrac) {
+    if (enterFrac > -1 && enterFrac < tw->trace.fraction) {
+      if (enterFrac < 0) { enterFrac = 0; }
+      tw->trace.fraction = enterFrac;
+      if (clipSide >= 0) {  // same plane as the box hull side (CM_SetupBoxHull)
+        i32     axis = clipSide >> 1;
+        bool    back = clipSide & 1;
+        cPlane* p    = &tw->trace.plane;
+        memset(p, 0, sizeof(*p));
+        p->normal[axis]        = back ? -1 : 1;
+        p->dist                = back ? -mins[axis] : maxs[axis];
+        p->type                = back ? 3 + axis : axis;
+        p->signbits            = back ? 1 << axis : 0;
+        tw->trace.surfaceFlags = 0;
+      }
+      tw->trace.contents = CONTENTS_BODY;
+    }
+  }
+}
 
 //..................
 // CM_TraceThroughLeaf
 //   Checks if the given trace data (TraceWork)
 //   passes through any of the given clipLeaf brushes or patches
+//   Specialized for each trace mode (traceMode_t), along with the brush tests inlined in it
+//   Increases the c_leaf_traces counter, or the counter of the query context
 //..................
-static void CM_TraceThroughLeaf(TraceWork* tw, const cLeaf* leaf) {
+CM_SPECIALIZED void CM_TraceThroughLeaf(TraceWork* tw, const cLeaf* leaf, const i32 mode) {
+  if (tw->query) {  // for statistics, may be zeroed
+    tw->query->leafTraces++;
+  } else {
+    c_leaf_traces++;
+  }
   // trace line against all brushes in the leaf
-  for (i32 leafBrushId = 0; leafBrushId < leaf->numLeafBrushes; leafBrushId++) {
-    i32     brushnum = cm.leafbrushes[leaf->firstLeafBrush + leafBrushId];
-    cBrush* b        = &cm.brushes[brushnum];
-    if (b->checkcount == cm.checkcount) { continue; }  // already checked this brush in another leaf
-    b->checkcount = cm.checkcount;
-    if (!(b->contents & tw->contents)) { continue; }
-    if (!CM_BoundsIntersect(tw->bounds[0], tw->bounds[1], b->bounds[0], b->bounds[1])) { continue; }
-    CM_TraceThroughBrush(tw, b);
-    if (!tw->trace.fraction) { return; }
+  if (CM_UseLeafKernels(leaf)) {
+    // packed leafs reject the brushes with other contents or out of bounds first, SIMD_LANES at a time.
+    // those never pass in any other leaf either, so leaving them unmarked doesn't change what is traced
+    for (i32 first = 0; first < leaf->numLeafBrushes; first += SIMD_LANES) {
+      for (u32 hits = CM_LeafBrushHits(tw, &leaf->blocks[first / SIMD_LANES]); hits; hits &= hits - 1) {
+        i32 brushnum = cm.leafbrushes[leaf->firstLeafBrush + first + __builtin_ctz(hits)];
+        if (CM_BrushChecked(tw, brushnum)) { continue; }  // already checked this brush in another leaf
+        CM_TraceThroughBrush(tw, &cm.brushes[brushnum], mode);
+        if (!tw->trace.fraction) { return; }
+      }
+    }
+  } else {
+    for (i32 leafBrushId = 0; leafBrushId < leaf->numLeafBrushes; leafBrushId++) {
+      i32     brushnum = cm.leafbrushes[leaf->firstLeafBrush + leafBrushId];
+      cBrush* b        = &cm.brushes[brushnum];
+      if (CM_BrushChecked(tw, brushnum)) { continue; }  // already checked this brush in another leaf
+      if (!(b->contents & tw->contents)) { continue; }
+      if (!CM_BoundsIntersect(tw->bounds[0], tw->bounds[1], b->bounds[0], b->bounds[1])) { continue; }
+      CM_TraceThroughBrush(tw, b, mode);
+      if (!tw->trace.fraction) { return; }
+    }
   }
 
   // trace line against all patches in the leaf
   if (col.doPatchCol) {
     for (i32 leafSurfId = 0; leafSurfId < leaf->numLeafSurfaces; leafSurfId++) {
-      cPatch* patch = cm.surfaces[cm.leafsurfaces[leaf->firstLeafSurface + leafSurfId]];
+      i32     surfnum = cm.leafsurfaces[leaf->firstLeafSurface + leafSurfId];
+      cPatch* patch   = cm.surfaces[surfnum];
       if (!patch) { continue; }
-      if (patch->checkcount == cm.checkcount) {
-        continue;  // already checked this patch in another leaf
-      }
-      patch->checkcount = cm.checkcount;
+      if (CM_PatchChecked(tw, surfnum)) { continue; }  // already checked this patch in another leaf
       if (!(patch->contents & tw->contents)) { continue; }
       CM_TraceThroughPatch(tw, patch);
       if (!tw->trace.fraction) { return; }
@@ -380,6 +543,35 @@ static void CM_TraceThroughLeaf(TraceWork* tw, const cLeaf* leaf) {
   }
 }
 
+//..................
+// CM_TracePointThroughLeaf, CM_TraceBoxThroughLeaf, CM_TraceCapsuleThroughLeaf
+//   CM_TraceThroughLeaf specializations
+//..................
+static void CM_TracePointThroughLeaf(TraceWork* tw, const cLeaf* leaf) { CM_TraceThroughLeaf(tw, leaf, TRACE_MODE_POINT); }
+static void CM_TraceBoxThroughLeaf(TraceWork* tw, const cLeaf* leaf) { CM_TraceThroughLeaf(tw, leaf, TRACE_MODE_BOX); }
+static void CM_TraceCapsuleThroughLeaf(TraceWork* tw, const cLeaf* leaf) { CM_TraceThroughLeaf(tw, leaf, TRACE_MODE_CAPSULE); }
+
+//..................
+// CM_TraceModeThroughLeaf
+//   Calls the CM_TraceThroughLeaf specialization of the given trace mode
+//..................
+CM_SPECIALIZED void CM_TraceModeThroughLeaf(TraceWork* tw, const cLeaf* leaf, const i32 mode) {
+  if (mode == TRACE_MODE_POINT) {
+    CM_TracePointThroughLeaf(tw, leaf);
+  } else if (mode == TRACE_MODE_CAPSULE) {
+    CM_TraceCapsuleThroughLeaf(tw, leaf);
+  } else {
+    CM_TraceBoxThroughLeaf(tw, leaf);
+  }
+}
+
+//..................
+// CM_TraceThroughModel
+//   Checks if the given trace data (TraceWork) passes through any of the given clipModel brushes or patches
+//   Temporary boxes are traced with CM_TraceThroughBox instead
+//..................
+static void CM_TraceThroughModel(TraceWork* tw, const cModel* cmod) { CM_TraceModeThroughLeaf(tw, &cmod->leaf, tw->mode); }
+
 //..................
 // CM_TraceThroughSphere
 //   Checks if the given trace data (TraceWork)
@@ -521,11 +713,9 @@ static void CM_TraceThroughVerticalCylinder(TraceWork* tw, const vec3 origin, f3
 
 //..................
 // CM_TraceCapsuleThroughCapsule
-//   capsule vs. capsule collision (not rotated)
+//   capsule vs. capsule collision (not rotated), against the capsule that fills the box mins/maxs
 //..................
-static void CM_TraceCapsuleThroughCapsule(TraceWork* tw, cHandle model) {
-  vec3 mins, maxs;
-  CM_ModelBounds(model, mins, maxs);
+static void CM_TraceCapsuleThroughCapsule(TraceWork* tw, const vec3 mins, const vec3 maxs) {
   // test trace bounds vs. capsule bounds
   if (tw->bounds[0][0] > maxs[0] + RADIUS_EPSILON || tw->bounds[0][1] > maxs[1] + RADIUS_EPSILON || tw->bounds[0][2] > maxs[2] + RADIUS_EPSILON
       || tw->bounds[1][0] < mins[0] - RADIUS_EPSILON || tw->bounds[1][1] < mins[1] - RADIUS_EPSILON || tw->bounds[1][2] < mins[2] - RADIUS_EPSILON) {
@@ -574,13 +764,9 @@ static void CM_TraceCapsuleThroughCapsule(TraceWork* tw, cHandle model) {
 
 //..................
 // CM_TraceBoundingBoxThroughCapsule
-//   bounding box vs. capsule collision
+//   bounding box vs. capsule collision, against the capsule that fills the box mins/maxs
 //..................
-static void CM_TraceBoundingBoxThroughCapsule(TraceWork* tw, cHandle model) {
-  // mins maxs of the capsule
-  vec3 mins, maxs;
-  CM_ModelBounds(model, mins, maxs);
-
+static void CM_TraceBoundingBoxThroughCapsule(TraceWork* tw, const vec3 mins, const vec3 maxs) {
   // offset for capsule center
   vec3 offset, size[2];
   for (i32 i = 0; i < 3; i++) {
@@ -597,11 +783,8 @@ static void CM_TraceBoundingBoxThroughCapsule(TraceWork* tw, cHandle model) {
   tw->sphere.halfHeight = size[1][2];
   GVec3Set(tw->sphere.offset, 0, 0, size[1][2] - tw->sphere.radius);
 
-  // replace the capsule with the bounding box
-  cHandle h    = CM_TempBoxModel(tw->size[0], tw->size[1], false);
-  // calculate collision
-  cModel* cmod = CM_ClipHandleToModel(h);
-  CM_TraceThroughLeaf(tw, &cmod->leaf);
+  // replace the capsule with the bounding box, and calculate collision
+  CM_TraceThroughBox(tw, tw->size[0], tw->size[1]);
 }
 
 
@@ -611,18 +794,23 @@ static void CM_TraceBoundingBoxThroughCapsule(TraceWork* tw, cHandle model) {
 //   If the trace is a point, they will be exactly in order,
 //   but for larger trace volumes it is possible to hit something in a later leaf
 //   with a smaller intercept fraction.
+//   Walks the tree with a fixed stack of the far sides still to visit, in the same order as the recursive walk,
+//   unless RECURSIVE_TREE_WALK is defined
 //..................
+#if defined RECURSIVE_TREE_WALK
 static void CM_TraceThroughTree(TraceWork* tw, i32 num, f32 p1f, f32 p2f, const vec3 p1, const vec3 p2) {
-  if (tw->trace.fraction <= p1f) { return; }  // already hit something nearer
+  if (tw->trace.fraction <= p1f) { return; }                 // already hit something nearer
+  if (!(CM_ColNodeContents(num) & tw->contents)) { return; }  // nothing under it can be hit
+  if (!CM_ColNodeTouches(num, tw->bounds)) { return; }        // the trace doesn't reach it
   // if < 0, we are in a leaf node
   if (num < 0) {
-    CM_TraceThroughLeaf(tw, &cm.leafs[-1 - num]);
+    CM_TraceModeThroughLeaf(tw, &tw->leafs[-1 - num], tw->mode);
     return;
   }
   // find the point distances to the separating plane
   // and the offset for the size of the box
-  cNode*  node  = cm.nodes + num;
-  cPlane* plane = node->plane;
+  i32           children[2];
+  const cPlane* plane = CM_GetColNode(num, children);
   // adjust the plane distance appropriately for mins/maxs
   f64 t1, t2, offset;
   if (plane->type < 3) {
@@ -634,6 +822,9 @@ static void CM_TraceThroughTree(TraceWork* tw, i32 num, f32 p1f, f32 p2f, const
     t2 = GVec3Dot(plane->normal, p2) - plane->dist;
     if (tw->isPoint) {
       offset = 0;
+    } else if (col.doExactOffset) {
+      // half extent of the box along the plane normal: the corner picked by the signbits is the furthest behind the plane
+      offset = -GVec3Dot(tw->offsets[plane->signbits], plane->normal);
     } else {
       // this is silly
       offset = 2048;
@@ -641,11 +832,11 @@ static void CM_TraceThroughTree(TraceWork* tw, i32 num, f32 p1f, f32 p2f, const
   }
   // see which sides we need to consider
   if (t1 >= offset + 1 && t2 >= offset + 1) {
-    CM_TraceThroughTree(tw, node->children[0], p1f, p2f, p1, p2);
+    CM_TraceThroughTree(tw, children[0], p1f, p2f, p1, p2);
     return;
   }
   if (t1 < -offset - 1 && t2 < -offset - 1) {
-    CM_TraceThroughTree(tw, node->children[1], p1f, p2f, p1, p2);
+    CM_TraceThroughTree(tw, children[1], p1f, p2f, p1, p2);
     return;
   }
   // put the crosspoint SURFACE_CLIP_EPSILON pixels on the near side
@@ -680,7 +871,8 @@ static void CM_TraceThroughTree(TraceWork* tw, i32 num, f32 p1f, f32 p2f, const
   mid[1] = p1[1] + frac * (p2[1] - p1[1]);
   mid[2] = p1[2] + frac * (p2[2] - p1[2]);
 
-  CM_TraceThroughTree(tw, node->children[side], p1f, midf, p1, mid);
+  CM_PrefetchColNode(children[side ^ 1]);
+  CM_TraceThroughTree(tw, children[side], p1f, midf, p1, mid);
 
   // go past the node
   if (frac2 < 0) {
@@ -695,210 +887,959 @@ static void CM_TraceThroughTree(TraceWork* tw, i32 num, f32 p1f, f32 p2f, const
   mid[1] = p1[1] + frac2 * (p2[1] - p1[1]);
   mid[2] = p1[2] + frac2 * (p2[2] - p1[2]);
 
-  CM_TraceThroughTree(tw, node->children[side ^ 1], midf, p2f, mid, p2);
+  CM_TraceThroughTree(tw, children[side ^ 1], midf, p2f, mid, p2);
+}
+#else
+//..................
+// Tree walk frame: one segment of the trace that still has to be walked from the given node
+typedef struct {
+  i32  num;
+  f32  p1f;
+  f32  p2f;
+  vec3 p1;
+  vec3 p2;
+} TraceFrame;
+static void CM_TraceThroughTree(TraceWork* tw, i32 num, f32 p1f, f32 p2f, const vec3 p1, const vec3 p2);
+//..................
+// CM_TraceModeThroughTree
+//   Body of the CM_TraceThroughTree specializations, one for each trace mode (traceMode_t)
+//   Point traces never pad the node planes, and the leafs are traced by the specialization of the same mode
+//..................
+CM_SPECIALIZED void CM_TraceModeThroughTree(TraceWork* tw, i32 num, f32 p1f, f32 p2f, const vec3 p1, const vec3 p2, const i32 mode) {
+  TraceFrame stack[MAX_TREE_STACK];
+  i32        depth = 0;
+  TraceFrame cur   = { .num = num, .p1f = p1f, .p2f = p2f };
+  GVec3Copy(p1, cur.p1);
+  GVec3Copy(p2, cur.p2);
+  while (true) {
+    // skip the segment when something nearer was already hit, when nothing under the node can be hit, or when the trace doesn't reach it.
+    // if < 0, we are in a leaf node. Either way, the walk goes on with the last far side left
+    bool skip = tw->trace.fraction <= cur.p1f || !(CM_ColNodeContents(cur.num) & tw->contents) || !CM_ColNodeTouches(cur.num, tw->bounds);
+    if (skip || cur.num < 0) {
+      if (!skip) { CM_TraceModeThroughLeaf(tw, &tw->leafs[-1 - cur.num], mode); }
+      if (!depth) { return; }
+      cur = stack[--depth];
+      continue;
+    }
+    // find the point distances to the separating plane
+    // and the offset for the size of the box
+    i32           children[2];
+    const cPlane* plane = CM_GetColNode(cur.num, children);
+    // adjust the plane distance appropriately for mins/maxs
+    f64 t1, t2, offset;
+    if (plane->type < 3) {
+      t1     = cur.p1[plane->type] - plane->dist;
+      t2     = cur.p2[plane->type] - plane->dist;
+      offset = tw->extents[plane->type];
+    } else {
+      t1 = GVec3Dot(plane->normal, cur.p1) - plane->dist;
+      t2 = GVec3Dot(plane->normal, cur.p2) - plane->dist;
+      if (mode == TRACE_MODE_POINT) {
+        offset = 0;
+      } else if (col.doExactOffset) {
+        // half extent of the box along the plane normal: the corner picked by the signbits is the furthest behind the plane
+        offset = -GVec3Dot(tw->offsets[plane->signbits], plane->normal);
+      } else {
+        // this is silly
+        offset = 2048;
+      }
+    }
+    // see which sides we need to consider
+    if (t1 >= offset + 1 && t2 >= offset + 1) {
+      cur.num = children[0];
+      continue;
+    }
+    if (t1 < -offset - 1 && t2 < -offset - 1) {
+      cur.num = children[1];
+      continue;
+    }
+    // put the crosspoint SURFACE_CLIP_EPSILON pixels on the near side
+    f32 idist;
+    i32 side;
+    f32 frac, frac2;
+    if (t1 < t2) {
+      idist = 1.0 / (t1 - t2);
+      side  = 1;
+      frac2 = (t1 + offset + SURFACE_CLIP_EPSILON) * idist;
+      frac  = (t1 - offset + SURFACE_CLIP_EPSILON) * idist;
+    } else if (t1 > t2) {
+      idist = 1.0 / (t1 - t2);
+      side  = 0;
+      frac2 = (t1 - offset - SURFACE_CLIP_EPSILON) * idist;
+      frac  = (t1 + offset + SURFACE_CLIP_EPSILON) * idist;
+    } else {
+      side  = 0;
+      frac  = 1;
+      frac2 = 0;
+    }
+    // move up to the node
+    if (frac < 0) {
+      frac = 0;
+    } else if (frac > 1) {
+      frac = 1;
+    }
+    // go past the node: the far side is walked after the whole near side, from the same segment
+    if (frac2 < 0) {
+      frac2 = 0;
+    } else if (frac2 > 1) {
+      frac2 = 1;
+    }
+    TraceFrame far;
+    far.num   = children[side ^ 1];
+    far.p1f   = cur.p1f + (cur.p2f - cur.p1f) * frac2;
+    far.p2f   = cur.p2f;
+    far.p1[0] = cur.p1[0] + frac2 * (cur.p2[0] - cur.p1[0]);
+    far.p1[1] = cur.p1[1] + frac2 * (cur.p2[1] - cur.p1[1]);
+    far.p1[2] = cur.p1[2] + frac2 * (cur.p2[2] - cur.p1[2]);
+    GVec3Copy(cur.p2, far.p2);
+
+    cur.num   = children[side];
+    cur.p2f   = cur.p1f + (cur.p2f - cur.p1f) * frac;
+    cur.p2[0] = cur.p1[0] + frac * (cur.p2[0] - cur.p1[0]);
+    cur.p2[1] = cur.p1[1] + frac * (cur.p2[1] - cur.p1[1]);
+    cur.p2[2] = cur.p1[2] + frac * (cur.p2[2] - cur.p1[2]);
+    if (depth < MAX_TREE_STACK) {
+      CM_PrefetchColNode(far.num);
+      stack[depth++] = far;
+    } else {  // stack is full: walk the near side in a new walk
+      CM_TraceThroughTree(tw, cur.num, cur.p1f, cur.p2f, cur.p1, cur.p2);
+      cur = far;
+    }
+  }
+}
+//..................
+// CM_TracePointThroughTree, CM_TraceBoxThroughTree, CM_TraceCapsuleThroughTree
+//   CM_TraceModeThroughTree specializations. CM_TraceThroughTree calls the one of the trace mode
+//..................
+static void CM_TracePointThroughTree(TraceWork* tw, i32 num, f32 p1f, f32 p2f, const vec3 p1, const vec3 p2) {
+  CM_TraceModeThroughTree(tw, num, p1f, p2f, p1, p2, TRACE_MODE_POINT);
+}
+static void CM_TraceBoxThroughTree(TraceWork* tw, i32 num, f32 p1f, f32 p2f, const vec3 p1, const vec3 p2) {
+  CM_TraceModeThroughTree(tw, num, p1f, p2f, p1, p2, TRACE_MODE_BOX);
 }
+static void CM_TraceCapsuleThroughTree(TraceWork* tw, i32 num, f32 p1f, f32 p2f, const vec3 p1, const vec3 p2) {
+  CM_TraceModeThroughTree(tw, num, p1f, p2f, p1, p2, TRACE_MODE_CAPSULE);
+}
+static void CM_TraceThroughTree(TraceWork* tw, i32 num, f32 p1f, f32 p2f, const vec3 p1, const vec3 p2) {
+  if (tw->mode == TRACE_MODE_POINT) {
+    CM_TracePointThroughTree(tw, num, p1f, p2f, p1, p2);
+  } else if (tw->mode == TRACE_MODE_CAPSULE) {
+    CM_TraceCapsuleThroughTree(tw, num, p1f, p2f, p1, p2);
+  } else {
+    CM_TraceBoxThroughTree(tw, num, p1f, p2f, p1, p2);
+  }
+}
+#endif  // RECURSIVE_TREE_WALK
 
+//..................
+// Swept volume of a trace, for the BVH walk
+typedef struct {
+  vec3 start;
+  vec3 dir;
+  vec3 inv;
+  vec3 lo, hi;  // volume around the segment point, padded by one unit
+} BVHSweep;
 
 //..................
-// CM_Trace
+// CM_BVHSweepHits
+//   Checks if the swept volume touches the given BVH node before the fraction maxf
+//   Stores the fraction where it starts touching the node into *nearf
 //..................
-static void CM_Trace(Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, const vec3 origin, i32 brushmask,
-                     bool capsule, const Sphere* sphere) {
-  cModel* cmod = CM_ClipHandleToModel(model);
+static inline bool CM_BVHSweepHits(const BVHSweep* s, const cBNode* node, f32 maxf, f32* nearf) {
+  f32 t0 = 0;
+  f32 t1 = maxf;
+  for (i32 i = 0; i < 3; i++) {
+    f32 lo = node->mins[i] - s->hi[i];
+    f32 hi = node->maxs[i] - s->lo[i];
+    if (s->dir[i] == 0) {
+      if (s->start[i] < lo || s->start[i] > hi) { return false; }
+      continue;
+    }
+    f32 a = (lo - s->start[i]) * s->inv[i];
+    f32 b = (hi - s->start[i]) * s->inv[i];
+    if (a > b) {
+      f32 tmp = a;
+      a       = b;
+      b       = tmp;
+    }
+    if (a > t0) { t0 = a; }
+    if (b < t1) { t1 = b; }
+    if (t0 > t1) { return false; }
+  }
+  *nearf = t0;
+  return true;
+}
 
-  cm.checkcount++;  // for multi-check avoidance
-  c_traces++;       // for statistics, may be zeroed
+//..................
+// CM_TraceThroughItems
+//   Checks if the given trace data (TraceWork) passes through any of the given brushes or patches (brush numbers, or -1-surfnum),
+//   for a BVH leaf or a gathered region (ColGather). Every item is listed once, so they are not marked as checked
+//   Same tests as CM_TraceThroughLeaf, specialized in the same way. Increases the same counters
+//..................
+CM_SPECIALIZED void CM_TraceThroughItems(TraceWork* tw, const i32* items, i32 count, const i32 mode) {
+  if (tw->query) {  // for statistics, may be zeroed
+    tw->query->leafTraces++;
+  } else {
+    c_leaf_traces++;
+  }
+  for (i32 i = 0; i < count; i++) {
+    i32 id = items[i];
+    if (id >= 0) {
+      cBrush* b = &cm.brushes[id];
+      if (!(b->contents & tw->contents)) { continue; }
+      if (!CM_BoundsIntersect(tw->bounds[0], tw->bounds[1], b->bounds[0], b->bounds[1])) { continue; }
+      CM_TraceThroughBrush(tw, b, mode);
+    } else {
+      if (!col.doPatchCol) { continue; }
+      cPatch* patch = cm.surfaces[-1 - id];
+      if (!(patch->contents & tw->contents)) { continue; }
+      CM_TraceThroughPatch(tw, patch);
+    }
+    if (!tw->trace.fraction) { return; }
+  }
+}
 
-  // fill in a default trace
-  TraceWork tw;
-  memset(&tw, 0, sizeof(tw));
-  tw.trace.fraction = 1;  // assume it goes the entire distance until shown otherwise
-  GVec3Copy(origin, tw.modelOrigin);
+//..................
+// CM_TraceThroughBVH
+//   Traverse all the BVH leafs touched by the swept volume, nearest child first
+//   Nodes that start further than the current fraction are skipped, so the walk stops early once something near is hit
+//   Every brush is tested at most once, so ties between brushes can resolve to another plane than the BSP walk
+//..................
+static void CM_TraceThroughBVH(TraceWork* tw) {
+  if (!cm.bvhNodes) { return; }
+  BVHSweep s;
+  for (i32 i = 0; i < 3; i++) {
+    s.start[i] = tw->start[i];
+    s.dir[i]   = tw->end[i] - tw->start[i];
+    s.inv[i]   = s.dir[i] ? 1.0f / s.dir[i] : 0;
+    s.lo[i]    = tw->bounds[0][i] - ((tw->start[i] < tw->end[i]) ? tw->start[i] : tw->end[i]) - 1;
+    s.hi[i]    = tw->bounds[1][i] - ((tw->start[i] < tw->end[i]) ? tw->end[i] : tw->start[i]) + 1;
+  }
 
-  if (!cm.numNodes) {
-    *results = tw.trace;
-    return;  // map not loaded, shouldn't happen
+  i32 stack[MAX_BVH_DEPTH];
+  f32 stackf[MAX_BVH_DEPTH];
+  i32 depth = 0;
+  i32 num   = 0;
+  f32 nearf[2];
+  if (!CM_BVHSweepHits(&s, &cm.bvhNodes[0], tw->trace.fraction, &nearf[0])) { return; }
+  for (;;) {
+    const cBNode* node = &cm.bvhNodes[num];
+    if (node->count) {
+      const i32* items = &cm.bvhItems[node->first];
+      if (tw->mode == TRACE_MODE_POINT) {
+        CM_TraceThroughItems(tw, items, node->count, TRACE_MODE_POINT);
+      } else if (tw->mode == TRACE_MODE_CAPSULE) {
+        CM_TraceThroughItems(tw, items, node->count, TRACE_MODE_CAPSULE);
+      } else {
+        CM_TraceThroughItems(tw, items, node->count, TRACE_MODE_BOX);
+      }
+    } else {
+      i32  child[2] = { num + 1, node->first };
+      bool hit0     = CM_BVHSweepHits(&s, &cm.bvhNodes[child[0]], tw->trace.fraction, &nearf[0]);
+      bool hit1     = CM_BVHSweepHits(&s, &cm.bvhNodes[child[1]], tw->trace.fraction, &nearf[1]);
+      if (hit0 && hit1) {
+        i32 side        = nearf[1] < nearf[0];
+        stack[depth]    = child[side ^ 1];
+        stackf[depth++] = nearf[side ^ 1];
+        num             = child[side];
+        continue;
+      }
+      if (hit0 || hit1) {
+        num = hit0 ? child[0] : child[1];
+        continue;
+      }
+    }
+    // go back to the nearest far child that still starts before the fraction
+    do {
+      if (!depth) { return; }
+      depth--;
+    } while (stackf[depth] > tw->trace.fraction);
+    num = stack[depth];
   }
+}
 
+//..................
+// CM_GatherCovers
+//   Returns true when the trace can test the items of its gathered region (tw->gather) instead of walking the world:
+//   the region was gathered on the loaded map, with every contents bit of the trace, and the swept box stays inside it
+//..................
+static bool CM_GatherCovers(const TraceWork* tw) {
+  const ColGather* g = tw->gather;
+  if (!g || g->checksum != cm.checksum || (tw->contents & ~g->contents)) { return false; }
+  for (i32 i = 0; i < 3; i++) {
+    if (tw->bounds[0][i] < g->bounds[0][i] || tw->bounds[1][i] > g->bounds[1][i]) { return false; }
+  }
+  return true;
+}
+
+//..................
+// CM_TraceThroughGather
+//   Sweeps the trace data (TraceWork) through the items of its gathered region, with the CM_TraceThroughItems specialization of its mode
+//   The items are tested in the order they were gathered, so ties between brushes can resolve to another plane than the tree walk
+//..................
+static void CM_TraceThroughGather(TraceWork* tw) {
+  const ColGather* g = tw->gather;
+  if (tw->mode == TRACE_MODE_POINT) {
+    CM_TraceThroughItems(tw, g->items, g->count, TRACE_MODE_POINT);
+  } else if (tw->mode == TRACE_MODE_CAPSULE) {
+    CM_TraceThroughItems(tw, g->items, g->count, TRACE_MODE_CAPSULE);
+  } else {
+    CM_TraceThroughItems(tw, g->items, g->count, TRACE_MODE_BOX);
+  }
+}
+
+//..................
+// CM_PacketSegment
+//   Stores the near (p1 to frac) or the far (frac to p2) part of the `lane` segment of `seg` into the same lane of `out`
+//   Same operations as CM_TraceThroughTree
+//..................
+static inline void CM_PacketSegment(RaySegments* out, const RaySegments* seg, i32 lane, f32 frac, bool far) {
+  f32 midf = seg->p1f[lane] + (seg->p2f[lane] - seg->p1f[lane]) * frac;
+  for (i32 axis = 0; axis < 3; axis++) {
+    f32 mid             = seg->p1[axis][lane] + frac * (seg->p2[axis][lane] - seg->p1[axis][lane]);
+    out->p1[axis][lane] = far ? mid : seg->p1[axis][lane];
+    out->p2[axis][lane] = far ? seg->p2[axis][lane] : mid;
+  }
+  out->p1f[lane] = far ? midf : seg->p1f[lane];
+  out->p2f[lane] = far ? seg->p2f[lane] : midf;
+}
+
+//..................
+// CM_PacketCopySegment
+//   Copies the `lane` segment of `seg` into the same lane of `out`
+//..................
+static inline void CM_PacketCopySegment(RaySegments* out, const RaySegments* seg, i32 lane) {
+  for (i32 axis = 0; axis < 3; axis++) {
+    out->p1[axis][lane] = seg->p1[axis][lane];
+    out->p2[axis][lane] = seg->p2[axis][lane];
+  }
+  out->p1f[lane] = seg->p1f[lane];
+  out->p2f[lane] = seg->p2f[lane];
+}
+
+//..................
+// CM_TracePacketThroughTree
+//   Same as CM_TraceThroughTree, for a packet of point traces (tws[lane]) walked together
+//   `mask` are the rays of the packet that still reach this node, each one with its own segment in `seg`
+//   Rays that stay on the same side of the node plane keep their segment, and the packet is only split when they diverge.
+//   Every ray visits its leafs in the exact order of its own CM_TraceThroughTree walk
+//..................
+static void CM_TracePacketThroughTree(TraceWork* tws, u32 mask, i32 num, const RaySegments* seg) {
+  for (u32 bits = mask; bits; bits &= bits - 1) {
+    i32 lane = __builtin_ctz(bits);
+    if (tws[lane].trace.fraction <= seg->p1f[lane]) { mask &= ~(1u << lane); }     // already hit something nearer
+    if (!CM_ColNodeTouches(num, tws[lane].bounds)) { mask &= ~(1u << lane); }  // the ray doesn't reach it
+  }
+  if (!mask) { return; }
+  if (!(CM_ColNodeContents(num) & tws[__builtin_ctz(mask)].contents)) { return; }  // nothing under it can be hit, the rays share their brushmask
+  // if < 0, we are in a leaf node
+  if (num < 0) {
+    for (u32 bits = mask; bits; bits &= bits - 1) {
+      TraceWork* tw = &tws[__builtin_ctz(bits)];
+      CM_TracePointThroughLeaf(tw, &tw->leafs[-1 - num]);
+    }
+    return;
+  }
+  // find the side of the separating plane of every ray, and the crosspoints of the rays that cross it
+  i32           children[2];
+  const cPlane* plane = CM_GetColNode(num, children);
+  PacketSplit   split;
+  CM_PacketPlaneSides(plane, seg, mask, &split);
+  // no ray crosses the plane: each side keeps its segments
+  if (!(split.near[0] | split.near[1])) {
+    if (split.front) { CM_TracePacketThroughTree(tws, split.front, children[0], seg); }
+    if (split.back) { CM_TracePacketThroughTree(tws, split.back, children[1], seg); }
+    return;
+  }
+  // near side of the rays that start in front, and the rays that are only in front
+  RaySegments child;
+  for (u32 bits = split.front | split.back; bits; bits &= bits - 1) { CM_PacketCopySegment(&child, seg, __builtin_ctz(bits)); }
+  for (u32 bits = split.near[0] | split.near[1]; bits; bits &= bits - 1) {
+    i32 lane = __builtin_ctz(bits);
+    CM_PacketSegment(&child, seg, lane, split.frac[lane], false);
+  }
+  if (split.near[0] | split.front) { CM_TracePacketThroughTree(tws, split.near[0] | split.front, children[0], &child); }
+  // far side of the rays that started in front, near side of the rays that start behind, and the rays that are only behind
+  for (u32 bits = split.near[0]; bits; bits &= bits - 1) {
+    i32 lane = __builtin_ctz(bits);
+    CM_PacketSegment(&child, seg, lane, split.frac2[lane], true);
+  }
+  CM_TracePacketThroughTree(tws, split.near[0] | split.near[1] | split.back, children[1], &child);
+  // far side of the rays that started behind
+  if (!split.near[1]) { return; }
+  for (u32 bits = split.near[1]; bits; bits &= bits - 1) {
+    i32 lane = __builtin_ctz(bits);
+    CM_PacketSegment(&child, seg, lane, split.frac2[lane], true);
+  }
+  CM_TracePacketThroughTree(tws, split.near[1], children[0], &child);
+}
+
+
+//..................
+// CM_FindHull
+//   Returns the registered hull of the given symetric box size, or NULL when there is none
+//..................
+static const cHull* CM_FindHull(const vec3 size[2]) {
+  for (i32 hullId = 0; hullId < cm.numHulls; hullId++) {
+    const cHull* hull = &cm.hulls[hullId];
+    if (!memcmp(hull->size, size, sizeof(hull->size))) { return hull; }
+  }
+  return NULL;
+}
+
+//..................
+// CM_TraceHull
+//   Fills the hull dependent part of the trace data (TraceWork)
+//   This is the same for every trace swept with the same mins/maxs, so batches only compute it once per hull
+//   Returns the offset that makes mins and maxs symetric in `offset`
+//..................
+static void CM_TraceHull(TraceWork* tw, vec3 offset, const vec3 mins, const vec3 maxs, bool capsule, const Sphere* sphere) {
   // allow NULL to be passed in for 0,0,0
   if (!mins) { mins = vec3_origin; }
   if (!maxs) { maxs = vec3_origin; }
 
-  // set basic parms
-  tw.contents = brushmask;
-
   // adjust so that mins and maxs are always symetric
   // avoids some complications with plane expanding of rotated bmodels
-  vec3 offset;
   for (i32 i = 0; i < 3; i++) {
-    offset[i]     = (mins[i] + maxs[i]) * 0.5;
-    tw.size[0][i] = mins[i] - offset[i];
-    tw.size[1][i] = maxs[i] - offset[i];
-    tw.start[i]   = start[i] + offset[i];
-    tw.end[i]     = end[i] + offset[i];
+    offset[i]      = (mins[i] + maxs[i]) * 0.5;
+    tw->size[0][i] = mins[i] - offset[i];
+    tw->size[1][i] = maxs[i] - offset[i];
   }
 
   // if a sphere is already specified
   if (sphere) {
-    tw.sphere = *sphere;
+    tw->sphere = *sphere;
   } else {
-    tw.sphere.use        = capsule;
-    tw.sphere.radius     = (tw.size[1][0] > tw.size[1][2]) ? tw.size[1][2] : tw.size[1][0];
-    tw.sphere.halfHeight = tw.size[1][2];
-    GVec3Set(tw.sphere.offset, 0, 0, tw.size[1][2] - tw.sphere.radius);
+    tw->sphere.use        = capsule;
+    tw->sphere.radius     = (tw->size[1][0] > tw->size[1][2]) ? tw->size[1][2] : tw->size[1][0];
+    tw->sphere.halfHeight = tw->size[1][2];
+    GVec3Set(tw->sphere.offset, 0, 0, tw->size[1][2] - tw->sphere.radius);
   }
 
-  tw.maxOffset     = tw.size[1][0] + tw.size[1][1] + tw.size[1][2];
+  tw->maxOffset     = tw->size[1][0] + tw->size[1][1] + tw->size[1][2];
+  tw->hull          = tw->sphere.use ? NULL : CM_FindHull(tw->size);
+
+  // tw->offsets[signbits] = vector to appropriate corner from origin
+  tw->offsets[0][0] = tw->size[0][0];
+  tw->offsets[0][1] = tw->size[0][1];
+  tw->offsets[0][2] = tw->size[0][2];
+
+  tw->offsets[1][0] = tw->size[1][0];
+  tw->offsets[1][1] = tw->size[0][1];
+  tw->offsets[1][2] = tw->size[0][2];
 
-  // tw.offsets[signbits] = vector to appropriate corner from origin
-  tw.offsets[0][0] = tw.size[0][0];
-  tw.offsets[0][1] = tw.size[0][1];
-  tw.offsets[0][2] = tw.size[0][2];
+  tw->offsets[2][0] = tw->size[0][0];
+  tw->offsets[2][1] = tw->size[1][1];
+  tw->offsets[2][2] = tw->size[0][2];
 
-  tw.offsets[1][0] = tw.size[1][0];
-  tw.offsets[1][1] = tw.size[0][1];
-  tw.offsets[1][2] = tw.size[0][2];
+  tw->offsets[3][0] = tw->size[1][0];
+  tw->offsets[3][1] = tw->size[1][1];
+  tw->offsets[3][2] = tw->size[0][2];
 
-  tw.offsets[2][0] = tw.size[0][0];
-  tw.offsets[2][1] = tw.size[1][1];
-  tw.offsets[2][2] = tw.size[0][2];
+  tw->offsets[4][0] = tw->size[0][0];
+  tw->offsets[4][1] = tw->size[0][1];
+  tw->offsets[4][2] = tw->size[1][2];
 
-  tw.offsets[3][0] = tw.size[1][0];
-  tw.offsets[3][1] = tw.size[1][1];
-  tw.offsets[3][2] = tw.size[0][2];
+  tw->offsets[5][0] = tw->size[1][0];
+  tw->offsets[5][1] = tw->size[0][1];
+  tw->offsets[5][2] = tw->size[1][2];
+
+  tw->offsets[6][0] = tw->size[0][0];
+  tw->offsets[6][1] = tw->size[1][1];
+  tw->offsets[6][2] = tw->size[1][2];
+
+  tw->offsets[7][0] = tw->size[1][0];
+  tw->offsets[7][1] = tw->size[1][1];
+  tw->offsets[7][2] = tw->size[1][2];
+}
+
+//..................
+// CM_BuildHull
+//   Expands the sides of every brush of the loaded map by the given box, unless a hull of the same symetric size is already built
+//   Each expanded dist is computed with the same f32 operations as the box traces do for each side, so that the results don't change
+//..................
+static void CM_BuildHull(const LoadHull* box) {
+  TraceWork tw;
+  vec3      offset;
+  memset(&tw, 0, sizeof(tw));
+  CM_TraceHull(&tw, offset, box->mins, box->maxs, false, NULL);
+  if (tw.hull || cm.numHulls == MAX_HULLS) { return; }
+  cHull* hull = &cm.hulls[cm.numHulls++];
+  GVec3Copy(tw.size[0], hull->size[0]);
+  GVec3Copy(tw.size[1], hull->size[1]);
+  hull->planes = Hunk_Alloc(cm.numHullSides * sizeof(*hull->planes), h_high);
+  for (i32 brushnum = 0; brushnum < cm.numBrushes; brushnum++) {
+    const cBrush* brush = &cm.brushes[brushnum];
+    cHullPlane*   out   = &hull->planes[brush->hullSide];
+    for (i32 sideId = 0; sideId < brush->numsides; sideId++) {
+      const cPlane* plane = CM_SidePlane(brush, sideId);
+      GVec3Copy(plane->normal, out[sideId].normal);
+      out[sideId].dist = plane->dist - GVec3Dot(tw.offsets[plane->signbits], plane->normal);
+    }
+  }
+}
 
-  tw.offsets[4][0] = tw.size[0][0];
-  tw.offsets[4][1] = tw.size[0][1];
-  tw.offsets[4][2] = tw.size[1][2];
+//..................
+// CM_BuildHulls
+//   Numbers the sides of all the brushes of the loaded map, and builds the expanded sides of every box size of load.hulls
+//..................
+void CM_BuildHulls(void) {
+  cm.numHullSides = 0;
+  for (i32 brushnum = 0; brushnum < cm.numBrushes; brushnum++) {
+    cm.brushes[brushnum].hullSide = cm.numHullSides;
+    cm.numHullSides += cm.brushes[brushnum].numsides;
+  }
+  for (i32 i = 0; i < load.numHulls; i++) { CM_BuildHull(&load.hulls[i]); }
+}
 
-  tw.offsets[5][0] = tw.size[1][0];
-  tw.offsets[5][1] = tw.size[0][1];
-  tw.offsets[5][2] = tw.size[1][2];
+//..................
+// CM_RegisterHull
+//   Registers the box size used by most traces (eg: standing and crouched players), like the clip hulls of Quake 1
+//   The sides of every brush are expanded by it at load, so that the box traces and position tests of that size are point traces against them,
+//   with the same results. The tree walks still pad the node planes by the box, and capsules and patches keep their own tests
+//   Builds it for the loaded map too. The size is kept in load.hulls until CM_InitCfg
+//   Returns false when MAX_HULLS sizes are already registered
+//..................
+bool CM_RegisterHull(const vec3 mins, const vec3 maxs) {
+  for (i32 i = 0; i < load.numHulls; i++) {
+    if (!memcmp(load.hulls[i].mins, mins, sizeof(vec3)) && !memcmp(load.hulls[i].maxs, maxs, sizeof(vec3))) { return true; }
+  }
+  if (load.numHulls == MAX_HULLS) {
+    echo("%s: MAX_HULLS reached", __func__);
+    return false;
+  }
+  LoadHull* box = &load.hulls[load.numHulls++];
+  GVec3Copy(mins, box->mins);
+  GVec3Copy(maxs, box->maxs);
+  if (cm.numBrushes) { CM_BuildHull(box); }
+  return true;
+}
 
-  tw.offsets[6][0] = tw.size[0][0];
-  tw.offsets[6][1] = tw.size[1][1];
-  tw.offsets[6][2] = tw.size[1][2];
+//..................
+// CM_TraceMode
+//   Picks the trace mode (traceMode_t) of the trace core functions, once the trace is known to be a point or not
+//   Point capsules are traced as points: their radius and offset are 0, so the capsule planes are the same
+//..................
+static void CM_TraceMode(TraceWork* tw) {
+  if (tw->isPoint) {
+    tw->mode = TRACE_MODE_POINT;
+  } else if (tw->sphere.use) {
+    tw->mode = TRACE_MODE_CAPSULE;
+  } else {
+    tw->mode = TRACE_MODE_BOX;
+  }
+}
 
-  tw.offsets[7][0] = tw.size[1][0];
-  tw.offsets[7][1] = tw.size[1][1];
-  tw.offsets[7][2] = tw.size[1][2];
+//..................
+// CM_TraceSetup
+//   Fills the start, end and bounds of the trace data (TraceWork) for an already prepared hull
+//..................
+static void CM_TraceSetup(TraceWork* tw, const vec3 offset, const vec3 start, const vec3 end, i32 brushmask) {
+  // set basic parms
+  tw->contents = brushmask;
+  tw->leafs    = CM_LeafsForMask(brushmask);
+  for (i32 i = 0; i < 3; i++) {
+    tw->start[i] = start[i] + offset[i];
+    tw->end[i]   = end[i] + offset[i];
+  }
 
   //
   // calculate bounds
   //
-  if (tw.sphere.use) {
+  if (tw->sphere.use) {
     for (i32 i = 0; i < 3; i++) {
-      if (tw.start[i] < tw.end[i]) {
-        tw.bounds[0][i] = tw.start[i] - fabs(tw.sphere.offset[i]) - tw.sphere.radius;
-        tw.bounds[1][i] = tw.end[i] + fabs(tw.sphere.offset[i]) + tw.sphere.radius;
+      if (tw->start[i] < tw->end[i]) {
+        tw->bounds[0][i] = tw->start[i] - fabs(tw->sphere.offset[i]) - tw->sphere.radius;
+        tw->bounds[1][i] = tw->end[i] + fabs(tw->sphere.offset[i]) + tw->sphere.radius;
       } else {
-        tw.bounds[0][i] = tw.end[i] - fabs(tw.sphere.offset[i]) - tw.sphere.radius;
-        tw.bounds[1][i] = tw.start[i] + fabs(tw.sphere.offset[i]) + tw.sphere.radius;
+        tw->bounds[0][i] = tw->end[i] - fabs(tw->sphere.offset[i]) - tw->sphere.radius;
+        tw->bounds[1][i] = tw->start[i] + fabs(tw->sphere.offset[i]) + tw->sphere.radius;
       }
     }
   } else {
     for (i32 i = 0; i < 3; i++) {
-      if (tw.start[i] < tw.end[i]) {
-        tw.bounds[0][i] = tw.start[i] + tw.size[0][i];
-        tw.bounds[1][i] = tw.end[i] + tw.size[1][i];
+      if (tw->start[i] < tw->end[i]) {
+        tw->bounds[0][i] = tw->start[i] + tw->size[0][i];
+        tw->bounds[1][i] = tw->end[i] + tw->size[1][i];
       } else {
-        tw.bounds[0][i] = tw.end[i] + tw.size[0][i];
-        tw.bounds[1][i] = tw.start[i] + tw.size[1][i];
+        tw->bounds[0][i] = tw->end[i] + tw->size[0][i];
+        tw->bounds[1][i] = tw->start[i] + tw->size[1][i];
       }
     }
   }
+}
+
+//..................
+// CM_TraceFinish
+//   Stores the result of the trace data (TraceWork) into results
+//   The end position is generated from the original, unmodified start/end
+//..................
+static void CM_TraceFinish(Trace* results, TraceWork* tw, const vec3 start, const vec3 end) {
+  if (tw->trace.fraction == 1) {
+    GVec3Copy(end, tw->trace.endpos);
+  } else {
+    for (i32 i = 0; i < 3; i++) { tw->trace.endpos[i] = start[i] + tw->trace.fraction * (end[i] - start[i]); }
+  }
+
+  // If allsolid is set (was entirely inside something solid), the plane is not valid.
+  // If fraction == 1.0, we never hit anything, and thus the plane is not valid.
+  // Otherwise, the normal on the plane should have unit length
+  assert(tw->trace.allsolid || tw->trace.fraction == 1.0 || Vec3LenSq(tw->trace.plane.normal) > 0.9999);
+  *results = tw->trace;
+}
+
+//..................
+// CM_TraceWork
+//   Sweeps an already prepared hull (TraceWork) from start to end through the given model
+//   `offset` is the symetric hull offset returned by CM_TraceHull
+//   `cmod` is the clipModel of the handle. Only its bounds are used for the temporary box and capsule handles,
+//   which are solved directly (CM_TraceThroughBox and the capsule solvers) without any shared state
+//..................
+static void CM_TraceWork(Trace* results, TraceWork* tw, const vec3 offset, const vec3 start, const vec3 end, cHandle model, const cModel* cmod, const vec3 origin,
+                         i32 brushmask) {
+  bool hull = (model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE);
+  if (!hull) { CM_NextCheck(tw); }  // for multi-check avoidance. Temporary boxes and capsules never look at the marks
+  if (tw->query) {                  // for statistics, may be zeroed
+    tw->query->traces++;
+  } else {
+    c_traces++;
+  }
+
+  // fill in a default trace
+  memset(&tw->trace, 0, sizeof(tw->trace));
+  tw->trace.fraction = 1;  // assume it goes the entire distance until shown otherwise
+  GVec3Copy(origin, tw->modelOrigin);
+
+  if (!cm.numNodes) {
+    *results = tw->trace;
+    return;  // map not loaded, shouldn't happen
+  }
+
+  CM_TraceSetup(tw, offset, start, end, brushmask);
 
   // check for position test special case
   if (start[0] == end[0] && start[1] == end[1] && start[2] == end[2]) {
+    tw->isPoint = false;
+    GVec3Clear(tw->extents);
+    CM_TraceMode(tw);
     if (model) {
 #if defined ALWAYS_BBOX_VS_BBOX  // FIXME - compile time flag?
-      if (model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE) {
-        tw.sphere.use = false;
-        CM_TestInLeaf(&tw, &cmod->leaf);
+      if (hull) {
+        tw->sphere.use = false;
+        CM_TestInBox(tw, cmod->mins, cmod->maxs);
       } else
 #elif defined ALWAYS_CAPSULE_VS_CAPSULE
-      if (model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE) {
-        CM_TestCapsuleInCapsule(&tw, model);
+      if (hull) {
+        CM_TestCapsuleInCapsule(tw, cmod->mins, cmod->maxs);
       } else
 #endif
         if (model == CAPSULE_MODEL_HANDLE) {
-        if (tw.sphere.use) {
-          CM_TestCapsuleInCapsule(&tw, model);
+        if (tw->sphere.use) {
+          CM_TestCapsuleInCapsule(tw, cmod->mins, cmod->maxs);
         } else {
-          CM_TestBoundingBoxInCapsule(&tw, model);
+          CM_TestBoundingBoxInCapsule(tw, cmod->mins, cmod->maxs);
         }
+      } else if (model == BOX_MODEL_HANDLE) {
+        CM_TestInBox(tw, cmod->mins, cmod->maxs);
       } else {
-        CM_TestInLeaf(&tw, &cmod->leaf);
+        CM_TestInModel(tw, cmod);
       }
+    } else if (CM_GatherCovers(tw)) {
+      CM_TestInItems(tw, tw->gather->items, tw->gather->count);
     } else {
-      CM_PositionTest(&tw);
+      CM_PositionTest(tw);
     }
   } else {
     // check for point special case
-    if (tw.size[0][0] == 0 && tw.size[0][1] == 0 && tw.size[0][2] == 0) {
-      tw.isPoint = true;
-      GVec3Clear(tw.extents);
+    if (tw->size[0][0] == 0 && tw->size[0][1] == 0 && tw->size[0][2] == 0) {
+      tw->isPoint = true;
+      GVec3Clear(tw->extents);
     } else {
-      tw.isPoint    = false;
-      tw.extents[0] = tw.size[1][0];
-      tw.extents[1] = tw.size[1][1];
-      tw.extents[2] = tw.size[1][2];
+      tw->isPoint    = false;
+      tw->extents[0] = tw->size[1][0];
+      tw->extents[1] = tw->size[1][1];
+      tw->extents[2] = tw->size[1][2];
     }
+    CM_TraceMode(tw);
 
     // general sweeping through world
     if (model) {
 #if defined ALWAYS_BBOX_VS_BBOX
-      if (model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE) {
-        tw.sphere.use = false;
-        CM_TraceThroughLeaf(&tw, &cmod->leaf);
+      if (hull) {
+        tw->sphere.use = false;
+        CM_TraceThroughBox(tw, cmod->mins, cmod->maxs);
       } else
 #elif defined ALWAYS_CAPSULE_VS_CAPSULE
-      if (model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE) {
-        CM_TraceCapsuleThroughCapsule(&tw, model);
+      if (hull) {
+        CM_TraceCapsuleThroughCapsule(tw, cmod->mins, cmod->maxs);
       } else
 #endif
         if (model == CAPSULE_MODEL_HANDLE) {
-        if (tw.sphere.use) {
-          CM_TraceCapsuleThroughCapsule(&tw, model);
+        if (tw->sphere.use) {
+          CM_TraceCapsuleThroughCapsule(tw, cmod->mins, cmod->maxs);
         } else {
-          CM_TraceBoundingBoxThroughCapsule(&tw, model);
+          CM_TraceBoundingBoxThroughCapsule(tw, cmod->mins, cmod->maxs);
         }
+      } else if (model == BOX_MODEL_HANDLE) {
+        CM_TraceThroughBox(tw, cmod->mins, cmod->maxs);
       } else {
-        CM_TraceThroughLeaf(&tw, &cmod->leaf);
+        CM_TraceThroughModel(tw, cmod);
       }
+    } else if (CM_GatherCovers(tw)) {
+      CM_TraceThroughGather(tw);
+    } else if (col.doBVH) {
+      CM_TraceThroughBVH(tw);
     } else {
-      CM_TraceThroughTree(&tw, 0, 0, 1, tw.start, tw.end);
+      CM_TraceThroughTree(tw, cm.colRoot, 0, 1, tw->start, tw->end);
     }
   }
 
-  // generate endpos from the original, unmodified start/end
-  if (tw.trace.fraction == 1) {
-    GVec3Copy(end, tw.trace.endpos);
-  } else {
-    for (i32 i = 0; i < 3; i++) { tw.trace.endpos[i] = start[i] + tw.trace.fraction * (end[i] - start[i]); }
-  }
+  CM_TraceFinish(results, tw, start, end);
+}
 
-  // If allsolid is set (was entirely inside something solid), the plane is not valid.
-  // If fraction == 1.0, we never hit anything, and thus the plane is not valid.
-  // Otherwise, the normal on the plane should have unit length
-  assert(tw.trace.allsolid || tw.trace.fraction == 1.0 || Vec3LenSq(tw.trace.plane.normal) > 0.9999);
-  *results = tw.trace;
+//..................
+// CM_Trace
+//   A NULL query uses the shared state of the loaded map
+//..................
+static void CM_Trace(ColQuery* query, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, const vec3 origin,
+                     i32 brushmask, bool capsule, const Sphere* sphere) {
+  TraceWork tw;
+  memset(&tw, 0, sizeof(tw));
+  tw.query = query;
+  vec3 offset;
+  CM_TraceHull(&tw, offset, mins, maxs, capsule, sphere);
+  CM_TraceWork(results, &tw, offset, start, end, model, CM_QueryClipModel(query, model), origin, brushmask);
 }
 
 
 //..................
 // CM_BoxTrace
+//   Returns the stored result when col.doTraceCache is enabled and the same trace was already done since the last CM_ClearTraceCache
 //..................
 void CM_BoxTrace(Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask, bool capsule) {
-  CM_Trace(results, start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL);
+  TraceKey key;
+  bool     cached = col.doTraceCache && CM_TraceCacheKey(&key, start, end, mins, maxs, model, brushmask, capsule);
+  if (cached && CM_TraceCacheFind(&key, results)) { return; }
+  CM_Trace(NULL, results, start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL);
+  if (cached) { CM_TraceCacheStore(&key, results); }
 }
 
 //..................
-// CM_TransformedBoxTrace
+// CM_QueryBoxTrace
+//   Same as CM_BoxTrace, but only writes into the given query context, and never into the loaded map data
+//   Can be called concurrently from several threads, as long as each thread uses its own context
+//..................
+void CM_QueryBoxTrace(ColQuery* q, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                      bool capsule) {
+  CM_Trace(q, results, start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL);
+}
+
+//..................
+// CM_QueryGatherTrace
+//   Same as CM_QueryBoxTrace on the world model, testing only the brushes and patches gathered into `g` (CM_QueryGather)
+//   Traces whose swept box leaves the gathered region, or with contents that were not gathered, walk the world as usual
+//   Results only differ from CM_QueryBoxTrace when several brushes are hit at the same fraction, like with the BVH backend
+//..................
+void CM_QueryGatherTrace(ColQuery* q, const ColGather* g, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, i32 brushmask,
+                         bool capsule) {
+  TraceWork tw;
+  memset(&tw, 0, sizeof(tw));
+  tw.query  = q;
+  tw.gather = g;
+  vec3 offset;
+  CM_TraceHull(&tw, offset, mins, maxs, capsule, NULL);
+  CM_TraceWork(results, &tw, offset, start, end, 0, CM_QueryClipModel(q, 0), vec3_origin, brushmask);
+}
+
+//..................
+// CM_GatherTrace
+//   Same as CM_QueryGatherTrace, with the shared state of the loaded map. Not reentrant, and not stored in the trace cache
+//..................
+void CM_GatherTrace(const ColGather* g, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, i32 brushmask, bool capsule) {
+  CM_QueryGatherTrace(NULL, g, results, start, end, mins, maxs, brushmask, capsule);
+}
+
+//..................
+// CM_BatchOrder
+//   qsort comparator for the trace order of CM_BoxTraceBatch
+//..................
+typedef struct {
+  u64 key;  // hull class in the top bits, morton code of the start point in the rest
+  i32 id;   // index of the trace in the batch arrays
+} BatchItem;
+static int CM_BatchOrder(const void* a, const void* b) {
+  const BatchItem* ia = a;
+  const BatchItem* ib = b;
+  if (ia->key != ib->key) { return (ia->key < ib->key) ? -1 : 1; }
+  return ia->id - ib->id;
+}
+
+//..................
+// CM_BoxTraceBatch
+//   Sweeps `count` boxes through the given model, storing each result in results[id]
+//   Inputs are given as structure-of-arrays: starts[id], ends[id], mins[id], maxs[id] and brushmasks[id] describe one trace
+//   mins and maxs can be NULL, for a batch of point traces
+//   Traces are run grouped by hull and in spatial order of their start point,
+//   so the hull setup is shared and consecutive traces walk the same nodes and brushes
+//   Each result is the same as calling CM_BoxTrace for that trace on its own
+//..................
+void CM_BoxTraceBatch(Trace* results, i32 count, const vec3* starts, const vec3* ends, const vec3* mins, const vec3* maxs, const i32* brushmasks, cHandle model,
+                      bool capsule) {
+  if (count <= 0) { return; }
+  // find the hull class of every trace
+  i32        numHulls = 0;
+  const f32* hulls[MAX_BATCH_HULLS][2];
+  BatchItem* order    = Hunk_AllocateTempMemory(count * sizeof(*order));
+  for (i32 id = 0; id < count; id++) {
+    const f32* hmins = mins ? mins[id] : vec3_origin;
+    const f32* hmaxs = maxs ? maxs[id] : vec3_origin;
+    i32        hull;
+    for (hull = 0; hull < numHulls; hull++) {
+      if (!memcmp(hulls[hull][0], hmins, sizeof(vec3)) && !memcmp(hulls[hull][1], hmaxs, sizeof(vec3))) { break; }
+    }
+    if (hull == numHulls && numHulls < MAX_BATCH_HULLS) {
+      hulls[numHulls][0] = hmins;
+      hulls[numHulls][1] = hmaxs;
+      numHulls++;
+    }
+    order[id].key = ((u64)hull << 48) | MortonCode(starts[id]);
+    order[id].id  = id;
+  }
+  qsort(order, count, sizeof(*order), CM_BatchOrder);
+
+  // sweep every trace, only preparing the hull again when it changes
+  cModel*    cmod     = CM_ClipHandleToModel(model);
+  TraceWork  hull;
+  TraceWork  tw;
+  vec3       offset;
+  const f32* lastMins = NULL;
+  const f32* lastMaxs = NULL;
+  for (i32 i = 0; i < count; i++) {
+    i32        id    = order[i].id;
+    const f32* hmins = mins ? mins[id] : vec3_origin;
+    const f32* hmaxs = maxs ? maxs[id] : vec3_origin;
+    if (!lastMins || memcmp(lastMins, hmins, sizeof(vec3)) || memcmp(lastMaxs, hmaxs, sizeof(vec3))) {
+      memset(&hull, 0, sizeof(hull));
+      CM_TraceHull(&hull, offset, hmins, hmaxs, capsule, NULL);
+      lastMins = hmins;
+      lastMaxs = hmaxs;
+    }
+    tw = hull;  // the trace can modify its hull (eg: bbox vs capsule), so always start from a clean copy
+    CM_TraceWork(&results[id], &tw, offset, starts[id], ends[id], model, cmod, vec3_origin, brushmasks[id]);
+  }
+  Hunk_FreeTempMemory(order);
+}
+
+//..................
+// CM_TracePacket
+//   Sweeps up to MAX_PACKET_RAYS point traces through the world together, storing each result in results[id]
+//   Rays with the same start and end are position tests, and run on their own
+//..................
+static void CM_TracePacket(ColQuery* q, Trace* results, i32 count, const vec3* starts, const vec3* ends, i32 brushmask) {
+  TraceWork   hull;
+  vec3        offset;
+  TraceWork   tws[MAX_PACKET_RAYS];
+  RaySegments seg;
+  u32         mask = 0;
+  memset(&hull, 0, sizeof(hull));
+  hull.query = q;
+  CM_TraceHull(&hull, offset, NULL, NULL, false, NULL);
+  memset(&seg, 0, sizeof(seg));
+  for (i32 lane = 0; lane < count; lane++) {
+    TraceWork* tw = &tws[lane];
+    *tw           = hull;
+    // position tests, and the BVH backend, trace each ray on its own
+    if (!cm.numNodes || col.doBVH || (starts[lane][0] == ends[lane][0] && starts[lane][1] == ends[lane][1] && starts[lane][2] == ends[lane][2])) {
+      CM_TraceWork(&results[lane], tw, offset, starts[lane], ends[lane], 0, CM_QueryClipModel(tw->query, 0), vec3_origin, brushmask);
+      continue;
+    }
+    q->traces++;
+    // fill in a default trace
+    tw->trace.fraction = 1;
+    tw->laneBit        = 1u << lane;
+    CM_TraceSetup(tw, offset, starts[lane], ends[lane], brushmask);
+    tw->isPoint = true;
+    tw->mode    = TRACE_MODE_POINT;
+    GVec3Clear(tw->extents);
+    seg.p1f[lane] = 0;
+    seg.p2f[lane] = 1;
+    for (i32 axis = 0; axis < 3; axis++) {
+      seg.p1[axis][lane] = tw->start[axis];
+      seg.p2[axis][lane] = tw->end[axis];
+    }
+    mask |= tw->laneBit;
+  }
+  if (!mask) { return; }
+  CM_NextCheck(&hull);  // one generation for the whole packet, the lanes keep their own visited marks
+  CM_TracePacketThroughTree(tws, mask, cm.colRoot, &seg);
+  for (i32 lane = 0; lane < count; lane++) {
+    if (mask & (1u << lane)) { CM_TraceFinish(&results[lane], &tws[lane], starts[lane], ends[lane]); }
+  }
+}
+
+//..................
+// CM_QueryPointTracePacket
+//   Sweeps `count` point traces through the world, storing each result in results[id]
+//   Rays are walked through the tree in packets of MAX_PACKET_RAYS, so give them in coherent groups
+//   (eg: rays of the same origin, or with nearby start points) for the packets to stay together
+//   Each result is the same as calling CM_QueryBoxTrace with NULL mins/maxs on the world model for that ray
+//   A NULL query uses the internal context of CM_PointTracePacket, because the shared state keeps no visited marks per ray
+//..................
+void CM_QueryPointTracePacket(ColQuery* q, Trace* results, i32 count, const vec3* starts, const vec3* ends, i32 brushmask) {
+  if (!q) {
+    CM_PointTracePacket(results, count, starts, ends, brushmask);
+    return;
+  }
+  CM_QueryClipModel(q, 0);  // validates the context
+  for (i32 first = 0; first < count; first += MAX_PACKET_RAYS) {
+    i32 num = (count - first < MAX_PACKET_RAYS) ? count - first : MAX_PACKET_RAYS;
+    CM_TracePacket(q, results + first, num, starts + first, ends + first, brushmask);
+  }
+}
+
+//..................
+// CM_PointTracePacket
+//   Same as CM_QueryPointTracePacket, with an internal query context for the loaded map
+//   Its statistics are added to the shared counters. Not reentrant, like CM_BoxTrace
+//..................
+void CM_PointTracePacket(Trace* results, i32 count, const vec3* starts, const vec3* ends, i32 brushmask) {
+  static ColQuery packetQuery;
+  if (packetQuery.checksum != cm.checksum || !packetQuery.brushStamps) {
+    CM_FreeQuery(&packetQuery);
+    CM_InitQuery(&packetQuery);
+  }
+  CM_QueryPointTracePacket(&packetQuery, results, count, starts, ends, brushmask);
+  c_traces += packetQuery.traces;
+  c_brush_traces += packetQuery.brushTraces;
+  c_patch_traces += packetQuery.patchTraces;
+  c_leaf_traces += packetQuery.leafTraces;
+  packetQuery.traces      = 0;
+  packetQuery.brushTraces = 0;
+  packetQuery.patchTraces = 0;
+  packetQuery.leafTraces  = 0;
+}
+
+//..................
+// CM_SetEntityTransform
+//   Prepares the transform of an entity at origin, rotated by angles, for CM_EntityBoxTrace and CM_EntityPointContents
+//   Build it once per frame for each moving entity, and use it for all the traces against that entity
+//..................
+void CM_SetEntityTransform(EntityTransform* xf, const vec3 origin, const vec3 angles) {
+  GVec3Copy(origin, xf->origin);
+  GVec3Copy(angles, xf->angles);
+  xf->rotated = (angles[0] || angles[1] || angles[2]);
+  if (!xf->rotated) { return; }
+  CreateRotationMatrix(angles, xf->matrix);
+  TransposeMatrix(xf->matrix, xf->transpose);
+}
+
+//..................
+// CM_TransformedTrace
 //   Handles offseting and rotation of the end points for moving and rotating entities
+//   A NULL query uses the shared state of the loaded map
 //..................
-void CM_TransformedBoxTrace(Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask, const vec3 origin,
-                            const vec3 angles, bool capsule) {
+static void CM_TransformedTrace(ColQuery* query, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model,
+                                i32 brushmask, const EntityTransform* xf, bool capsule) {
   if (!mins) { mins = vec3_origin; }
   if (!maxs) { maxs = vec3_origin; }
 
@@ -916,11 +1857,11 @@ void CM_TransformedBoxTrace(Trace* results, const vec3 start, const vec3 end, co
   }
 
   // subtract origin offset
-  GVec3Sub(start_l, origin, start_l);
-  GVec3Sub(end_l, origin, end_l);
+  GVec3Sub(start_l, xf->origin, start_l);
+  GVec3Sub(end_l, xf->origin, end_l);
 
   // rotate start and end into the models frame of reference
-  bool rotated   = (model != BOX_MODEL_HANDLE && (angles[0] || angles[1] || angles[2]));
+  bool rotated   = (model != BOX_MODEL_HANDLE && xf->rotated);
 
   f32 halfWidth  = symetricSize[1][0];
   f32 halfHeight = symetricSize[1][2];
@@ -931,7 +1872,6 @@ void CM_TransformedBoxTrace(Trace* results, const vec3 start, const vec3 end, co
   sphere.halfHeight = halfHeight;
   f32 t             = halfHeight - sphere.radius;
 
-  vec3 matrix[3], transpose[3];
   if (rotated) {
     // rotation on trace line (start-end) instead of rotating the bmodel
     // NOTE: This is still incorrect for bounding boxes because the actual bounding
@@ -939,26 +1879,24 @@ void CM_TransformedBoxTrace(Trace* results, const vec3 start, const vec3 end, co
     //		 the bounding box or the bmodel because that would make all the brush
     //		 bevels invalid.
     //		 However this is correct for capsules since a capsule itself is rotated too.
-    CreateRotationMatrix(angles, matrix);
-    RotatePoint(start_l, matrix);
-    RotatePoint(end_l, matrix);
+    RotatePoint(start_l, (vec3*)xf->matrix);
+    RotatePoint(end_l, (vec3*)xf->matrix);
     // rotated sphere offset for capsule
-    sphere.offset[0] = matrix[0][2] * t;
-    sphere.offset[1] = -matrix[1][2] * t;
-    sphere.offset[2] = matrix[2][2] * t;
+    sphere.offset[0] = xf->matrix[0][2] * t;
+    sphere.offset[1] = -xf->matrix[1][2] * t;
+    sphere.offset[2] = xf->matrix[2][2] * t;
   } else {
     GVec3Set(sphere.offset, 0, 0, t);
   }
 
   // sweep the box through the model
   Trace trace;
-  CM_Trace(&trace, start_l, end_l, symetricSize[0], symetricSize[1], model, origin, brushmask, capsule, &sphere);
+  CM_Trace(query, &trace, start_l, end_l, symetricSize[0], symetricSize[1], model, xf->origin, brushmask, capsule, &sphere);
 
   // if the bmodel was rotated and there was a collision
   if (rotated && trace.fraction != 1.0) {
     // rotation of bmodel collision plane
-    TransposeMatrix(matrix, transpose);
-    RotatePoint(trace.plane.normal, transpose);
+    RotatePoint(trace.plane.normal, (vec3*)xf->transpose);
   }
 
   // re-calculate the end position of the trace because the trace.endpos
@@ -968,3 +1906,125 @@ void CM_TransformedBoxTrace(Trace* results, const vec3 start, const vec3 end, co
   trace.endpos[2] = start[2] + trace.fraction * (end[2] - start[2]);
   *results        = trace;
 }
+
+//..................
+// CM_TransformedBoxTrace
+//   Handles offseting and rotation of the end points for moving and rotating entities
+//..................
+void CM_TransformedBoxTrace(Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask, const vec3 origin,
+                            const vec3 angles, bool capsule) {
+  EntityTransform xf;
+  CM_SetEntityTransform(&xf, origin, angles);
+  CM_TransformedTrace(NULL, results, start, end, mins, maxs, model, brushmask, &xf, capsule);
+}
+
+//..................
+// CM_QueryTransformedBoxTrace
+//   Same as CM_TransformedBoxTrace, but only writes into the given query context, and never into the loaded map data
+//..................
+void CM_QueryTransformedBoxTrace(ColQuery* q, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                                 const vec3 origin, const vec3 angles, bool capsule) {
+  EntityTransform xf;
+  CM_SetEntityTransform(&xf, origin, angles);
+  CM_TransformedTrace(q, results, start, end, mins, maxs, model, brushmask, &xf, capsule);
+}
+
+//..................
+// CM_EntityBoxTrace
+//   Same as CM_TransformedBoxTrace, with the origin and rotation of a transform prepared by CM_SetEntityTransform
+//..................
+void CM_EntityBoxTrace(Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                       const EntityTransform* xf, bool capsule) {
+  CM_TransformedTrace(NULL, results, start, end, mins, maxs, model, brushmask, xf, capsule);
+}
+
+//..................
+// CM_QueryEntityBoxTrace
+//   Same as CM_EntityBoxTrace, but only writes into the given query context, and never into the loaded map data
+//..................
+void CM_QueryEntityBoxTrace(ColQuery* q, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                            const EntityTransform* xf, bool capsule) {
+  CM_TransformedTrace(q, results, start, end, mins, maxs, model, brushmask, xf, capsule);
+}
+
+//..................
+// CM_EntityTrace
+//   Sweeps one box or capsule through `count` entity hulls, storing each result in results[id]
+//   The hull of the mover is prepared once, like CM_TransformedTrace does for a model without rotation
+//   A NULL query uses the shared state of the loaded map
+//..................
+static void CM_EntityTrace(ColQuery* query, Trace* results, i32 count, const EntityHull* hulls, const vec3 start, const vec3 end, const vec3 mins,
+                           const vec3 maxs, i32 brushmask, bool capsule) {
+  if (count <= 0) { return; }
+  if (!mins) { mins = vec3_origin; }
+  if (!maxs) { maxs = vec3_origin; }
+
+  // adjust so that mins and maxs are always symetric, like CM_TransformedTrace
+  vec3 offset;
+  vec3 symetricSize[2];
+  for (i32 i = 0; i < 3; i++) {
+    offset[i]          = (mins[i] + maxs[i]) * 0.5;
+    symetricSize[0][i] = mins[i] - offset[i];
+    symetricSize[1][i] = maxs[i] - offset[i];
+  }
+  f32    halfWidth  = symetricSize[1][0];
+  f32    halfHeight = symetricSize[1][2];
+  Sphere sphere;
+  sphere.use        = capsule;
+  sphere.radius     = (halfWidth > halfHeight) ? halfHeight : halfWidth;
+  sphere.halfHeight = halfHeight;
+  GVec3Set(sphere.offset, 0, 0, halfHeight - sphere.radius);
+
+  TraceWork hull;
+  TraceWork tw;
+  vec3      hullOffset;
+  memset(&hull, 0, sizeof(hull));
+  hull.query = query;
+  CM_TraceHull(&hull, hullOffset, symetricSize[0], symetricSize[1], capsule, &sphere);
+
+  for (i32 id = 0; id < count; id++) {
+    const EntityHull* ent = &hulls[id];
+    cModel            cmod;  // only the bounds of the temporary box or capsule are used by CM_TraceWork
+    GVec3Copy(ent->mins, cmod.mins);
+    GVec3Copy(ent->maxs, cmod.maxs);
+    // move the trace into the frame of the entity
+    vec3 start_l, end_l;
+    for (i32 i = 0; i < 3; i++) {
+      start_l[i] = start[i] + offset[i];
+      end_l[i]   = end[i] + offset[i];
+    }
+    GVec3Sub(start_l, ent->origin, start_l);
+    GVec3Sub(end_l, ent->origin, end_l);
+
+    tw = hull;  // the trace can modify its hull (eg: bbox vs capsule), so always start from a clean copy
+    Trace* trace = &results[id];
+    CM_TraceWork(trace, &tw, hullOffset, start_l, end_l, ent->capsule ? CAPSULE_MODEL_HANDLE : BOX_MODEL_HANDLE, &cmod, ent->origin, brushmask);
+
+    // re-calculate the end position of the trace from the original start/end, like CM_TransformedTrace
+    trace->endpos[0] = start[0] + trace->fraction * (end[0] - start[0]);
+    trace->endpos[1] = start[1] + trace->fraction * (end[1] - start[1]);
+    trace->endpos[2] = start[2] + trace->fraction * (end[2] - start[2]);
+  }
+}
+
+//..................
+// CM_EntityTraceBatch
+//   Sweeps one box or capsule from start to end through each of the given entity hulls, storing each result in results[id]
+//   Each result is the same as CM_TempBoxModel(hulls[id].mins, hulls[id].maxs, hulls[id].capsule) followed by
+//   CM_TransformedBoxTrace with that handle, hulls[id].origin and no rotation,
+//   but the hulls are solved directly, so the temporary box model is never written
+//..................
+void CM_EntityTraceBatch(Trace* results, i32 count, const EntityHull* hulls, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, i32 brushmask,
+                         bool capsule) {
+  CM_EntityTrace(NULL, results, count, hulls, start, end, mins, maxs, brushmask, capsule);
+}
+
+//..................
+// CM_QueryEntityTraceBatch
+//   Same as CM_EntityTraceBatch, but only writes into the given query context
+//   Can be called concurrently from several threads, as long as each thread uses its own context
+//..................
+void CM_QueryEntityTraceBatch(ColQuery* q, Trace* results, i32 count, const EntityHull* hulls, const vec3 start, const vec3 end, const vec3 mins,
+                              const vec3 maxs, i32 brushmask, bool capsule) {
+  CM_EntityTrace(q, results, count, hulls, start, end, mins, maxs, brushmask, capsule);
+}
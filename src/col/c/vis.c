@@ -73,6 +73,7 @@ void CM_AdjustAreaPortalState(i32 area1, i32 area2, bool open) {
     if (cm.areaPortals[area2 * cm.numAreas + area1] < 0) { err(ERR_DROP, "%s: negative reference count", __func__); }
   }
   CM_FloodAreaConnections();
+  CM_ClearTraceCache();
 }
 
 //..............................
@@ -13,6 +13,38 @@
 #define MAX_SUBMODELS 256
 #define SURFACE_CLIP_EPSILON (0.125)  // keep 1/8 unit away to keep the position valid before network snapping and avoid various numeric issues
 #define MAX_POSITION_LEAFS 1024
+#define MAX_HINT_CLIMB 8  // nodes climbed from the hint leaf by the hinted point lookups, before walking down from the root instead
+#define MAX_LEAF_MASKS 4    // trace masks that can get their own brush lists in the world leafs (load.leafMasks)
+#define MAX_BATCH_HULLS 15  // distinct hull sizes grouped by CM_BoxTraceBatch. Any other hull shares the last group
+#define MAX_HULLS 4         // box sizes whose expanded brush sides are built at load (load.hulls, CM_RegisterHull)
+#define BOUNDS16_UNIT 4      // size of the steps of the stored node and leaf bounds (cBounds16), so that 16 bits cover the world coords
+#define MAX_TREE_STACK 64    // frames of the iterative tree walks. Deeper trees recurse into a new walk when the stack is full
+// #define RECURSIVE_TREE_WALK  // walk the tree with the original recursive functions instead (build flag, for A/B comparisons)
+
+//..................
+// Brush side kernels
+#define SIMD_LANES 8              // brush sides per packed block. Must be 8 for the AVX2 kernels (two halves for SSE)
+#define MAX_SIMD_BRUSH_SIDES 128  // brushes with more sides than this are not packed, and use the scalar code
+
+//..................
+// Ray packets
+#define MAX_PACKET_RAYS 16  // point traces walked through the tree together. At most 32, for the u32 lane masks
+
+//..................
+// Brush BVH
+#define BVH_BINS 12            // candidate split planes per axis, for the binned SAH build
+#define BVH_LEAF_ITEMS 4       // nodes with this many brushes/patches or less are not split
+#define MAX_BVH_DEPTH 64       // levels of the BVH. Deeper nodes become leafs whatever their size, so that the walks never overflow their stack
+
+//..................
+// Trace cache
+#define TRACE_CACHE_SIZE 1024  // results stored by the trace cache. Must be a power of two
+#define TRACE_CACHE_PROBES 8   // slots looked at for each key. The first one is replaced when all of them are taken
+
+//..................
+// Trace jobs
+#define MAX_JOB_WORKERS 64  // maximum size of the trace worker pool
+#define JOB_CHUNK_SIZE 16   // traces taken at once by a worker. Anything smaller than this is never stolen
 
 //..................
 // Math
@@ -6,8 +6,11 @@
 
 //....................................
 // load.h : State Setter
+void CM_InitCfg(void);  // Resets the col and load config to their defaults. Call once at startup, before changing them
 void CM_LoadMap(const char* name, bool clientload, int* checksum);
 void CM_ClearMap(void);
+void CM_MemoryReport(void);
+bool CM_RegisterHull(const vec3 mins, const vec3 maxs);  // Box size whose brush sides are expanded at load, for the traces of that size
 
 //....................................
 // state.h : Getters
@@ -19,9 +22,21 @@ i32     CM_LeafCluster(i32 leafnum);
 i32     CM_LeafArea(i32 leafnum);
 i32     CM_PointContents(const vec3 p, cHandle model);
 i32     CM_TransformedPointContents(const vec3 p, cHandle model, const vec3 origin, const vec3 angles);
+i32     CM_EntityPointContents(const vec3 p, cHandle model, const EntityTransform* xf);
+i32     CM_PointContentsHint(const vec3 p, i32* leafnum);
 i32     CM_BoxLeafnums(const vec3 mins, const vec3 maxs, i32* list, i32 listsize, i32* lastLeaf);
 // state.h : Setters
 cHandle CM_TempBoxModel(const vec3 mins, const vec3 maxs, int capsule);
+// state.h : Reentrant queries (one context per thread)
+void    CM_InitQuery(ColQuery* q);
+void    CM_FreeQuery(ColQuery* q);
+cHandle CM_QueryTempBoxModel(ColQuery* q, const vec3 mins, const vec3 maxs, i32 capsule);
+void    CM_Gather(ColGather* g, const vec3 mins, const vec3 maxs, i32 brushmask);
+void    CM_QueryGather(ColQuery* q, ColGather* g, const vec3 mins, const vec3 maxs, i32 brushmask);
+void    CM_FreeGather(ColGather* g);
+i32     CM_QueryPointContents(ColQuery* q, const vec3 p, cHandle model);
+i32     CM_QueryTransformedPointContents(ColQuery* q, const vec3 p, cHandle model, const vec3 origin, const vec3 angles);
+i32     CM_QueryEntityPointContents(ColQuery* q, const vec3 p, cHandle model, const EntityTransform* xf);
 
 //....................................
 // vis.h : Solvers
@@ -37,8 +52,40 @@ void CM_ModelBounds(cHandle model, vec3 mins, vec3 maxs);
 void CM_BoxTrace(Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask, bool capsule);
 void CM_TransformedBoxTrace(Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask, const vec3 origin,
                             const vec3 angles, bool capsule);
+void CM_BoxTraceBatch(Trace* results, i32 count, const vec3* starts, const vec3* ends, const vec3* mins, const vec3* maxs, const i32* brushmasks, cHandle model,
+                      bool capsule);
+void CM_QueryBoxTrace(ColQuery* q, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                      bool capsule);
+void CM_GatherTrace(const ColGather* g, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, i32 brushmask, bool capsule);
+void CM_QueryGatherTrace(ColQuery* q, const ColGather* g, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, i32 brushmask,
+                         bool capsule);
+void CM_QueryTransformedBoxTrace(ColQuery* q, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                                 const vec3 origin, const vec3 angles, bool capsule);
+void CM_SetEntityTransform(EntityTransform* xf, const vec3 origin, const vec3 angles);
+void CM_EntityBoxTrace(Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                       const EntityTransform* xf, bool capsule);
+void CM_QueryEntityBoxTrace(ColQuery* q, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                            const EntityTransform* xf, bool capsule);
+void CM_PointTracePacket(Trace* results, i32 count, const vec3* starts, const vec3* ends, i32 brushmask);
+void CM_QueryPointTracePacket(ColQuery* q, Trace* results, i32 count, const vec3* starts, const vec3* ends, i32 brushmask);
+void CM_EntityTraceBatch(Trace* results, i32 count, const EntityHull* hulls, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, i32 brushmask,
+                         bool capsule);
+void CM_QueryEntityTraceBatch(ColQuery* q, Trace* results, i32 count, const EntityHull* hulls, const vec3 start, const vec3 end, const vec3 mins,
+                              const vec3 maxs, i32 brushmask, bool capsule);
+// Solve: Trace cache  cache.c
+void CM_ClearTraceCache(void);
 // Solve: Position   position.c
 i32 CM_PointLeafnum(const vec3 p);
+i32 CM_PointLeafnumHint(const vec3 p, i32 hint);
+
+//....................................
+// Solve: Jobs       jobs.c
+bool CM_JobsInit(i32 numWorkers);
+void CM_JobsShutdown(void);
+i32  CM_JobsNumWorkers(void);
+void CM_JobsSubmit(TraceJob* jobs, i32 count);
+void CM_JobsWait(void);
+void CM_JobsRun(TraceJob* jobs, i32 count);
 
 //....................................
 // Debug: Patches   patch.c
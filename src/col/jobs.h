@@ -0,0 +1,27 @@
+#ifndef COL_JOBS_H
+#define COL_JOBS_H
+//..............................
+
+// stdlib dependencies
+#include <pthread.h>
+#include <stdatomic.h>
+// Collision dependencies
+#include "./types.h"
+#include "./cfg.h"
+#include "./solve.h"
+#include "./state.h"
+
+//..............................
+// Trace job system
+// A fixed pool of worker threads, each tracing with its own reentrant query context (ColQuery)
+// Every worker owns a range of the submitted jobs, and steals half of another worker's range when its own runs out
+//..............................
+bool CM_JobsInit(i32 numWorkers);
+void CM_JobsShutdown(void);
+i32  CM_JobsNumWorkers(void);
+void CM_JobsSubmit(TraceJob* jobs, i32 count);
+void CM_JobsWait(void);
+void CM_JobsRun(TraceJob* jobs, i32 count);
+
+//..............................
+#endif  // COL_JOBS_H
@@ -163,6 +163,7 @@ typedef struct {
 // Will alloc and store its data in state.c static variables
 void CM_LoadMap(const char* name, bool clientload, int* checksum);
 void CM_ClearMap(void);
+void CM_MemoryReport(void);
 
 //..............................
 #endif  // COL_LOAD_H
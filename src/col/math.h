@@ -51,6 +51,7 @@ void SetPlaneSignbits(cPlane* out);
 f32  RadiusFromBounds(const vec3 mins, const vec3 maxs);
 void ClearBounds(vec3 mins, vec3 maxs);
 void AddPointToBounds(const vec3 v, vec3 mins, vec3 maxs);
+u64  MortonCode(const vec3 p);
 
 //..............................
 #endif  // COL_MATH_H
@@ -4,13 +4,20 @@
 
 // stdlib dependencies
 #include <assert.h>
+#include <stdlib.h>  // For qsort
 // Engine dependencies
 #include "../core/state.h"  // For env variables access
+#include "../mem/core.h"    // For temporary work memory
 // Collision dependencies
 #include "./types.h"
 #include "./math.h"
 #include "./flags.h"
 
+//..............................
+// Body of the functions that are specialized at compile time: each caller passes a constant (eg: a traceMode_t),
+// so the branches on it fold away in the inlined copy
+#define CM_SPECIALIZED static inline __attribute__((always_inline))
+
 //..............................
 // State Variables : from state.h
 //..............................
@@ -27,6 +34,9 @@ extern i32 c_pointcontents;
 extern i32 c_traces;
 extern i32 c_brush_traces;
 extern i32 c_patch_traces;
+extern i32 c_leaf_traces;
+extern i32 c_cache_hits;
+extern i32 c_cache_misses;
 //..............................
 // Patch Debugging
 extern const PatchCol* debugPatchCollide;
@@ -40,27 +50,283 @@ cHandle CM_TempBoxModel(const vec3 mins, const vec3 maxs, int capsule);
 cModel* CM_ClipHandleToModel(cHandle handle);
 void    CM_StoreLeafs(LeafList* ll, i32 nodeNum);
 void    CM_BoxLeafnums_r(LeafList* ll, i32 nodeNum);
+cLeaf*  CM_LeafsForMask(i32 contents);
+
+//..............................
+// Reentrant queries : from state.c
+void    CM_InitQuery(ColQuery* q);
+void    CM_FreeQuery(ColQuery* q);
+cModel* CM_QueryClipModel(ColQuery* q, cHandle handle);
+cHandle CM_QueryTempBoxModel(ColQuery* q, const vec3 mins, const vec3 maxs, i32 capsule);
+void    CM_NextCheck(TraceWork* tw);
+void    CM_Gather(ColGather* g, const vec3 mins, const vec3 maxs, i32 brushmask);
+void    CM_QueryGather(ColQuery* q, ColGather* g, const vec3 mins, const vec3 maxs, i32 brushmask);
+void    CM_FreeGather(ColGather* g);
+//..................
+// CM_BrushChecked
+//   Returns true when the brush was already checked by the current trace, and marks it as checked otherwise
+//   Reentrant queries keep the marks in their own context, instead of writing them into the map data
+//..................
+static inline bool CM_BrushChecked(const TraceWork* tw, i32 brushnum) {
+  if (tw->query) {
+    ColQuery* q = tw->query;
+    if (tw->laneBit) {  // rays of a packet share the stamp, and keep one mark per ray
+      if (q->brushStamps[brushnum] != q->stamp) {
+        q->brushStamps[brushnum] = q->stamp;
+        q->brushLanes[brushnum]  = 0;
+      }
+      if (q->brushLanes[brushnum] & tw->laneBit) { return true; }
+      q->brushLanes[brushnum] |= tw->laneBit;
+      return false;
+    }
+    if (q->brushStamps[brushnum] == q->stamp) { return true; }
+    q->brushStamps[brushnum] = q->stamp;
+    return false;
+  }
+  cBrush* b = &cm.brushes[brushnum];
+  if (b->checkcount == cm.checkcount) { return true; }
+  b->checkcount = cm.checkcount;
+  return false;
+}
+//..................
+// CM_PatchChecked
+//   Same as CM_BrushChecked, for the patch stored at cm.surfaces[surfnum]
+//..................
+static inline bool CM_PatchChecked(const TraceWork* tw, i32 surfnum) {
+  if (tw->query) {
+    ColQuery* q = tw->query;
+    if (tw->laneBit) {
+      if (q->patchStamps[surfnum] != q->stamp) {
+        q->patchStamps[surfnum] = q->stamp;
+        q->patchLanes[surfnum]  = 0;
+      }
+      if (q->patchLanes[surfnum] & tw->laneBit) { return true; }
+      q->patchLanes[surfnum] |= tw->laneBit;
+      return false;
+    }
+    if (q->patchStamps[surfnum] == q->stamp) { return true; }
+    q->patchStamps[surfnum] = q->stamp;
+    return false;
+  }
+  cPatch* patch = cm.surfaces[surfnum];
+  if (patch->checkcount == cm.checkcount) { return true; }
+  patch->checkcount = cm.checkcount;
+  return false;
+}
+
+//..............................
+// Tree nodes
+//..................
+// CM_GetNode
+//   Returns the plane of the given node, and stores its two children into the children array
+//   Reads the inline nodes when they were built (load.nodeOrder), cm.nodes otherwise, and the compact nodes on compact maps (load.compact)
+//..................
+static inline const cPlane* CM_GetNode(i32 num, i32 children[2]) {
+  if (cm.tnodes) {
+    const cTNode* node = &cm.tnodes[num];
+    children[0]        = node->children[0];
+    children[1]        = node->children[1];
+    return &node->plane;
+  }
+  if (cm.nodes) {
+    const cNode* node = &cm.nodes[num];
+    children[0]       = node->children[0];
+    children[1]       = node->children[1];
+    return node->plane;
+  }
+  if (cm.nodes16) {
+    const cNode16* node = &cm.nodes16[num];
+    children[0]         = node->children[0];
+    children[1]         = node->children[1];
+    return &cm.planes[node->plane];
+  }
+  const cNode32* node = &cm.nodes32[num];
+  children[0]         = node->children[0];
+  children[1]         = node->children[1];
+  return &cm.planes[node->plane];
+}
+//..................
+// CM_NodeContents
+//   Returns the ORed contents of every brush and patch under the given node or leaf (negative numbers)
+//   A walk with a contents mask can skip the subtrees where this doesn't match it
+//..................
+static inline i32 CM_NodeContents(i32 num) {
+  if (num < 0) { return cm.leafs[-1 - num].contents; }
+  if (cm.tnodes) { return cm.tnodes[num].contents; }
+  return cm.nodeContents[num];
+}
+//..................
+// CM_PrefetchNode
+//   Starts loading the given inline node into the cache, for a node that will be visited later
+//..................
+static inline void CM_PrefetchNode(i32 num) {
+  if (num < 0) { return; }
+  if (cm.tnodes) { __builtin_prefetch(&cm.tnodes[num]); }
+  if (cm.nodes16) { __builtin_prefetch(&cm.nodes16[num]); }
+  if (cm.nodes32) { __builtin_prefetch(&cm.nodes32[num]); }
+}
 
+//..................
+// CM_GetColNode
+//   Same as CM_GetNode, for the collision tree (cm.colNodes) walked by the traces and position tests from cm.colRoot
+//   Falls back to the original tree when the collision tree was not built (load.colTree)
+//..................
+static inline const cPlane* CM_GetColNode(i32 num, i32 children[2]) {
+  if (!cm.colNodes) { return CM_GetNode(num, children); }
+  const cTNode* node = &cm.colNodes[num];
+  children[0]        = node->children[0];
+  children[1]        = node->children[1];
+  return &node->plane;
+}
+//..................
+// CM_ColNodeContents
+//   Same as CM_NodeContents, for the collision tree
+//..................
+static inline i32 CM_ColNodeContents(i32 num) {
+  if (num < 0 || !cm.colNodes) { return CM_NodeContents(num); }
+  return cm.colNodes[num].contents;
+}
+//..................
+// CM_PrefetchColNode
+//   Same as CM_PrefetchNode, for the collision tree
+//..................
+static inline void CM_PrefetchColNode(i32 num) {
+  if (num < 0) { return; }
+  if (!cm.colNodes) {
+    CM_PrefetchNode(num);
+    return;
+  }
+  __builtin_prefetch(&cm.colNodes[num]);
+}
+//..................
+// CM_BoundsTouch16
+//   Returns true when the given bounds touch the stored bounds of a node or leaf
+//..................
+static inline bool CM_BoundsTouch16(const cBounds16* b, const vec3 bounds[2]) {
+  return bounds[0][0] <= b->maxs[0] * BOUNDS16_UNIT && bounds[1][0] >= b->mins[0] * BOUNDS16_UNIT
+      && bounds[0][1] <= b->maxs[1] * BOUNDS16_UNIT && bounds[1][1] >= b->mins[1] * BOUNDS16_UNIT
+      && bounds[0][2] <= b->maxs[2] * BOUNDS16_UNIT && bounds[1][2] >= b->mins[2] * BOUNDS16_UNIT;
+}
+//..................
+// CM_ColNodeTouches
+//   Returns false when the given bounds don't touch the collision node or leaf (negative numbers), so nothing under it can be hit
+//   Always true when the bounds were not built (load.nodeBounds)
+//..................
+static inline bool CM_ColNodeTouches(i32 num, const vec3 bounds[2]) {
+  if (!cm.leafBounds) { return true; }
+  if (num < 0) { return CM_BoundsTouch16(&cm.leafBounds[-1 - num], bounds); }
+  return CM_BoundsTouch16(cm.colNodes ? &cm.colBounds[num] : &cm.nodeBounds[num], bounds);
+}
+
+//..............................
+// Brush sides
+//..................
+// CM_SideBitsPlane
+//   Returns the plane of the given side of the brush, for the side width of the brush (cBrush.sideBits)
+//   The brush loops pass the width as a constant, chosen once per brush, so they don't check it for every side
+//..................
+static inline const cPlane* CM_SideBitsPlane(const cBrush* brush, i32 sideId, const i32 bits) {
+  if (bits == 16) { return &cm.planes[brush->sides16[sideId].plane]; }
+  if (bits == 32) { return &cm.planes[brush->sides32[sideId].plane]; }
+  return brush->sides[sideId].plane;
+}
+//..................
+// CM_SideBitsSurfaceFlags
+//   Returns the surface flags of the given side of the brush, for the side width of the brush. Compact sides keep only their shader
+//..................
+static inline i32 CM_SideBitsSurfaceFlags(const cBrush* brush, i32 sideId, const i32 bits) {
+  if (bits == 16) { return cm.shaders[brush->sides16[sideId].shaderNum].surfaceFlags; }
+  if (bits == 32) { return cm.shaders[brush->sides32[sideId].shaderNum].surfaceFlags; }
+  return brush->sides[sideId].surfaceFlags;
+}
+//..................
+// CM_SidePlane
+//   Returns the plane of the given side of the brush, from its full or compact sides (load.compact)
+//   Checks the side width on every call. The trace and position loops use CM_SideBitsPlane instead
+//..................
+static inline const cPlane* CM_SidePlane(const cBrush* brush, i32 sideId) {
+  return CM_SideBitsPlane(brush, sideId, brush->sideBits);
+}
 
 //....................................
 // tools.c
 void CM_ModelBounds(cHandle model, vec3 mins, vec3 maxs);
 
+//....................................
+// simd.c
+void CM_PackBrushSides(void);
+void CM_PackLeafBrushes(void);
+void CM_InitSideKernels(void);
+bool CM_UseSideKernels(const cBrush* brush);
+bool CM_UseLeafKernels(const cLeaf* leaf);
+u32  CM_LeafBrushHits(const TraceWork* tw, const cBrushBlock* block);
+void CM_PackPatchFacets(PatchCol* pc);
+bool CM_UsePatchKernels(const PatchCol* pc);
+u32  CM_PatchFacetBoundsHits(const TraceWork* tw, const PatchCol* pc, i32 first);
+u32  CM_PatchFacetHits(const TraceWork* tw, const PatchCol* pc, i32 first);
+bool CM_TraceSideDists(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2);
+bool CM_TracePointSideDists(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2);
+bool CM_TraceSphereSideDists(const TraceWork* tw, const cBrush* brush, f32* d1, f32* d2);
+bool CM_TestSidesOutside(const TraceWork* tw, const cBrush* brush);
+bool CM_TestSphereSidesOutside(const TraceWork* tw, const cBrush* brush);
+void CM_PacketPlaneSides(const cPlane* plane, const RaySegments* seg, u32 mask, PacketSplit* split);
+//....................................
+// bvh.c
+void CM_BuildBVH(void);
+void CM_BVHBoxLeafs(const vec3 mins, const vec3 maxs, BVHVisit visit, void* data);
+void CM_BuildFacetBVH(PatchCol* pc);
+i32  CM_FacetBVHBlocks(const TraceWork* tw, const PatchCol* pc, i32* list);
+//....................................
+// cache.c
+bool CM_TraceCacheKey(TraceKey* key, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask, bool capsule);
+bool CM_TraceCacheFind(const TraceKey* key, Trace* results);
+void CM_TraceCacheStore(const TraceKey* key, const Trace* results);
+void CM_ClearTraceCache(void);
 //....................................
 // position.c
 i32  BoxOnPlaneSide(const vec3 emins, const vec3 emaxs, const struct cplane_s* p);
 bool CM_BoundsIntersect(const vec3 mins, const vec3 maxs, const vec3 mins2, const vec3 maxs2);
 bool CM_BoundsIntersectPoint(const vec3 mins, const vec3 maxs, const vec3 point);
+i32  CM_FindPointLeaf(const vec3 p, i32 num);
 i32  CM_PointLeafnum_r(const vec3 p, i32 num);
 i32  CM_PointLeafnum(const vec3 p);
-void CM_TestCapsuleInCapsule(TraceWork* tw, cHandle model);
-void CM_TestBoundingBoxInCapsule(TraceWork* tw, cHandle model);
+i32  CM_PointLeafnumHint(const vec3 p, i32 hint);
+void CM_TestCapsuleInCapsule(TraceWork* tw, const vec3 mins, const vec3 maxs);
+void CM_TestBoundingBoxInCapsule(TraceWork* tw, const vec3 mins, const vec3 maxs);
 void CM_TestInLeaf(TraceWork* tw, const cLeaf* leaf);
+void CM_TestInItems(TraceWork* tw, const i32* items, i32 count);
+void CM_TestInModel(TraceWork* tw, const cModel* cmod);
+void CM_TestInBox(TraceWork* tw, const vec3 mins, const vec3 maxs);
 void CM_PositionTest(TraceWork* tw);
 i32  CM_PointContents(const vec3 p, cHandle model);
+i32  CM_PointContentsHint(const vec3 p, i32* leafnum);
 //....................................
 // trace.c
 void CM_BoxTrace(Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask, bool capsule);
+void CM_BoxTraceBatch(Trace* results, i32 count, const vec3* starts, const vec3* ends, const vec3* mins, const vec3* maxs, const i32* brushmasks, cHandle model,
+                      bool capsule);
+void CM_TransformedBoxTrace(Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask, const vec3 origin,
+                            const vec3 angles, bool capsule);
+void CM_QueryBoxTrace(ColQuery* q, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                      bool capsule);
+void CM_GatherTrace(const ColGather* g, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, i32 brushmask, bool capsule);
+void CM_QueryGatherTrace(ColQuery* q, const ColGather* g, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, i32 brushmask,
+                         bool capsule);
+void CM_QueryTransformedBoxTrace(ColQuery* q, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                                 const vec3 origin, const vec3 angles, bool capsule);
+void CM_SetEntityTransform(EntityTransform* xf, const vec3 origin, const vec3 angles);
+void CM_EntityBoxTrace(Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                       const EntityTransform* xf, bool capsule);
+void CM_QueryEntityBoxTrace(ColQuery* q, Trace* results, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, cHandle model, i32 brushmask,
+                            const EntityTransform* xf, bool capsule);
+void CM_PointTracePacket(Trace* results, i32 count, const vec3* starts, const vec3* ends, i32 brushmask);
+void CM_QueryPointTracePacket(ColQuery* q, Trace* results, i32 count, const vec3* starts, const vec3* ends, i32 brushmask);
+void CM_EntityTraceBatch(Trace* results, i32 count, const EntityHull* hulls, const vec3 start, const vec3 end, const vec3 mins, const vec3 maxs, i32 brushmask,
+                         bool capsule);
+void CM_QueryEntityTraceBatch(ColQuery* q, Trace* results, i32 count, const EntityHull* hulls, const vec3 start, const vec3 end, const vec3 mins,
+                              const vec3 maxs, i32 brushmask, bool capsule);
+void CM_BuildHulls(void);
+bool CM_RegisterHull(const vec3 mins, const vec3 maxs);
 
 //....................................
 #endif  // COL_SOLVE_H
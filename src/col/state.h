@@ -27,6 +27,9 @@ extern i32 c_pointcontents;
 extern i32 c_traces;
 extern i32 c_brush_traces;
 extern i32 c_patch_traces;
+extern i32 c_leaf_traces;
+extern i32 c_cache_hits;
+extern i32 c_cache_misses;
 // Debug counters
 extern i32 c_active_windings;
 extern i32 c_peak_windings;
@@ -63,6 +66,14 @@ void      CM_StoreLeafs(LeafList* ll, i32 nodeNum);
 void      CM_StoreBrushes(LeafList* ll, i32 nodeNum);
 cHandle   CM_TempBoxModel(const vec3 mins, const vec3 maxs, int capsule);
 PatchCol* CM_GeneratePatchCollide(i32 width, i32 height, vec3* points);
+//..............................
+// Reentrant query contexts
+void      CM_InitQuery(ColQuery* q);
+void      CM_FreeQuery(ColQuery* q);
+cHandle   CM_QueryTempBoxModel(ColQuery* q, const vec3 mins, const vec3 maxs, i32 capsule);
+void      CM_Gather(ColGather* g, const vec3 mins, const vec3 maxs, i32 brushmask);
+void      CM_QueryGather(ColQuery* q, ColGather* g, const vec3 mins, const vec3 maxs, i32 brushmask);
+void      CM_FreeGather(ColGather* g);
 
 //..............................
 // State Getters
@@ -81,6 +92,11 @@ i32     CM_LeafCluster(i32 leafnum);
 i32     CM_LeafArea(i32 leafnum);
 i32     CM_PointContents(const vec3 p, cHandle model);
 i32     CM_TransformedPointContents(const vec3 p, cHandle model, const vec3 origin, const vec3 angles);
+i32     CM_EntityPointContents(const vec3 p, cHandle model, const EntityTransform* xf);
+i32     CM_PointContentsHint(const vec3 p, i32* leafnum);
+i32     CM_QueryPointContents(ColQuery* q, const vec3 p, cHandle model);
+i32     CM_QueryTransformedPointContents(ColQuery* q, const vec3 p, cHandle model, const vec3 origin, const vec3 angles);
+i32     CM_QueryEntityPointContents(ColQuery* q, const vec3 p, cHandle model, const EntityTransform* xf);
 
 //..............................
 #endif  // COL_STATE_H
@@ -21,11 +21,30 @@ typedef struct colCfg_s {
   int    doVIS;             // All vis clipArea portals will be connected when disabled
   int    doPatchCol;        // Patches will be ignored for collision traces when disabled
   int    doPlayerCurveCol;  // PlayerToCurve collsion will be ignored when disabled. was: cm_playerCurveClip
+  int    doSIMD;            // Brush sides are tested with the vectorized kernels when enabled and supported by the cpu. Off by default
+  int    doLeafSIMD;        // Leaf brushes are prefiltered by their packed bounds and contents when enabled and supported by the cpu. Off by default
+  int    doFacetBVH;        // Patch traces only test the facets of the packed blocks that their facet BVH finds, when enabled and supported by the cpu. Off by default
+  int    doExactOffset;     // Box traces use their real extent along non-axial node planes, instead of a fixed 2048 units, when enabled
+  int    doBVH;             // World traces, position tests and point contents walk the brush BVH instead of the BSP tree when enabled
+  int    doTraceCache;      // CM_BoxTrace returns the stored result of the same trace when it was already done since the last CM_ClearTraceCache
   ColDbg dbg;
 } ColCfg;
+typedef enum { NODE_ORDER_NONE, NODE_ORDER_DEPTH_FIRST, NODE_ORDER_VEB } nodeOrder_t;
+typedef enum { BRUSH_ORDER_NONE, BRUSH_ORDER_LEAFS, BRUSH_ORDER_MORTON } brushOrder_t;
+typedef struct {
+  vec3 mins, maxs;
+} LoadHull;
 typedef struct loadCfg_s {
-  int noCurves;   // Won't load any patches when active
-  int developer;  // was: Com_DPrintf, instead of a conditional call to echo
+  int      noCurves;                   // Won't load any patches when active
+  int      developer;                  // was: Com_DPrintf, instead of a conditional call to echo
+  int      nodeOrder;                  // Layout of the inline node array walked by the traversals (nodeOrder_t). NODE_ORDER_NONE walks cm.nodes instead, and is the default
+  int      leafMasks[MAX_LEAF_MASKS];  // Trace masks that get their own brush list in every world leaf. A 0 ends the list. None by default
+  int      compact;                    // Only the used planes are kept, and the nodes and brush sides reference them by index instead of by pointer
+  int      colTree;                    // Traces and position tests walk a copy of the tree without the splits that don't separate any brushes or patches. Off by default
+  int      nodeBounds;                 // Bounds of the brushes and patches under every node and leaf are built, and the traces and position tests skip the subtrees that they don't touch
+  int      brushOrder;                 // Order of the brushes and their sides in memory (brushOrder_t). BRUSH_ORDER_NONE keeps the order of the file, and is the default
+  int      numHulls;
+  LoadHull hulls[MAX_HULLS];           // Box sizes whose expanded brush sides are built at load (CM_RegisterHull). None by default
 } LoadCfg;
 //....................................
 
@@ -46,6 +65,39 @@ typedef struct {
   i32     children[2];  // negative numbers are leafs
 } cNode;
 
+// Inline node: a copy of the node with its plane stored in place, so that each traversal step is a single 32 byte load
+typedef struct {
+  cPlane plane;
+  i32    children[2];  // negative numbers are leafs, others are indexes into cm.tnodes
+  i32    contents;     // ORed contents of every brush and patch under the node, same as cm.nodeContents
+} cTNode;
+
+// Compact node (load.compact): plane and children as indices, 16 bits wide when every plane, node and leaf number of the map fits
+typedef struct {
+  u16 plane;        // index into cm.planes
+  i16 children[2];  // negative numbers are leafs
+} cNode16;
+typedef struct {
+  i32 plane;
+  i32 children[2];
+} cNode32;
+
+// Bounds of the brushes and patches under a node or leaf, in units of BOUNDS16_UNIT, rounded outwards and clamped to the world coords
+typedef struct {
+  i16 mins[3];
+  i16 maxs[3];
+} cBounds16;
+
+// Cell of a node or leaf: the part of space that the tree walks send into it, for the hinted point lookups
+// The axial planes above it are kept as a box, the others are checked through the chain of `check` nodes
+typedef struct {
+  vec3 mins;       // inclusive, like the front side of an axial plane
+  vec3 maxs;       // exclusive, like the back side. Empty box for the nodes and leafs that the tree doesn't reach
+  i32  parent;     // node above, -1 for the root
+  i32  check;      // nearest node above with a non-axial plane, -1 when none
+  i32  checkSide;  // child of `check` that leads here
+} cCell;
+
 typedef struct {
   char shader[MAX_PATHLEN];
   i32  surfaceFlags;
@@ -58,29 +110,91 @@ typedef struct {
   i32     shaderNum;
 } cBSide;
 
+// Compact brush side (load.compact): plane and shader as indices. The surfaceFlags come from the shader
+typedef struct {
+  u16 plane;  // index into cm.planes
+  u16 shaderNum;
+} cBSide16;
+typedef struct {
+  i32 plane;
+  i32 shaderNum;
+} cBSide32;
+
+// Bounds and contents of the brushes of a leaf packed as structure-of-arrays, SIMD_LANES brushes per block, for the leaf prefilter (simd.c)
+typedef struct {
+  f32 mins[3][SIMD_LANES];   // brush bounds, already expanded by BOUNDS_CLIP_EPSILON like in CM_BoundsIntersect
+  f32 maxs[3][SIMD_LANES];
+  i32 contents[SIMD_LANES];  // 0 for the padding lanes, so they never pass
+} cBrushBlock;
+
 typedef struct {
-  i32 cluster;
-  i32 area;
-  i32 firstLeafBrush;
-  i32 numLeafBrushes;
-  i32 firstLeafSurface;
-  i32 numLeafSurfaces;
+  i32          cluster;
+  i32          area;
+  i32          firstLeafBrush;
+  i32          numLeafBrushes;
+  i32          firstLeafSurface;
+  i32          numLeafSurfaces;
+  i32          contents;  // ORed contents of the brushes and patches of the leaf, so that masked walks can skip it
+  cBrushBlock* blocks;    // [numLeafBrushes/SIMD_LANES rounded up] packed copy of the brush bounds. NULL when the leaf is not packed
 } cLeaf;
 
+// Copy of the world leafs with only the brushes of a common trace mask, walked by the traces that use it (load.leafMasks)
+typedef struct {
+  i32    contents;    // the mask. Each leaf keeps every brush with any of these contents, in the original order
+  i32    numBrushes;  // brushes of all its leafs, to pick the tightest list
+  cLeaf* leafs;       // [numLeafs] same as cm.leafs, but with the filtered brush lists
+} cLeafSet;
+
 typedef struct cmodel_s {
   vec3  mins, maxs;
   cLeaf leaf;  // submodels don't reference the main tree
 } cModel;
 
+// Brush sides packed as structure-of-arrays, SIMD_LANES sides per block, for the side kernels (simd.c)
+typedef struct {
+  f32 normal[3][SIMD_LANES];
+  f32 dist[SIMD_LANES];
+  u32 signs[3][SIMD_LANES];  // all bits set when the plane signbits pick the maxs for that axis
+} cSideBlock;
+
 typedef struct {
-  i32     shaderNum;  // the shader that determined the contents
-  i32     contents;
-  vec3    bounds[2];
-  i32     numsides;
-  cBSide* sides;
-  i32     checkcount;  // to avoid repeated testings
+  i32  shaderNum;  // the shader that determined the contents
+  i32  contents;
+  vec3 bounds[2];
+  i32  numsides;
+  i32  sideBits;  // 0 when the sides are full cBSide. 16 or 32 when they are compact (load.compact), read through CM_SidePlane
+  union {
+    cBSide*   sides;
+    cBSide16* sides16;
+    cBSide32* sides32;
+  };
+  i32         checkcount;  // to avoid repeated testings
+  i32         hullSide;    // first side of the brush in the expanded sides of every registered hull (cHull). -1 for the temporary box brushes
+  cSideBlock* blocks;      // [numsides/SIMD_LANES rounded up] packed copy of the sides. NULL when the brush is not packed
 } cBrush;
 
+// Brush side plane, with its dist already expanded by the box of a registered hull (cHull)
+typedef struct {
+  vec3 normal;
+  f32  dist;
+} cHullPlane;
+
+// Box size registered with CM_RegisterHull, with the sides of every brush expanded by it, like the clip hulls of Quake 1
+// Box traces and position tests of that size are point traces against these planes, and only read the brush sides for their result
+typedef struct {
+  vec3        size[2];  // symetric mins and maxs of the box, as in TraceWork.size
+  cHullPlane* planes;   // [cm.numHullSides] expanded sides of all the brushes, from cBrush.hullSide
+} cHull;
+
+// BVH node: a box around brushes and patches of the world. Inner nodes have their first child right after them
+typedef struct {
+  vec3 mins, maxs;
+  i32  first;  // inner nodes: index of the second child. leafs: first item in cm.bvhItems
+  i32  count;  // items of the leaf. 0 for inner nodes
+} cBNode;
+// Called with the items of every BVH leaf that a box walk touches (CM_BVHBoxLeafs). Returns true to stop the walk
+typedef bool (*BVHVisit)(void* data, const i32* items, i32 count);
+
 typedef struct {
   i32 floodNum;
   i32 floodValid;
@@ -94,39 +208,65 @@ typedef struct {
 } cPatch;
 
 typedef struct {
-  char     name[MAX_PATHLEN];
-  i32      numShaders;
-  dShader* shaders;
-  i32      numBSides;
-  cBSide*  BSides;
-  i32      numPlanes;
-  cPlane*  planes;
-  i32      numNodes;
-  cNode*   nodes;
-  i32      numLeafs;
-  cLeaf*   leafs;
-  i32      numLeafBrushes;
-  i32*     leafbrushes;
-  i32      numLeafSurfaces;
-  i32*     leafsurfaces;
-  i32      numSubModels;
-  cModel*  cmodels;
-  i32      numBrushes;
-  cBrush*  brushes;
-  i32      numClusters;
-  i32      clusterBytes;
-  byte*    visibility;
-  bool     vised;  // if false, visibility is just a single cluster of ffs
-  i32      numEntityChars;
-  char*    entityString;
-  i32      numAreas;
-  cArea*   areas;
-  i32*     areaPortals;  // [ numAreas*numAreas ] reference counts
-  i32      numSurfaces;
-  cPatch** surfaces;  // non-patches will be NULL
-  i32      floodValid;
-  i32      checkcount;  // incremented on each trace
-  u32      checksum;
+  char      name[MAX_PATHLEN];
+  i32       numShaders;
+  dShader*  shaders;
+  i32       numBSides;
+  cBSide*   BSides;    // [numBSides + BOX_SIDES]. Only the BOX_SIDES of the box hull when the sides are compact
+  cBSide16* BSides16;  // [numBSides] compact sides, when load.compact and the map fits in 16 bit indices
+  cBSide32* BSides32;  // [numBSides] compact sides otherwise
+  i32       numFilePlanes;  // planes of the map file, before load.compact dropped the unused and repeated ones
+  i32       numPlanes;
+  cPlane*   planes;  // [numPlanes + BOX_PLANES]. Only the ones used by the nodes and sides, without duplicates, when load.compact
+  i32       numNodes;
+  i32       nodeOrder;     // layout that the nodes were built in (nodeOrder_t): load.nodeOrder when the map was loaded
+  cNode*    nodes;         // NULL when load.compact
+  cTNode*   tnodes;        // inline nodes in cm.nodeOrder layout, root first. NULL when not built
+  cNode16*  nodes16;       // compact nodes in cm.nodeOrder layout, when load.compact and the map fits in 16 bit indices
+  cNode32*  nodes32;       // compact nodes otherwise
+  cCell*    nodeCells;     // [numNodes] cell of each node, in the numbering of the tree walks (CM_GetNode)
+  cCell*    leafCells;     // [numLeafs] cell of each leaf
+  i32*      nodeContents;  // [numNodes] ORed contents of every brush and patch under each node, in the numbering of the tree walks
+  cBounds16* nodeBounds;   // [numNodes] bounds of each node, in the numbering of the tree walks. NULL when not built (load.nodeBounds)
+  cBounds16* leafBounds;   // [numLeafs] bounds of each leaf, grown by the collision tree to the leafs that it merged into it
+  i32       numColNodes;
+  cTNode*   colNodes;      // collision tree (load.colTree), root first. NULL when not built, or when it collapsed into a single leaf
+  cBounds16* colBounds;    // [numColNodes] bounds of each collision node, when the bounds are built
+  i32       colRoot;       // node or leaf (negative) where the collision walks start: the root of colNodes, or node 0 of the original tree
+  i32       numLeafs;
+  cLeaf*    leafs;
+  i32       numLeafSets;
+  cLeafSet  leafSets[MAX_LEAF_MASKS];  // copies of the world leafs for the masks of load.leafMasks
+  i32       numLeafBrushes;
+  i32*      leafbrushes;
+  i32       numLeafSurfaces;
+  i32*      leafsurfaces;
+  i32       numSubModels;
+  cModel*   cmodels;
+  i32       numBrushes;
+  cBrush*   brushes;
+  i32       numHullSides;      // sides of all the brushes, numbered by cBrush.hullSide
+  i32       numHulls;
+  cHull     hulls[MAX_HULLS];  // box sizes of load.hulls, with the brush sides expanded by them
+  i32       numSideBlocks;  // packed side blocks of all the brushes
+  i32       numClusters;
+  i32       clusterBytes;
+  byte*     visibility;
+  bool      vised;  // if false, visibility is just a single cluster of ffs
+  i32       numEntityChars;
+  char*     entityString;
+  i32       numAreas;
+  cArea*    areas;
+  i32*      areaPortals;  // [ numAreas*numAreas ] reference counts
+  i32       numSurfaces;
+  cPatch**  surfaces;  // non-patches will be NULL
+  i32       numBVHNodes;
+  cBNode*   bvhNodes;  // bounding volume hierarchy of the world brushes and patches, root first
+  i32       numBVHItems;
+  i32*      bvhItems;  // brush numbers, or -1-surfnum for patches
+  i32       floodValid;
+  i32       checkcount;  // incremented on each trace
+  u32       checksum;
 } cMap;
 //....................................
 
@@ -142,6 +282,8 @@ typedef struct leafList_s {
   i32* list;
   vec3 bounds[2];
   i32  lastLeaf;  // for overflows where each leaf can't be stored individually
+  i32  contents;  // only walk into the subtrees that have any of these contents. 0 walks every subtree
+  bool colTree;   // walk the collision tree (cm.colNodes) instead of the original one. Only for collision queries: it merges leafs
   void (*storeLeafs)(struct leafList_s* ll, i32 nodeNum);
 } LeafList;
 //....................................
@@ -159,6 +301,21 @@ typedef struct {
 // trace->entityNum can also be 0 to (MAX_GENTITIES-1)
 // or ENTITYNUM_NONE, ENTITYNUM_WORLD
 //....................................
+// Inputs of a trace that decide its result, used as the key of the trace cache
+typedef struct {
+  vec3 start, end;
+  vec3 mins, maxs;  // zero when not given
+  i32  model;
+  i32  brushmask;
+  i32  capsule;
+  u32  hash;  // of all the fields above
+} TraceKey;
+//....................................
+// Kind of volume swept by a trace. The trace core is specialized for each one, and picks it once per trace
+// Point capsules are traced as points, like the patches already did
+// TRACE_MODE_HULL is only picked per brush, for the box traces of a registered hull size (cHull)
+typedef enum { TRACE_MODE_BOX, TRACE_MODE_POINT, TRACE_MODE_CAPSULE, TRACE_MODE_HULL } traceMode_t;
+//....................................
 // Used for oriented capsule collision detection
 typedef struct {
   bool use;
@@ -167,20 +324,114 @@ typedef struct {
   vec3 offset;
 } Sphere;
 //....................................
+// Reentrant query context
+// Replaces the shared cm.checkcount and box_model/box_planes/box_brush state for the queries that use it,
+// so that the loaded map data is never written and each thread can query the same cMap with its own context
+typedef struct colQuery_s {
+  u32    checksum;      // checksum of the map this context was created for
+  u32    stamp;         // generation of the current query, bumped on each trace
+  u32*   brushStamps;   // [numBrushes] stamp of the last query that checked each brush
+  u32*   patchStamps;   // [numSurfaces] stamp of the last query that checked each patch surface
+  u32*   brushLanes;    // [numBrushes] packet rays that already checked each brush, valid when its stamp is current
+  u32*   patchLanes;    // [numSurfaces] packet rays that already checked each patch surface, same as brushLanes
+  cModel boxModel;      // temporary box model of this context
+  cPlane boxPlanes[12];
+  cBSide boxSides[6];
+  cBrush boxBrush;
+  // Successful checks counters of this context
+  i32 traces;
+  i32 brushTraces;
+  i32 patchTraces;
+  i32 leafTraces;
+  i32 pointcontents;
+} ColQuery;
+//....................................
+// Brushes and patches of the world gathered once around a region (CM_QueryGather), for the traces that stay inside it
+// The item list grows as needed, and keeps its memory when the context is gathered again. Release it with CM_FreeGather
+typedef struct {
+  u32  checksum;   // checksum of the map it was gathered from
+  vec3 bounds[2];  // region around which the items were gathered
+  i32  contents;   // brushmask of the gather. Traces with any other contents bit don't use it
+  i32  count;
+  i32  size;       // allocated items
+  i32* items;      // brush numbers, or -1-surfnum for patches, like cm.bvhItems
+} ColGather;
+//....................................
 typedef struct {
-  vec3   start;
-  vec3   end;
-  vec3   size[2];      // size of the box being swept through the model
-  vec3   offsets[8];   // [signbits][x] = either size[0][x] or size[1][x]
-  f32    maxOffset;    // longest corner length from origin
-  vec3   extents;      // greatest of abs(size[0]) and abs(size[1])
-  vec3   bounds[2];    // enclosing box of start and end surrounding by size
-  vec3   modelOrigin;  // origin of the model tracing through
-  i32    contents;     // ORed contents of the model tracing through
-  bool   isPoint;      // optimized case
-  Trace  trace;        // returned from trace call
-  Sphere sphere;       // sphere for oriented capsule collision
+  vec3             start;
+  vec3             end;
+  vec3             size[2];      // size of the box being swept through the model
+  vec3             offsets[8];   // [signbits][x] = either size[0][x] or size[1][x]
+  f32              maxOffset;    // longest corner length from origin
+  vec3             extents;      // greatest of abs(size[0]) and abs(size[1])
+  vec3             bounds[2];    // enclosing box of start and end surrounding by size
+  vec3             modelOrigin;  // origin of the model tracing through
+  i32              contents;     // ORed contents of the model tracing through
+  bool             isPoint;      // optimized case
+  i32              mode;         // traceMode_t of the trace core functions used for this trace (CM_TraceMode)
+  Trace            trace;        // returned from trace call
+  Sphere           sphere;       // sphere for oriented capsule collision
+  ColQuery*        query;        // reentrant query context. NULL uses the shared state of the loaded map
+  u32              laneBit;      // bit of this trace in its ray packet. 0 when not traced as part of a packet
+  cLeaf*           leafs;        // world leafs walked by this trace: cm.leafs, or the ones of the tightest mask list that covers its contents
+  const ColGather* gather;       // gathered items that world traces inside its region test, instead of walking the tree. NULL when none
+  const cHull*     hull;         // registered hull of the same box size, whose expanded sides the brush tests read. NULL when none
 } TraceWork;
+//....................................
+// Segments of a packet of rays, as they are clipped by the node planes (structure-of-arrays, one lane per ray)
+typedef struct {
+  f32 p1f[MAX_PACKET_RAYS];
+  f32 p2f[MAX_PACKET_RAYS];
+  f32 p1[3][MAX_PACKET_RAYS];
+  f32 p2[3][MAX_PACKET_RAYS];
+} RaySegments;
+//....................................
+// Classification of the rays of a packet against one node plane
+typedef struct {
+  u32 front;                   // rays completely in front of the plane
+  u32 back;                    // rays completely behind the plane
+  u32 near[2];                 // rays that cross the plane, starting on its front (0) or back (1) side
+  f32 frac[MAX_PACKET_RAYS];   // crossing rays: fraction of their segment where the near side ends
+  f32 frac2[MAX_PACKET_RAYS];  // crossing rays: fraction of their segment where the far side starts
+} PacketSplit;
+
+//....................................
+// Entity transform: the origin and rotation of a moving clipModel, prepared once with CM_SetEntityTransform,
+// so that the transformed traces and point contents against it don't build the rotation on every call
+typedef struct {
+  vec3 origin;
+  vec3 angles;
+  bool rotated;       // any of the angles is not zero
+  vec3 matrix[3];     // from the world into the frame of reference of the model. Only valid when rotated
+  vec3 transpose[3];  // from the frame of reference of the model back into the world. Only valid when rotated
+} EntityTransform;
+
+//....................................
+// Entity hull, as traced by CM_EntityTraceBatch:
+// the temporary box or capsule that CM_TempBoxModel would build for an entity, at its origin
+typedef struct {
+  vec3 mins;
+  vec3 maxs;
+  vec3 origin;
+  bool capsule;  // traced like CAPSULE_MODEL_HANDLE instead of BOX_MODEL_HANDLE
+} EntityHull;
+
+//....................................
+// Trace job, as submitted to the worker pool (jobs.c)
+typedef struct {
+  vec3                   start;
+  vec3                   end;
+  vec3                   mins;
+  vec3                   maxs;
+  cHandle                model;
+  i32                    brushmask;
+  bool                   capsule;
+  bool                   transformed;  // sweep through a moving model, like CM_TransformedBoxTrace
+  vec3                   origin;       // only used when transformed
+  vec3                   angles;       // only used when transformed
+  const EntityTransform* transform;    // only used when transformed. Prepared transform used instead of origin/angles when not NULL
+  Trace                  result;       // written by the worker that runs the job
+} TraceJob;
 
 //....................................
 // Patch Types
@@ -200,11 +451,15 @@ typedef struct {
 //....................................
 // BSP structure that will be used to collide with a patch
 typedef struct patchCollide_s {
-  vec3        bounds[2];
-  i32         numPlanes;  // surface planes plus edge planes
-  PatchPlane* planes;
-  i32         numFacets;
-  Facet*      facets;
+  vec3         bounds[2];
+  i32          numPlanes;  // surface planes plus edge planes
+  PatchPlane*  planes;
+  i32          numFacets;
+  Facet*       facets;
+  cSideBlock*  blocks;         // [numFacets/SIMD_LANES rounded up] packed surface planes of the facets, for the facet kernels (simd.c)
+  cBrushBlock* facetBounds;    // [numFacets/SIMD_LANES rounded up] bounds of the facets taken from their axial planes, expanded by one unit
+  i32          numFacetNodes;  // nodes of the facet BVH. 0 when the facets are not packed
+  cBNode*      facetNodes;     // hierarchy of the packed facet blocks (bvh.c). Leafs store block numbers instead of items
 } PatchCol;
 //....................................
 typedef struct {